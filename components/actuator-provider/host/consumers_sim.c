@@ -0,0 +1,348 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+
+/*
+ * Host simulation of currentValue on demand.
+ *
+ * Builds consumers.c unchanged and drives it with a simulated clock through
+ * three consumer scenarios: a bench with a consumer always subscribed, a
+ * dashboard subscribing for five minutes every half hour, and a parked vehicle
+ * without consumers. The horn changes state at random and the provider gates
+ * every currentValue on consumers_present() as pub_status() does. Consumers
+ * announce themselves as the horn-client soak driver does ("join", then every
+ * ten seconds), and announcements get lost at random.
+ *
+ * Per scenario it prints the currentValue publications with and without the
+ * gate, the ones sent while nobody listened (within the lease after the last
+ * consumer left) and the time from a consumer subscribing to it holding the
+ * latest state. Airtime and CPU time are modelled, not measured: every put
+ * costs one 802.11n data frame plus the router's TCP ACK, with the per-frame
+ * figures below, and PUT_CPU_US / ANNOUNCE_CPU_US are assumptions to be
+ * replaced by esp_timer measurements on the device.
+ *
+ * Usage: consumers_sim [hours] [seconds_between_changes] [announcement_loss_percent] [seed]
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "consumers.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// 802.11n, 20 MHz, MCS7 (65 Mbit/s), short slots, no aggregation
+#define AIR_DIFS_US                         28.0
+#define AIR_BACKOFF_US                      67.5 // Mean of CWmin 15 at 9 us slots
+#define AIR_PREAMBLE_US                     36.0 // HT mixed format
+#define AIR_SIFS_ACK_US                     (10.0 + 28.0) // SIFS and a legacy ACK at 24 Mbit/s
+#define AIR_MBIT_S                          65.0
+#define AIR_FRAME_OVERHEAD_BYTES            (26 + 8 + 20 + 32) // MAC, LLC/SNAP, IPv4, TCP with timestamps
+#define ZENOH_PUT_OVERHEAD_BYTES            16 // Batch length, frame and push headers with a mapped key
+#define ZENOH_KEY_BYTES                     40 // A put on an undeclared key carries the key string
+
+// Assumed CPU time per publication and per received announcement
+#define PUT_CPU_US                          150.0
+#define ANNOUNCE_CPU_US                     60.0
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+#define ANNOUNCE_EVERY_MS                   10000 // As the horn-client soak driver
+#define DELAY_MIN_US                        2000 // One-way delay between consumer and provider
+#define DELAY_MAX_US                        8000
+#define CATCH_UP_MAX                        4096
+
+int host_log_level = 1;
+
+typedef struct
+{
+    const char *name;
+    double present_mean_s; // 0: never present
+    double absent_mean_s;  // 0: always present
+} scenario_t;
+
+typedef struct
+{
+    uint32_t changes;
+    uint32_t published_always;
+    uint32_t published;
+    uint32_t skipped;
+    uint32_t wasted;
+    uint32_t catch_ups;
+    uint32_t announcements;
+    uint32_t lost;
+    int64_t catch_up_us[CATCH_UP_MAX];
+    uint32_t catch_up_count;
+} result_t;
+
+// Scenarios run one after the other on the same clock, s_now_us restarts at 0 each.
+static int64_t s_epoch_us = S;
+static int64_t s_now_us;
+static double s_change_mean_s;
+static uint64_t s_rng;
+static z_sample_handler_t s_handler;
+static bool s_catch_up;
+
+// ESP-IDF and zenoh-pico
+
+int64_t esp_timer_get_time(void)
+{
+    return s_epoch_us + s_now_us;
+}
+
+z_keyexpr_t z_keyexpr(const char *name)
+{
+    return (z_keyexpr_t){.suffix = name};
+}
+
+z_owned_subscriber_t z_declare_subscriber(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_sample_t *callback,
+                                          const void *options)
+{
+    (void)session;
+    (void)options;
+    s_handler = callback->call;
+    return (z_owned_subscriber_t){.p = (void *)keyexpr.suffix};
+}
+
+int8_t z_undeclare_subscriber(z_owned_subscriber_t *subscriber)
+{
+    s_handler = NULL;
+    subscriber->p = NULL;
+    return 0;
+}
+
+// Simulation
+
+static double random_unit(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ULL << 53);
+}
+
+static int64_t random_exponential_us(double mean_s)
+{
+    double unit = random_unit();
+    return (int64_t)(-mean_s * (double)S * log(1.0 - unit));
+}
+
+static int64_t random_delay_us(void)
+{
+    return DELAY_MIN_US + (int64_t)(random_unit() * (DELAY_MAX_US - DELAY_MIN_US));
+}
+
+static double frame_airtime_us(size_t payload_bytes)
+{
+    double bits = 8.0 * (double)(AIR_FRAME_OVERHEAD_BYTES + payload_bytes);
+    return AIR_DIFS_US + AIR_BACKOFF_US + AIR_PREAMBLE_US + bits / AIR_MBIT_S + AIR_SIFS_ACK_US;
+}
+
+static void appeared(void)
+{
+    s_catch_up = true;
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const scenario_t *scenario, int64_t duration_us, double loss, result_t *result)
+{
+    z_session_t session = {.p = result};
+    memset(result, 0, sizeof(*result));
+    consumers_init(appeared);
+    consumers_declare(session);
+
+    bool present = scenario->absent_mean_s == 0;
+    bool informed = false;
+    int64_t subscribed_us = 0;
+    int64_t toggle_us = duration_us;
+    if (!present && scenario->present_mean_s != 0)
+    {
+        toggle_us = random_exponential_us(scenario->absent_mean_s);
+    }
+    int64_t announce_us = present ? 0 : duration_us;
+    int64_t deliver_us = -1;
+    bool deliver_join = false;
+    bool joining = true;
+    int64_t change_us = random_exponential_us(s_change_mean_s);
+    size_t put_bytes = strlen("false") + strlen("type") + strlen("currentValue");
+
+    for (s_now_us = 0; s_now_us < duration_us; s_now_us += MS)
+    {
+        if (s_now_us >= toggle_us)
+        {
+            present = !present;
+            if (present)
+            {
+                subscribed_us = s_now_us;
+                informed = false;
+                joining = true;
+                announce_us = s_now_us;
+                toggle_us = s_now_us + random_exponential_us(scenario->present_mean_s);
+            }
+            else
+            {
+                announce_us = duration_us;
+                toggle_us = s_now_us + random_exponential_us(scenario->absent_mean_s);
+            }
+        }
+
+        if (s_now_us >= announce_us)
+        {
+            announce_us += ANNOUNCE_EVERY_MS * MS;
+            if (random_unit() < loss)
+            {
+                result->lost++;
+            }
+            else
+            {
+                deliver_us = s_now_us + random_delay_us();
+                deliver_join = joining;
+            }
+            joining = false;
+        }
+
+        if (deliver_us >= 0 && s_now_us >= deliver_us)
+        {
+            const char *payload = deliver_join ? "join" : "";
+            z_sample_t sample = {
+                .keyexpr = z_keyexpr(CONSUMERS_KEYEXPR),
+                .payload = {.len = strlen(payload), .start = (const uint8_t *)payload},
+            };
+            deliver_us = -1;
+            result->announcements++;
+            s_catch_up = false;
+            s_handler(&sample, NULL);
+            if (s_catch_up)
+            {
+                result->catch_ups++;
+                result->published++;
+                if (present && !informed)
+                {
+                    informed = true;
+                    if (result->catch_up_count < CATCH_UP_MAX)
+                    {
+                        result->catch_up_us[result->catch_up_count++] = s_now_us + random_delay_us() - subscribed_us;
+                    }
+                }
+            }
+        }
+
+        if (s_now_us >= change_us)
+        {
+            change_us += random_exponential_us(s_change_mean_s);
+            result->changes++;
+            result->published_always++;
+            if (consumers_present())
+            {
+                result->published++;
+                if (!present)
+                {
+                    result->wasted++;
+                }
+                else if (!informed)
+                {
+                    // A change reached the consumer before its catch-up did.
+                    informed = true;
+                    if (result->catch_up_count < CATCH_UP_MAX)
+                    {
+                        result->catch_up_us[result->catch_up_count++] = s_now_us + random_delay_us() - subscribed_us;
+                    }
+                }
+            }
+            else
+            {
+                consumers_skipped(put_bytes);
+                result->skipped++;
+            }
+        }
+    }
+
+    consumers_undeclare();
+    s_epoch_us += duration_us + 2 * (int64_t)CONSUMER_LEASE_MS * MS;
+}
+
+static void report(const scenario_t *scenario, const result_t *result, int64_t duration_us)
+{
+    size_t put_bytes = ZENOH_PUT_OVERHEAD_BYTES + strlen("false") + strlen("type") + strlen("currentValue");
+    size_t announce_bytes = ZENOH_PUT_OVERHEAD_BYTES + ZENOH_KEY_BYTES;
+    // Every put is one data frame to the router and one TCP ACK back.
+    double put_air_us = frame_airtime_us(put_bytes) + frame_airtime_us(0);
+    double announce_air_us = frame_airtime_us(announce_bytes) + frame_airtime_us(0);
+    double hours = (double)duration_us / (3600.0 * S);
+
+    double always_air_ms = result->published_always * put_air_us / 1000.0;
+    double gated_air_ms = (result->published * put_air_us + result->announcements * announce_air_us) / 1000.0;
+    double always_cpu_ms = result->published_always * PUT_CPU_US / 1000.0;
+    double gated_cpu_ms = (result->published * PUT_CPU_US + result->announcements * ANNOUNCE_CPU_US) / 1000.0;
+
+    printf("%s\n", scenario->name);
+    printf("  horn changes %u, currentValue published %u always, %u on demand (%u catch-ups), %u skipped, "
+           "%u sent without a listener\n",
+           result->changes, result->published_always, result->published, result->catch_ups, result->skipped,
+           result->wasted);
+    printf("  announcements received %u, lost %u\n", result->announcements, result->lost);
+    printf("  modelled airtime per hour: %.1f ms always, %.1f ms on demand incl. announcements\n", always_air_ms / hours,
+           gated_air_ms / hours);
+    printf("  modelled CPU time per hour: %.1f ms always, %.1f ms on demand incl. announcements\n",
+           always_cpu_ms / hours, gated_cpu_ms / hours);
+
+    if (result->catch_up_count > 0)
+    {
+        int64_t sorted[CATCH_UP_MAX];
+        uint32_t count = result->catch_up_count;
+        memcpy(sorted, result->catch_up_us, count * sizeof(int64_t));
+        qsort(sorted, count, sizeof(int64_t), compare_us);
+        printf("  subscribe to latest state (%u subscriptions): p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", count,
+               sorted[count / 2] / 1000.0, sorted[(count * 99) / 100] / 1000.0, sorted[count - 1] / 1000.0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double hours = argc > 1 ? atof(argv[1]) : 24.0;
+    s_change_mean_s = argc > 2 ? atof(argv[2]) : 20.0;
+    double loss = argc > 3 ? atof(argv[3]) / 100.0 : 0.05;
+    s_rng = argc > 4 ? strtoull(argv[4], NULL, 0) : 1;
+    if (s_rng == 0)
+    {
+        s_rng = 1;
+    }
+
+    static const scenario_t scenarios[] = {
+        {"bench, a consumer always subscribed", 0, 0},
+        {"dashboard, subscribed 5 min every 30 min", 300, 1800},
+        {"parked, no consumer", 0, 1},
+    };
+    static result_t result;
+    int64_t duration_us = (int64_t)(hours * 3600.0 * S);
+
+    printf("%.1f h per scenario, a horn change every %.1f s on average, consumer lease %d ms, %.0f %% of announcements "
+           "lost (modelled figures)\n",
+           hours, s_change_mean_s, CONSUMER_LEASE_MS, loss * 100.0);
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        run(&scenarios[i], duration_us, loss, &result);
+        report(&scenarios[i], &result, duration_us);
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host check of the sequence fidelity at the output pin.
+ *
+ * Builds main.c unchanged on the host runtime (provider_host.c), whose
+ * gpio_set_level() timestamps every edge on the virtual clock. A player task
+ * plays the sequence horn-client --fidelity requests as the horn service
+ * does: every edge is due at an absolute offset from the start of the
+ * sequence, the player wakes up to PLAYER_LATE_US late, and the targetValue
+ * reaches the provider after LATENCY_US plus up to JITTER_US through the
+ * databroker, in order. Host time spent in the provider counts CPU_SCALE
+ * times on the virtual clock, as in soak_sim.c.
+ *
+ * The captured edges of each run are matched in order with the requested
+ * ones as horn-client does: an edge of the right level within TOLERANCE_US
+ * matches, an expected edge without one is missing, captured edges left over
+ * are extra. It prints the latency of the first edge, the error of each edge
+ * relative to the first one, the drift of a run (the error of its last edge)
+ * and fails on a missing or extra edge.
+ *
+ * Usage: fidelity_sim [runs] [seed]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "provider_host.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+
+#define LATENCY_US                          (3 * MS) // Horn service to the provider through the databroker
+#define JITTER_US                           (5 * MS)
+#define PLAYER_LATE_US                      (1 * MS) // Timer granularity of the horn service
+#define TOLERANCE_US                        (50 * MS)
+#define RUN_SPACING_S                       3 // Between the starts of two runs
+#define RUNS_MAX                            200
+#define CPU_SCALE                           30.0
+
+// The sequence of horn-client --fidelity as (on_time, off_time) in milliseconds
+static const int s_cycles[][2] = {{100, 100}, {200, 300}, {50, 50}, {100, 200}, {500, 250}, {20, 80}};
+#define CYCLE_COUNT                         (sizeof(s_cycles) / sizeof(s_cycles[0]))
+#define EDGE_COUNT                          (2 * CYCLE_COUNT)
+
+int host_log_level = 1;
+
+static uint64_t s_rng;
+static int s_runs;
+static int64_t s_started_us[RUNS_MAX]; // Virtual time each run's request was played from
+static bool s_done;
+
+static uint32_t random_below(uint32_t bound)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)((s_rng >> 32) % bound);
+}
+
+// Transport to the router, which takes everything
+
+void *host_transport_open(const char *locator)
+{
+    (void)locator;
+    host_block_us(15 * MS);
+    return malloc(1);
+}
+
+void host_transport_close(void *transport)
+{
+    free(transport);
+}
+
+bool host_transport_alive(void *transport)
+{
+    (void)transport;
+    return true;
+}
+
+int host_transport_put(void *transport, const char *keyexpr, const uint8_t *payload, size_t len,
+                       const z_attachment_t *attachment)
+{
+    (void)transport;
+    (void)keyexpr;
+    (void)payload;
+    (void)len;
+    (void)attachment;
+    return 0;
+}
+
+// Player
+
+// Offset of edge 'i' from the start of the sequence
+static int64_t edge_offset_us(size_t i)
+{
+    int64_t offset_ms = 0;
+    for (size_t j = 0; j < i; j++)
+    {
+        offset_ms += s_cycles[j / 2][j % 2];
+    }
+    return offset_ms * MS;
+}
+
+static void player_task(void *arg)
+{
+    (void)arg;
+    for (int run = 0; run < s_runs; run++)
+    {
+        int64_t start_us = esp_timer_get_time();
+        int64_t delivered_us = start_us;
+        s_started_us[run] = start_us;
+        for (size_t i = 0; i < EDGE_COUNT; i++)
+        {
+            int64_t played_us = start_us + edge_offset_us(i) + random_below(PLAYER_LATE_US + 1);
+            int64_t arrival_us = played_us + LATENCY_US + random_below(JITTER_US + 1);
+            delivered_us = arrival_us > delivered_us ? arrival_us : delivered_us;
+            host_block_us(delivered_us - esp_timer_get_time());
+            host_deliver(KEYEXPR, i % 2 == 0 ? "true" : "false", "targetValue", NULL);
+        }
+        host_block_us(start_us + RUN_SPACING_S * S - esp_timer_get_time());
+    }
+    s_done = true;
+    vTaskDelay(portMAX_DELAY);
+}
+
+// Comparison
+
+typedef struct
+{
+    int64_t errors_us[EDGE_COUNT]; // Relative to the first edge, INT64_MAX if missing
+    int64_t first_us; // First edge after the request was played
+    size_t missing;
+    size_t extra;
+} run_result_t;
+
+// Matches the edges in [from_us, to_us) in order with the requested ones, as horn-client does.
+static run_result_t compare(const host_gpio_edge_t *edges, size_t count, int64_t from_us, int64_t to_us)
+{
+    run_result_t result = {.first_us = INT64_MAX};
+    size_t next = 0;
+    while (next < count && (edges[next].time_us < from_us || edges[next].gpio_num != LED_GPIO))
+    {
+        next++;
+    }
+    while (next < count && edges[next].time_us < to_us && edges[next].level == 0)
+    {
+        next++;
+        result.extra++;
+    }
+    if (next == count || edges[next].time_us >= to_us)
+    {
+        result.missing = EDGE_COUNT;
+        for (size_t i = 0; i < EDGE_COUNT; i++)
+        {
+            result.errors_us[i] = INT64_MAX;
+        }
+        return result;
+    }
+    int64_t origin_us = edges[next].time_us;
+    result.first_us = origin_us - from_us;
+    for (size_t i = 0; i < EDGE_COUNT; i++)
+    {
+        result.errors_us[i] = INT64_MAX;
+        for (; next < count && edges[next].time_us < to_us; next++)
+        {
+            if (edges[next].gpio_num != LED_GPIO)
+            {
+                continue;
+            }
+            int64_t error_us = edges[next].time_us - (origin_us + edge_offset_us(i));
+            if (edges[next].level == (i % 2 == 0) && llabs(error_us) <= TOLERANCE_US)
+            {
+                result.errors_us[i] = error_us;
+                next++;
+                break;
+            }
+            if (error_us >= -TOLERANCE_US)
+            {
+                break;
+            }
+            result.extra++;
+        }
+        result.missing += result.errors_us[i] == INT64_MAX;
+    }
+    for (; next < count && edges[next].time_us < to_us; next++)
+    {
+        result.extra += edges[next].gpio_num == LED_GPIO;
+    }
+    return result;
+}
+
+static int compare_us(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(int64_t *values, size_t count, int percent)
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    qsort(values, count, sizeof(values[0]), compare_us);
+    size_t rank = (count * percent + 99) / 100;
+    return (double)values[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    s_runs = argc > 1 ? atoi(argv[1]) : 50;
+    s_runs = s_runs < 1 ? 1 : s_runs > RUNS_MAX ? RUNS_MAX : s_runs;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    s_rng = seed != 0 ? seed : 1;
+
+    // The player starts once the provider had time to boot and open its session.
+    int64_t start_us = 10 * S;
+    host_set_cpu_scale(CPU_SCALE);
+    host_start(seed);
+    host_run_until(start_us);
+    host_gpio_edges_clear();
+    xTaskCreate(player_task, "player", 4096, NULL, 1, NULL);
+    host_run_until(start_us + (int64_t)(s_runs + 1) * RUN_SPACING_S * S);
+
+    const host_gpio_edge_t *edges;
+    size_t recorded = host_gpio_edges(&edges);
+    size_t count = recorded < HOST_GPIO_EDGES_MAX ? recorded : HOST_GPIO_EDGES_MAX;
+    static int64_t errors_us[RUNS_MAX * EDGE_COUNT];
+    static int64_t drifts_us[RUNS_MAX];
+    static int64_t firsts_us[RUNS_MAX];
+    size_t error_count = 0;
+    size_t missing = 0;
+    size_t extra = 0;
+    int64_t max_error_us = 0;
+    for (int run = 0; run < s_runs; run++)
+    {
+        int64_t to_us = run + 1 < s_runs ? s_started_us[run + 1] : s_started_us[run] + RUN_SPACING_S * S;
+        run_result_t result = compare(edges, count, s_started_us[run], to_us);
+        int64_t drift_us = 0;
+        for (size_t i = 0; i < EDGE_COUNT; i++)
+        {
+            if (result.errors_us[i] != INT64_MAX)
+            {
+                int64_t error_us = llabs(result.errors_us[i]);
+                errors_us[error_count++] = error_us;
+                max_error_us = error_us > max_error_us ? error_us : max_error_us;
+                drift_us = result.errors_us[i];
+            }
+        }
+        drifts_us[run] = llabs(drift_us);
+        firsts_us[run] = result.first_us;
+        missing += result.missing;
+        extra += result.extra;
+        if (result.missing > 0 || result.extra > 0)
+        {
+            printf("run %d: %zu missing, %zu extra edge(s)\n", run + 1, result.missing, result.extra);
+        }
+    }
+
+    bool failed = !s_done || recorded > count || missing > 0 || extra > 0;
+    printf("%d runs of %zu edges, delivery %lld ms + up to %lld ms, player up to %lld ms late\n", s_runs,
+           (size_t)EDGE_COUNT, LATENCY_US / MS, JITTER_US / MS, PLAYER_LATE_US / MS);
+    printf("first edge: %.1f ms p50, %.1f ms max after the request was played\n",
+           percentile_ms(firsts_us, s_runs, 50), percentile_ms(firsts_us, s_runs, 100));
+    printf("|error|:    %.1f ms p50, %.1f ms p99, %.1f ms max relative to the first edge\n",
+           percentile_ms(errors_us, error_count, 50), percentile_ms(errors_us, error_count, 99),
+           (double)max_error_us / 1000.0);
+    printf("drift:      %.1f ms max; %zu of %zu edges matched, %zu missing, %zu extra\n",
+           percentile_ms(drifts_us, s_runs, 100), error_count, (size_t)s_runs * EDGE_COUNT, missing, extra);
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host benchmark of the actuation history.
+ *
+ * Builds history.c unchanged against a simulated clock and a queryable that
+ * hands the query handler its parameters and collects the pages it replies.
+ * The ring is filled until it wrapped several times, with events of all kinds
+ * at random intervals of up to MAX_GAP_MS and a tenth of them for signals
+ * beyond the horn, some of which need escaped ids.
+ *
+ * It times recording and, on the host clock, the queries a client makes:
+ *
+ * - the whole ring up to the default limit,
+ * - the last minute, which scans the ring up to its newest events,
+ * - a range of a tenth of the time the ring covers, from its middle,
+ * - reading the whole ring with cursor continuations of the default limit.
+ *
+ * Every page is decoded, and the events of a query are checked against the
+ * events recorded: sequence numbers without gaps, the times recorded and
+ * nothing missing from the selected range.
+ *
+ * Usage: history_bench [repetitions] [seed]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "history.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+
+#define MAX_GAP_MS                          2000
+#define FILL_ROUNDS                         4 // Times the ring is overwritten before the queries
+#define EVENTS_MAX                          (FILL_ROUNDS * CONFIG_HISTORY_SIZE) // At least two bytes per event
+
+int host_log_level = 1;
+
+static int64_t s_now_us = S;
+static uint64_t s_rng;
+static int64_t s_times_ms[EVENTS_MAX]; // Recorded time of each event by sequence number
+static uint32_t s_recorded;
+static z_owned_closure_query_t s_handler;
+
+// What a query returned
+typedef struct
+{
+    const char *params;
+    uint32_t events;
+    uint32_t pages;
+    size_t bytes;
+    uint32_t first_seq;
+    uint32_t next_seq; // After the last event
+    bool more;
+    bool broken; // Pages out of order, times differing from the recorded ones
+} bench_query_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint32_t random_below(uint32_t bound)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)((s_rng >> 32) % bound);
+}
+
+// ESP-IDF and zenoh-pico
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+z_keyexpr_t z_keyexpr(const char *name)
+{
+    return (z_keyexpr_t){.suffix = name};
+}
+
+z_owned_queryable_t z_declare_queryable(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_query_t *callback,
+                                        const void *options)
+{
+    (void)session;
+    (void)keyexpr;
+    (void)options;
+    s_handler = *callback;
+    return (z_owned_queryable_t){.p = &s_handler};
+}
+
+int8_t z_undeclare_queryable(z_owned_queryable_t *queryable)
+{
+    queryable->p = NULL;
+    return 0;
+}
+
+z_bytes_t z_query_parameters(const z_query_t *query)
+{
+    const bench_query_t *bench = query->p;
+    return (z_bytes_t){.len = strlen(bench->params), .start = (const uint8_t *)bench->params};
+}
+
+z_query_reply_options_t z_query_reply_options_default(void)
+{
+    return (z_query_reply_options_t){.attachment = {.data = NULL}};
+}
+
+static bool get_varint(const uint8_t **pos, const uint8_t *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; *pos < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *(*pos)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decodes a page as a client does and checks its events against the recorded ones.
+int8_t z_query_reply(const z_query_t *query, z_keyexpr_t keyexpr, const uint8_t *payload, size_t len,
+                     const z_query_reply_options_t *options)
+{
+    (void)keyexpr;
+    (void)options;
+    bench_query_t *bench = query->p;
+    const uint8_t *pos = payload + 2;
+    const uint8_t *end = payload + len;
+    uint64_t seq, time_ms, reply_ms, count;
+    bench->pages++;
+    bench->bytes += len;
+    if (len < 2 || payload[0] != HISTORY_PAGE_VERSION || !get_varint(&pos, end, &seq) ||
+        !get_varint(&pos, end, &time_ms) || !get_varint(&pos, end, &reply_ms) || !get_varint(&pos, end, &count))
+    {
+        bench->broken = true;
+        return -1;
+    }
+    bench->more = (payload[1] & HISTORY_PAGE_MORE) != 0;
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (bench->events == 0)
+    {
+        bench->first_seq = (uint32_t)seq;
+    }
+    else if (seq != bench->next_seq)
+    {
+        bench->broken = true;
+    }
+
+    for (uint64_t i = 0; i < count; i++, seq++)
+    {
+        uint64_t id, delta;
+        if (pos >= end)
+        {
+            bench->broken = true;
+            return -1;
+        }
+        id = *pos++ >> 4;
+        if ((id == HISTORY_ID_ESCAPE && !get_varint(&pos, end, &id)) || !get_varint(&pos, end, &delta))
+        {
+            bench->broken = true;
+            return -1;
+        }
+        time_ms += delta;
+        if (seq >= s_recorded || time_ms != (uint64_t)s_times_ms[seq])
+        {
+            bench->broken = true;
+        }
+    }
+    bench->events += (uint32_t)count;
+    bench->next_seq = (uint32_t)seq;
+    bench->broken = bench->broken || pos != end;
+    return 0;
+}
+
+// Bench
+
+static bench_query_t query(const char *params)
+{
+    bench_query_t bench = {.params = params};
+    z_query_t query = {.p = &bench};
+    s_handler.call(&query, NULL);
+    return bench;
+}
+
+static void fill(uint32_t bytes)
+{
+    static const history_event_t kinds[] = {HISTORY_TARGET, HISTORY_APPLIED, HISTORY_ACKED, HISTORY_REJECTED,
+                                             HISTORY_FAILSAFE};
+    for (uint32_t written = 0; written < bytes && s_recorded < EVENTS_MAX; written += 2)
+    {
+        s_now_us += (int64_t)random_below(MAX_GAP_MS + 1) * MS;
+        signal_id_t id = random_below(10) == 0 ? (signal_id_t)random_below(SIGNAL_COUNT) : SIGNAL_HORN;
+        s_times_ms[s_recorded++] = s_now_us / 1000;
+        history_record(id, kinds[random_below(5)], random_below(2) != 0);
+    }
+}
+
+// Number of events recorded from 'first_seq' on with a time in [from_ms, to_ms]
+static uint32_t expected(uint32_t first_seq, int64_t from_ms, int64_t to_ms)
+{
+    uint32_t count = 0;
+    for (uint32_t seq = first_seq; seq < s_recorded; seq++)
+    {
+        count += s_times_ms[seq] >= from_ms && s_times_ms[seq] <= to_ms;
+    }
+    return count;
+}
+
+/*
+ * Runs the query 'repetitions' times and prints the host time per query and
+ * per event returned. Returns false if the query returned other events than
+ * 'expected_events' from 'first_seq' on.
+ */
+static bool bench(const char *name, const char *params, uint32_t repetitions, uint32_t first_seq,
+                  uint32_t expected_events)
+{
+    bench_query_t result = query(params);
+    double started_ns = now_ns();
+    for (uint32_t i = 0; i < repetitions; i++)
+    {
+        query(params);
+    }
+    double query_ns = (now_ns() - started_ns) / repetitions;
+    bool ok = !result.broken && result.events == expected_events && (result.events == 0 || result.first_seq >= first_seq);
+    printf("  %-10s %5u events in %3u pages (%5zu bytes), %8.1f us per query, %6.1f ns per event%s%s\n", name,
+           result.events, result.pages, result.bytes, query_ns / 1000.0,
+           result.events > 0 ? query_ns / result.events : 0.0, result.more ? ", more left" : "", ok ? "" : ", FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t repetitions = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 200;
+    s_rng = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    repetitions = repetitions > 0 ? repetitions : 1;
+    s_rng = s_rng != 0 ? s_rng : 1;
+    history_declare((z_session_t){.p = &s_handler});
+
+    double started_ns = now_ns();
+    fill(FILL_ROUNDS * CONFIG_HISTORY_SIZE);
+    double record_ns = (now_ns() - started_ns) / s_recorded;
+
+    // The walk reads the whole ring, its first event is the oldest one kept.
+    char params[96];
+    bench_query_t walk = {0};
+    uint32_t walk_queries = 0;
+    bool walk_ok = true;
+    started_ns = now_ns();
+    do
+    {
+        snprintf(params, sizeof(params), "cursor=%u", walk.next_seq);
+        bench_query_t page = query(params);
+        walk_ok = walk_ok && !page.broken && (walk_queries == 0 || page.first_seq == walk.next_seq);
+        walk.first_seq = walk_queries == 0 ? page.first_seq : walk.first_seq;
+        walk.next_seq = page.next_seq;
+        walk.events += page.events;
+        walk.pages += page.pages;
+        walk.bytes += page.bytes;
+        walk.more = page.more;
+        walk_queries++;
+    } while (walk.more && walk_ok);
+    double walk_ns = now_ns() - started_ns;
+    uint32_t kept = s_recorded - walk.first_seq;
+    walk_ok = walk_ok && walk.events == kept && walk.next_seq == s_recorded;
+
+    int64_t oldest_ms = s_times_ms[walk.first_seq];
+    int64_t newest_ms = s_times_ms[s_recorded - 1];
+    printf("%d byte ring, %u events kept of %u recorded, %.1f h, signal ids up to %d\n", CONFIG_HISTORY_SIZE, kept,
+           s_recorded, (double)(newest_ms - oldest_ms) / 3600000.0, SIGNAL_COUNT - 1);
+    printf("  record     %.1f ns per event\n", record_ns);
+
+    bool ok = bench("all", "", repetitions, walk.first_seq,
+                    kept < HISTORY_QUERY_MAX_EVENTS ? kept : HISTORY_QUERY_MAX_EVENTS);
+    snprintf(params, sizeof(params), "from=%lld", (long long)(newest_ms - 60000));
+    ok = bench("last min", params, repetitions, walk.first_seq, expected(walk.first_seq, newest_ms - 60000, INT64_MAX)) &&
+         ok;
+    int64_t from_ms = oldest_ms + (newest_ms - oldest_ms) * 9 / 20;
+    int64_t to_ms = from_ms + (newest_ms - oldest_ms) / 10;
+    snprintf(params, sizeof(params), "from=%lld;to=%lld", (long long)from_ms, (long long)to_ms);
+    uint32_t in_range = expected(walk.first_seq, from_ms, to_ms);
+    ok = bench("range", params, repetitions, walk.first_seq,
+               in_range < HISTORY_QUERY_MAX_EVENTS ? in_range : HISTORY_QUERY_MAX_EVENTS) &&
+         ok;
+    printf("  %-10s %5u events in %3u pages (%5zu bytes), %8.1f us in %u queries, %6.1f ns per event%s\n",
+           "walk", walk.events, walk.pages, walk.bytes, walk_ns / 1000.0, walk_queries,
+           walk.events > 0 ? walk_ns / walk.events : 0.0, walk_ok ? "" : ", FAILED");
+
+    history_undeclare();
+    return ok && walk_ok ? 0 : 1;
+}
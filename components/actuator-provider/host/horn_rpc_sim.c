@@ -0,0 +1,163 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host check of the ActivateHorn request decoding.
+ *
+ * Builds uprotocol.c, horn_pb.c and pb.c unchanged and feeds them requests as
+ * up-transport-zenoh delivers them to the queryable in horn_rpc.c: the
+ * attributes in the attachment and the payload in the query value. The
+ * payloads are the bytes up-rust 0.2 sends for UPayload::try_from_protobuf(),
+ * a google.protobuf.Any with the format UPAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY
+ * in the attributes. They were produced with
+ *
+ *   protoc -I components/horn-proto/proto -I /usr/include --encode=google.protobuf.Any \
+ *       google/protobuf/any.proto vehicle/body/horn/v1/horn_service.proto
+ *
+ * from "[type.googleapis.com/vehicle.body.horn.v1.ActivateHornRequest] { mode:
+ * HM_SEQUENCED command { horn_cycles { on_time: 500 off_time: 300 } } }",
+ * which encodes the Any like the protobuf crate's Any::pack().
+ *
+ * Usage: horn_rpc_sim
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "horn_pb.h"
+#include "uprotocol.h"
+
+// One sequence of a 500 ms honk and a 300 ms pause
+#define REQUEST                             "\x08\x02\x12\x08\x0a\x06\x08\xf4\x03\x10\xac\x02"
+
+static const uint8_t s_wrapped[] = "\x0a\x3c"
+                                   "type.googleapis.com/vehicle.body.horn.v1.ActivateHornRequest"
+                                   "\x12\x0c" REQUEST;
+static const uint8_t s_plain[] = REQUEST;
+// An empty message packs to a type URL without value.
+static const uint8_t s_wrapped_deactivate[] = "\x0a\x3e"
+                                              "type.googleapis.com/vehicle.body.horn.v1.DeactivateHornRequest";
+
+/*
+ * UAttributes of the request to ActivateHorn from a client with ue_id 0x4321,
+ * the fields in the order the protobuf crate writes them. The payload format,
+ * field 12, is appended by attributes().
+ */
+static const uint8_t s_attributes[] =
+    "\x0a\x12"                                          // id
+    "\x09\x00\x80\x0d\x0c\x0b\x0a\x92\x01"              //   msb, 0x01920a0b0c0d8000
+    "\x11\x01\x00\x00\x00\x00\x00\x00\x80"              //   lsb
+    "\x10\x02"                                          // type UMESSAGE_TYPE_REQUEST
+    "\x1a\x0f\x0a\x07vehicle\x10\xa1\x86\x01\x18\x01"   // source //vehicle/4321/1/0
+    "\x22\x0f\x0a\x07vehicle\x10\x1c\x18\x01\x20\x01"   // sink //vehicle/1C/1/1
+    "\x28\x05"                                          // priority UPRIORITY_CS4
+    "\x30\x88\x27";                                     // ttl 5000 ms
+
+typedef struct
+{
+    uint8_t buf[UP_ATTRIBUTES_MAX_LEN];
+    size_t len;
+} attributes_t;
+
+static int s_failures;
+
+// Minimal zenoh-pico attachment and esp_random() for uprotocol.c
+
+z_bytes_t _z_bytes_wrap(const uint8_t *start, size_t len)
+{
+    return (z_bytes_t){.len = len, .start = start};
+}
+
+bool z_attachment_check(const z_attachment_t *attachment)
+{
+    return attachment->data != NULL;
+}
+
+int8_t z_attachment_iterate(z_attachment_t attachment, z_attachment_iter_body_t body, void *ctx)
+{
+    return attachment.iteration_driver(attachment.data, body, ctx);
+}
+
+uint32_t esp_random(void)
+{
+    return (uint32_t)rand();
+}
+
+// The attachment up-transport-zenoh sends: the attributes version and the attributes, both with empty keys
+static int8_t attachment_iterate(const void *data, z_attachment_iter_body_t body, void *ctx)
+{
+    static const uint8_t version = 1;
+    const attributes_t *attributes = data;
+    int8_t ret = body(_z_bytes_wrap(NULL, 0), _z_bytes_wrap(&version, 1), ctx);
+    return ret != 0 ? ret : body(_z_bytes_wrap(NULL, 0), _z_bytes_wrap(attributes->buf, attributes->len), ctx);
+}
+
+static attributes_t attributes(uint8_t payload_format)
+{
+    attributes_t attributes;
+    attributes.len = sizeof(s_attributes) - 1;
+    memcpy(attributes.buf, s_attributes, attributes.len);
+    if (payload_format != UP_PAYLOAD_FORMAT_UNSPECIFIED)
+    {
+        attributes.buf[attributes.len++] = 12 << 3;
+        attributes.buf[attributes.len++] = payload_format;
+    }
+    return attributes;
+}
+
+// Decodes a request as horn_rpc.c does and compares the outcome.
+static void check(const char *name, uint8_t payload_format, const uint8_t *payload, size_t len, int expected)
+{
+    attributes_t storage = attributes(payload_format);
+    z_attachment_t attachment = {.data = &storage, .iteration_driver = attachment_iterate};
+    up_received_t request;
+    horn_request_t decoded;
+
+    bool ok = up_attachment_parse(attachment, &request) == 0 && request.payload_format == payload_format &&
+              request.type == UP_MESSAGE_TYPE_REQUEST && request.sink.ue_id == 0x1c && request.sink.resource_id == 1 &&
+              strcmp(request.source_authority, "vehicle") == 0 && request.ttl_ms == 5000;
+    int code = ok ? horn_request_decode(request.payload_format, payload, len, &decoded) : -1;
+    ok = ok && code == expected;
+    if (ok && expected == HORN_CODE_OK)
+    {
+        ok = decoded.mode == HM_SEQUENCED && decoded.sequence_count == 1 && decoded.sequences[0].cycle_count == 1 &&
+             decoded.sequences[0].cycles[0].on_ms == 500 && decoded.sequences[0].cycles[0].off_ms == 300;
+    }
+    printf("%-44s code %2d, %s\n", name, code, ok ? "ok" : "FAILED");
+    s_failures += ok ? 0 : 1;
+}
+
+int main(void)
+{
+    check("up-rust payload wrapped in Any", UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY, s_wrapped,
+          sizeof(s_wrapped) - 1, HORN_CODE_OK);
+    check("plain protobuf payload", UP_PAYLOAD_FORMAT_PROTOBUF, s_plain, sizeof(s_plain) - 1, HORN_CODE_OK);
+    check("unspecified format, plain payload", UP_PAYLOAD_FORMAT_UNSPECIFIED, s_plain, sizeof(s_plain) - 1,
+          HORN_CODE_OK);
+    check("Any holding a DeactivateHornRequest", UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY, s_wrapped_deactivate,
+          sizeof(s_wrapped_deactivate) - 1, HORN_CODE_INVALID_ARGUMENT);
+    check("plain payload declared as wrapped in Any", UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY, s_plain,
+          sizeof(s_plain) - 1, HORN_CODE_INVALID_ARGUMENT);
+    check("Any truncated in the type URL", UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY, s_wrapped, 20,
+          HORN_CODE_INVALID_ARGUMENT);
+    check("JSON payload", 3, (const uint8_t *)"{\"mode\":\"HM_SEQUENCED\"}", 23, HORN_CODE_INVALID_ARGUMENT);
+
+    if (s_failures > 0)
+    {
+        printf("%d scenarios failed.\n", s_failures);
+        return 1;
+    }
+    printf("All scenarios passed.\n");
+    return 0;
+}
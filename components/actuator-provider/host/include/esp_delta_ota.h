@@ -0,0 +1,38 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HOST_ESP_DELTA_OTA_H
+#define HOST_ESP_DELTA_OTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef void *esp_delta_ota_handle_t;
+typedef esp_err_t (*src_read_cb_t)(uint8_t *buf, size_t size, int src_offset);
+typedef esp_err_t (*merged_stream_write_cb_with_user_data)(const uint8_t *buf, size_t size, void *user_data);
+
+typedef struct
+{
+    void *user_data;
+    src_read_cb_t read_cb;
+    merged_stream_write_cb_with_user_data write_cb_with_user_data;
+} esp_delta_ota_cfg_t;
+
+esp_delta_ota_handle_t esp_delta_ota_init(esp_delta_ota_cfg_t *cfg);
+esp_err_t esp_delta_ota_feed_patch(esp_delta_ota_handle_t handle, const uint8_t *buf, int size);
+esp_err_t esp_delta_ota_finalize(esp_delta_ota_handle_t handle);
+esp_err_t esp_delta_ota_deinit(esp_delta_ota_handle_t handle);
+
+#endif
@@ -0,0 +1,44 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+/*
+ * Host shims of the ESP-IDF, FreeRTOS and zenoh-pico APIs used by the sources
+ * built in host/. They declare only what those sources call; the host
+ * programs provide the implementations.
+ */
+#ifndef HOST_ESP_ERR_H
+#define HOST_ESP_ERR_H
+
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                              0
+#define ESP_FAIL                            -1
+#define ESP_ERR_INVALID_ARG                 0x102
+#define ESP_ERR_INVALID_STATE               0x103
+#define ESP_ERR_INVALID_SIZE                0x104
+#define ESP_ERR_OTA_PARTITION_CONFLICT      0x1501
+#define ESP_ERR_OTA_VALIDATE_FAILED         0x1503
+
+#define ESP_ERROR_CHECK(x)                                                            \
+    do                                                                                \
+    {                                                                                 \
+        if ((x) != ESP_OK)                                                            \
+        {                                                                             \
+            abort();                                                                  \
+        }                                                                             \
+    } while (0)
+
+#endif
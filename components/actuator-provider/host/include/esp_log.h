@@ -0,0 +1,37 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+// Set by the host program: 0 silences everything, 1 errors, 2 warnings, 3 info
+extern int host_log_level;
+
+#define HOST_LOG(level, letter, tag, format, ...)                                     \
+    do                                                                                \
+    {                                                                                 \
+        if (host_log_level >= (level))                                                \
+        {                                                                             \
+            printf(letter " (%s) " format "\n", tag, ##__VA_ARGS__);                  \
+        }                                                                             \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...)          HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)          HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)          HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)          HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,42 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ                  100
+#define configMAX_PRIORITIES                25
+#define portMAX_DELAY                       ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)                   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTRUE                              1
+#define pdFALSE                             0
+#define pdPASS                              pdTRUE
+
+// Host tasks never preempt each other, critical sections need no lock.
+typedef struct
+{
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED        {0}
+#define portENTER_CRITICAL(mux)             ((void)(mux))
+#define portEXIT_CRITICAL(mux)              ((void)(mux))
+
+#endif
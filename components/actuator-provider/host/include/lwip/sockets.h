@@ -0,0 +1,34 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+// lwIP offers the BSD socket API, on the host it is the system's own.
+#include <sys/select.h>
+#include <sys/socket.h>
+
+/*
+ * Like lwIP, which maps the BSD names to lwip_connect() and lwip_select(), the
+ * calls that wait for the network go through the host runtime. It reports a
+ * connection as established or refused once the round-trip time set with
+ * host_set_rtt() passed on the virtual clock, see provider_host.h.
+ */
+int host_connect(int fd, const struct sockaddr *address, socklen_t address_len);
+int host_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+
+#define connect                             host_connect
+#define select                              host_select
+
+#endif
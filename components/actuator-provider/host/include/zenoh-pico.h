@@ -0,0 +1,220 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HOST_ZENOH_PICO_H
+#define HOST_ZENOH_PICO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define Z_FEATURE_PUBLICATION               1
+#define Z_FEATURE_ATTACHMENT                1
+#ifndef Z_FEATURE_QUERYABLE
+#define Z_FEATURE_QUERYABLE                 0
+#endif
+
+#define Z_CONFIG_MODE_KEY                   0x40
+#define Z_CONFIG_CONNECT_KEY                0x41
+
+typedef struct
+{
+    void *p;
+} z_session_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_session_t;
+
+typedef struct
+{
+    void *p;
+} z_config_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_config_t;
+
+typedef struct
+{
+    char *val;
+} z_string_t;
+
+typedef struct
+{
+    char *p;
+} z_owned_str_t;
+
+typedef struct
+{
+    const char *suffix;
+} z_keyexpr_t;
+
+typedef struct
+{
+    size_t len;
+    const uint8_t *start;
+} z_bytes_t;
+
+typedef int8_t (*z_attachment_iter_body_t)(z_bytes_t key, z_bytes_t value, void *ctx);
+typedef int8_t (*z_attachment_iter_driver_t)(const void *data, z_attachment_iter_body_t body, void *ctx);
+
+typedef struct
+{
+    const void *data;
+    z_attachment_iter_driver_t iteration_driver;
+} z_attachment_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_bytes_map_t;
+
+typedef struct
+{
+    z_keyexpr_t keyexpr;
+    z_bytes_t payload;
+    z_attachment_t attachment;
+} z_sample_t;
+
+typedef void (*z_sample_handler_t)(const z_sample_t *sample, void *arg);
+
+typedef struct
+{
+    z_sample_handler_t call;
+} z_owned_closure_sample_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_subscriber_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_publisher_t;
+
+typedef struct
+{
+    void *p;
+} z_publisher_t;
+
+typedef struct
+{
+    z_attachment_t attachment;
+} z_publisher_put_options_t;
+
+typedef struct
+{
+    z_bytes_t payload;
+} z_value_t;
+
+// Queries are served by the host program that declares a queryable.
+typedef struct
+{
+    void *p;
+} z_query_t;
+
+typedef void (*z_query_handler_t)(const z_query_t *query, void *arg);
+
+typedef struct
+{
+    z_query_handler_t call;
+} z_owned_closure_query_t;
+
+typedef struct
+{
+    void *p;
+} z_owned_queryable_t;
+
+typedef struct
+{
+    z_attachment_t attachment;
+} z_query_reply_options_t;
+
+static inline z_session_t z_session_loan(const z_owned_session_t *session)
+{
+    return (z_session_t){.p = session->p};
+}
+
+static inline z_config_t z_config_loan(const z_owned_config_t *config)
+{
+    return (z_config_t){.p = config->p};
+}
+
+static inline z_publisher_t z_publisher_loan(const z_owned_publisher_t *publisher)
+{
+    return (z_publisher_t){.p = publisher->p};
+}
+
+#define z_closure(callback)                                                           \
+    _Generic((callback),                                                              \
+        z_query_handler_t: (z_owned_closure_query_t){.call = (z_query_handler_t)(callback)}, \
+        default: (z_owned_closure_sample_t){.call = (z_sample_handler_t)(callback)})
+#define z_move(x)                           (&(x))
+#define z_loan(x)                                                                     \
+    _Generic((x),                                                                     \
+        z_owned_session_t: z_session_loan,                                            \
+        z_owned_config_t: z_config_loan,                                              \
+        z_owned_publisher_t: z_publisher_loan)(&(x))
+#define z_check(x)                          ((x).p != NULL)
+#define z_str_move(x)                       (x)
+
+z_keyexpr_t z_keyexpr(const char *name);
+z_owned_publisher_t z_declare_publisher(z_session_t session, z_keyexpr_t keyexpr, const void *options);
+int8_t z_undeclare_publisher(z_owned_publisher_t *publisher);
+z_owned_subscriber_t z_declare_subscriber(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_sample_t *callback,
+                                          const void *options);
+int8_t z_undeclare_subscriber(z_owned_subscriber_t *subscriber);
+int8_t z_publisher_put(z_publisher_t publisher, const uint8_t *payload, size_t len,
+                       const z_publisher_put_options_t *options);
+z_publisher_put_options_t z_publisher_put_options_default(void);
+z_owned_queryable_t z_declare_queryable(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_query_t *callback,
+                                        const void *options);
+int8_t z_undeclare_queryable(z_owned_queryable_t *queryable);
+z_bytes_t z_query_parameters(const z_query_t *query);
+z_value_t z_query_value(const z_query_t *query);
+z_attachment_t z_query_attachment(const z_query_t *query);
+z_keyexpr_t z_query_keyexpr(const z_query_t *query);
+z_query_reply_options_t z_query_reply_options_default(void);
+int8_t z_query_reply(const z_query_t *query, z_keyexpr_t keyexpr, const uint8_t *payload, size_t len,
+                     const z_query_reply_options_t *options);
+
+z_owned_config_t z_config_default(void);
+z_string_t z_string_make(const char *value);
+int8_t zp_config_insert(z_config_t config, uint8_t key, z_string_t value);
+z_owned_session_t z_open(z_owned_config_t *config);
+int8_t z_close(z_owned_session_t *session);
+int8_t zp_start_read_task(z_session_t session, const void *options);
+int8_t zp_stop_read_task(z_session_t session);
+int8_t zp_start_lease_task(z_session_t session, const void *options);
+int8_t zp_stop_lease_task(z_session_t session);
+int8_t zp_send_keep_alive(z_session_t session, const void *options);
+
+z_bytes_t _z_bytes_wrap(const uint8_t *start, size_t len);
+z_owned_bytes_map_t z_bytes_map_new(void);
+void z_bytes_map_insert_by_alias(const z_owned_bytes_map_t *map, z_bytes_t key, z_bytes_t value);
+z_attachment_t z_bytes_map_as_attachment(const z_owned_bytes_map_t *map);
+void z_bytes_map_drop(z_owned_bytes_map_t *map);
+bool z_attachment_check(const z_attachment_t *attachment);
+int8_t z_attachment_iterate(z_attachment_t attachment, z_attachment_iter_body_t body, void *ctx);
+z_bytes_t z_attachment_get(z_attachment_t attachment, z_bytes_t key);
+
+z_owned_str_t z_keyexpr_to_string(z_keyexpr_t keyexpr);
+const char *z_str_loan(const z_owned_str_t *str);
+void z_str_drop(z_owned_str_t *str);
+
+#endif
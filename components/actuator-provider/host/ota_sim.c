@@ -0,0 +1,714 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+/*
+ * Host simulation of firmware updates over Zenoh.
+ *
+ * Builds ota.c unchanged against a model of a 4 MB flash laid out with the
+ * "Factory app, two OTA definitions" partition table and streams updates
+ * through it in the fragments the firmware updater sends. The model enforces
+ * what the device does: writes only into erased sectors of the target slot,
+ * image verification in esp_ota_end and a boot switch only for verified images.
+ * After every update it checks the target slot against the expected image and
+ * that no other partition was touched.
+ *
+ * The diff decoder is a stand-in for esp_delta_ota: a copy/insert stream
+ * against the running image, decoded with a fixed 256 byte buffer. It exercises
+ * the same data path (base reads, sequential writes) but not the compression
+ * of the real patch generator, so the delta sizes reported here only reflect
+ * how many 4 KB blocks changed.
+ *
+ * Usage: ota_sim [fragment_size]
+ */
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zenoh-pico.h>
+#include "esp_delta_ota.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "ota.h"
+
+#define FLASH_SIZE                          (4 * 1024 * 1024)
+#define SECTOR_SIZE                         4096
+#define IMAGE_MAGIC                         0xE9
+#define IMAGE_DIGEST_SIZE                   32
+#define PATCH_HEADER_SIZE                   64
+#define PATCH_MAGIC                         0xfccdde10
+#define Z_FRAG_MAX_SIZE                     1024
+#define DEFAULT_FRAGMENT_SIZE               768
+#define DELTA_OP_COPY                       'C'
+#define DELTA_OP_INSERT                     'I'
+#define DELTA_BUFFER_SIZE                   256
+
+int host_log_level = 1;
+
+// "Factory app, two OTA definitions" (partitions_two_ota.csv)
+enum
+{
+    PART_NVS,
+    PART_OTADATA,
+    PART_PHY_INIT,
+    PART_FACTORY,
+    PART_OTA_0,
+    PART_OTA_1,
+    PART_COUNT
+};
+
+static const esp_partition_t s_partitions[PART_COUNT] = {
+    [PART_NVS] = {.address = 0x9000, .size = 0x4000, .label = "nvs"},
+    [PART_OTADATA] = {.address = 0xd000, .size = 0x2000, .label = "otadata"},
+    [PART_PHY_INIT] = {.address = 0xf000, .size = 0x1000, .label = "phy_init"},
+    [PART_FACTORY] = {.address = 0x10000, .size = 0x100000, .label = "factory"},
+    [PART_OTA_0] = {.address = 0x110000, .size = 0x100000, .label = "ota_0"},
+    [PART_OTA_1] = {.address = 0x210000, .size = 0x100000, .label = "ota_1"},
+};
+
+static uint8_t s_flash[FLASH_SIZE];
+static uint32_t s_image_len[PART_COUNT];
+static int s_running = PART_FACTORY;
+static int s_boot = PART_FACTORY;
+static uint32_t s_otadata_seq;
+
+// The update in progress
+static struct
+{
+    bool open;
+    int part;
+    uint32_t written;
+    uint32_t erased;
+} s_write;
+
+// Counters of the current update
+static struct
+{
+    uint32_t sectors_erased;
+    uint32_t bytes_written;
+    uint32_t base_read;
+} s_stats;
+
+static z_sample_handler_t s_ota_handler;
+static char s_status[128];
+static jmp_buf s_restart;
+
+static int partition_index(const esp_partition_t *partition)
+{
+    return (int)(partition - s_partitions);
+}
+
+// Stand-in for the SHA-256 of an image: FNV-1a, spread over 32 bytes.
+static void image_digest(const uint8_t *data, size_t len, uint8_t digest[IMAGE_DIGEST_SIZE])
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    for (int i = 0; i < IMAGE_DIGEST_SIZE; i++)
+    {
+        digest[i] = (uint8_t)(hash >> ((i % 8) * 8)) ^ (uint8_t)i;
+    }
+}
+
+static uint64_t digest_region(uint32_t address, uint32_t size)
+{
+    uint8_t digest[IMAGE_DIGEST_SIZE];
+    uint64_t folded;
+    image_digest(s_flash + address, size, digest);
+    memcpy(&folded, digest, sizeof(folded));
+    return folded;
+}
+
+static void flash_erase_sector(uint32_t address)
+{
+    memset(s_flash + address, 0xff, SECTOR_SIZE);
+    s_stats.sectors_erased++;
+}
+
+// NOR flash can only clear bits, so writing into a sector that was not erased corrupts it.
+static esp_err_t flash_write(uint32_t address, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (s_flash[address + i] != 0xff)
+        {
+            printf("FAIL: write into unerased flash at 0x%06x\n", (unsigned)(address + i));
+            return ESP_FAIL;
+        }
+        s_flash[address + i] = data[i];
+    }
+    s_stats.bytes_written += size;
+    return ESP_OK;
+}
+
+// ESP-IDF
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
+
+void esp_restart(void)
+{
+    longjmp(s_restart, 1);
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (src_offset + size > partition->size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, s_flash + partition->address + src_offset, size);
+    s_stats.base_read += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    uint32_t len = s_image_len[partition_index(partition)];
+    if (len == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    image_digest(s_flash + partition->address, len, sha_256);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_partitions[s_running];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void)start_from;
+    return &s_partitions[s_running == PART_OTA_0 ? PART_OTA_1 : PART_OTA_0];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    int part = partition_index(partition);
+    if (image_size != OTA_WITH_SEQUENTIAL_WRITES || part == s_running || s_write.open)
+    {
+        return part == s_running ? ESP_ERR_OTA_PARTITION_CONFLICT : ESP_ERR_INVALID_ARG;
+    }
+    s_write.open = true;
+    s_write.part = part;
+    s_write.written = 0;
+    s_write.erased = 0;
+    s_image_len[part] = 0;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    const esp_partition_t *partition = &s_partitions[s_write.part];
+    if (!s_write.open || handle != 1)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write.written + size > partition->size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Sequential writes erase each sector right before the first write into it.
+    while (s_write.erased < s_write.written + size)
+    {
+        flash_erase_sector(partition->address + s_write.erased);
+        s_write.erased += SECTOR_SIZE;
+    }
+    if (flash_write(partition->address + s_write.written, data, size) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    s_write.written += size;
+    return ESP_OK;
+}
+
+// Stand-in for esp_image_verify: the magic byte and the digest appended to the image.
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (!s_write.open || handle != 1)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_write.open = false;
+    const uint8_t *image = s_flash + s_partitions[s_write.part].address;
+    uint8_t digest[IMAGE_DIGEST_SIZE];
+    if (s_write.written <= IMAGE_DIGEST_SIZE || image[0] != IMAGE_MAGIC)
+    {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    uint32_t body = s_write.written - IMAGE_DIGEST_SIZE;
+    image_digest(image, body, digest);
+    if (memcmp(digest, image + body, IMAGE_DIGEST_SIZE) != 0)
+    {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    s_image_len[s_write.part] = s_write.written;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    (void)handle;
+    s_write.open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    int part = partition_index(partition);
+    if (s_image_len[part] == 0)
+    {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    // otadata holds two sectors which are written alternately.
+    const esp_partition_t *otadata = &s_partitions[PART_OTADATA];
+    uint32_t sector = otadata->address + (++s_otadata_seq % 2) * SECTOR_SIZE;
+    flash_erase_sector(sector);
+    flash_write(sector, (const uint8_t *)&s_otadata_seq, sizeof(s_otadata_seq));
+    s_boot = part;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
+
+// Stand-in diff decoder: a stream of "C <src offset> <len>" and "I <len> <data>"
+// operations, all numbers little endian u32.
+typedef struct
+{
+    esp_delta_ota_cfg_t cfg;
+    uint8_t op;
+    uint8_t args[8];
+    size_t args_len;
+    uint32_t insert_left;
+} delta_t;
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t delta_copy(delta_t *delta, uint32_t src_offset, uint32_t len)
+{
+    uint8_t buf[DELTA_BUFFER_SIZE];
+    while (len > 0)
+    {
+        size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+        if (delta->cfg.read_cb(buf, chunk, (int)src_offset) != ESP_OK ||
+            delta->cfg.write_cb_with_user_data(buf, chunk, delta->cfg.user_data) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        src_offset += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+esp_delta_ota_handle_t esp_delta_ota_init(esp_delta_ota_cfg_t *cfg)
+{
+    delta_t *delta = calloc(1, sizeof(delta_t));
+    if (delta != NULL)
+    {
+        delta->cfg = *cfg;
+    }
+    return delta;
+}
+
+esp_err_t esp_delta_ota_feed_patch(esp_delta_ota_handle_t handle, const uint8_t *buf, int size)
+{
+    delta_t *delta = handle;
+    while (size > 0)
+    {
+        if (delta->insert_left > 0)
+        {
+            size_t chunk = (size_t)size < delta->insert_left ? (size_t)size : delta->insert_left;
+            if (delta->cfg.write_cb_with_user_data(buf, chunk, delta->cfg.user_data) != ESP_OK)
+            {
+                return ESP_FAIL;
+            }
+            delta->insert_left -= chunk;
+            buf += chunk;
+            size -= (int)chunk;
+            continue;
+        }
+        if (delta->op == 0)
+        {
+            delta->op = *buf++;
+            size--;
+            delta->args_len = 0;
+            if (delta->op != DELTA_OP_COPY && delta->op != DELTA_OP_INSERT)
+            {
+                return ESP_FAIL;
+            }
+            continue;
+        }
+        size_t need = (delta->op == DELTA_OP_COPY ? 8 : 4) - delta->args_len;
+        size_t chunk = (size_t)size < need ? (size_t)size : need;
+        memcpy(delta->args + delta->args_len, buf, chunk);
+        delta->args_len += chunk;
+        buf += chunk;
+        size -= (int)chunk;
+        if (chunk < need)
+        {
+            continue;
+        }
+        if (delta->op == DELTA_OP_COPY && delta_copy(delta, read_u32(delta->args), read_u32(delta->args + 4)) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        if (delta->op == DELTA_OP_INSERT)
+        {
+            delta->insert_left = read_u32(delta->args);
+        }
+        delta->op = 0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_delta_ota_finalize(esp_delta_ota_handle_t handle)
+{
+    delta_t *delta = handle;
+    return delta->op == 0 && delta->insert_left == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_delta_ota_deinit(esp_delta_ota_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+// zenoh-pico
+
+z_keyexpr_t z_keyexpr(const char *name)
+{
+    return (z_keyexpr_t){.suffix = name};
+}
+
+z_owned_publisher_t z_declare_publisher(z_session_t session, z_keyexpr_t keyexpr, const void *options)
+{
+    (void)session;
+    (void)options;
+    return (z_owned_publisher_t){.p = (void *)keyexpr.suffix};
+}
+
+int8_t z_undeclare_publisher(z_owned_publisher_t *publisher)
+{
+    publisher->p = NULL;
+    return 0;
+}
+
+z_owned_subscriber_t z_declare_subscriber(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_sample_t *callback,
+                                          const void *options)
+{
+    (void)session;
+    (void)options;
+    s_ota_handler = callback->call;
+    return (z_owned_subscriber_t){.p = (void *)keyexpr.suffix};
+}
+
+int8_t z_undeclare_subscriber(z_owned_subscriber_t *subscriber)
+{
+    s_ota_handler = NULL;
+    subscriber->p = NULL;
+    return 0;
+}
+
+int8_t z_publisher_put(z_publisher_t publisher, const uint8_t *payload, size_t len,
+                       const z_publisher_put_options_t *options)
+{
+    (void)publisher;
+    (void)options;
+    // The firmware updater stops at the first error, later ones are follow-ups.
+    if (strncmp(s_status, "error", 5) != 0)
+    {
+        snprintf(s_status, sizeof(s_status), "%.*s", (int)len, (const char *)payload);
+    }
+    return 0;
+}
+
+// Images and patches
+
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+} blob_t;
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng_next(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)s_rng;
+}
+
+static void blob_append(blob_t *blob, const void *data, size_t len)
+{
+    blob->data = realloc(blob->data, blob->len + len);
+    memcpy(blob->data + blob->len, data, len);
+    blob->len += len;
+}
+
+static void blob_append_u32(blob_t *blob, uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    blob_append(blob, bytes, sizeof(bytes));
+}
+
+static void image_seal(blob_t *image)
+{
+    image->data[0] = IMAGE_MAGIC;
+    image_digest(image->data, image->len - IMAGE_DIGEST_SIZE, image->data + image->len - IMAGE_DIGEST_SIZE);
+}
+
+static blob_t image_new(size_t len)
+{
+    blob_t image = {.data = malloc(len), .len = len};
+    for (size_t i = 0; i < len; i++)
+    {
+        image.data[i] = (uint8_t)rng_next();
+    }
+    image_seal(&image);
+    return image;
+}
+
+// The next version of 'base': 'changes' regions of 2 KB rewritten and 'grow' bytes appended.
+static blob_t image_next(const blob_t *base, int changes, size_t grow)
+{
+    blob_t image = {.data = malloc(base->len + grow), .len = base->len + grow};
+    memcpy(image.data, base->data, base->len - IMAGE_DIGEST_SIZE);
+    for (size_t i = base->len - IMAGE_DIGEST_SIZE; i < image.len; i++)
+    {
+        image.data[i] = (uint8_t)rng_next();
+    }
+    for (int c = 0; c < changes; c++)
+    {
+        size_t at = rng_next() % (base->len - 2048);
+        for (size_t i = 0; i < 2048; i++)
+        {
+            image.data[at + i] = (uint8_t)rng_next();
+        }
+    }
+    image_seal(&image);
+    return image;
+}
+
+// Diff of 'image' against 'base' in the stand-in format, with the esp_delta_ota header.
+static blob_t patch_new(const blob_t *base, const blob_t *image)
+{
+    blob_t patch = {0};
+    uint8_t header[PATCH_HEADER_SIZE] = {0};
+    uint32_t magic = PATCH_MAGIC;
+    memcpy(header, &magic, sizeof(magic));
+    image_digest(base->data, base->len, header + 4);
+    blob_append(&patch, header, sizeof(header));
+
+    for (size_t at = 0; at < image->len;)
+    {
+        size_t run = 0;
+        while (at + run < image->len && at + run + SECTOR_SIZE <= base->len &&
+               memcmp(image->data + at + run, base->data + at + run, SECTOR_SIZE) == 0)
+        {
+            run += SECTOR_SIZE;
+        }
+        if (run > 0)
+        {
+            uint8_t op = DELTA_OP_COPY;
+            blob_append(&patch, &op, 1);
+            blob_append_u32(&patch, (uint32_t)at);
+            blob_append_u32(&patch, (uint32_t)run);
+            at += run;
+            continue;
+        }
+        size_t len = image->len - at < SECTOR_SIZE ? image->len - at : SECTOR_SIZE;
+        uint8_t op = DELTA_OP_INSERT;
+        blob_append(&patch, &op, 1);
+        blob_append_u32(&patch, (uint32_t)len);
+        blob_append(&patch, image->data + at, len);
+        at += len;
+    }
+    return patch;
+}
+
+// Installs 'image' into the factory partition, as flashing over serial does.
+static void install_factory(const blob_t *image)
+{
+    const esp_partition_t *factory = &s_partitions[PART_FACTORY];
+    memcpy(s_flash + factory->address, image->data, image->len);
+    s_image_len[PART_FACTORY] = (uint32_t)image->len;
+}
+
+// Streaming
+
+typedef struct
+{
+    uint32_t fragments;
+    uint32_t transferred;
+} transfer_t;
+
+static void send_fragment(transfer_t *transfer, uint8_t kind, uint32_t value, const uint8_t *data, size_t len)
+{
+    uint8_t fragment[OTA_FRAGMENT_HEADER_SIZE + Z_FRAG_MAX_SIZE] = {kind, 0, 0, 0, (uint8_t)value,
+                                                                     (uint8_t)(value >> 8), (uint8_t)(value >> 16),
+                                                                     (uint8_t)(value >> 24)};
+    memcpy(fragment + OTA_FRAGMENT_HEADER_SIZE, data, len);
+    z_sample_t sample = {.payload = {.len = OTA_FRAGMENT_HEADER_SIZE + len, .start = fragment}};
+    transfer->fragments++;
+    transfer->transferred += sample.payload.len;
+    s_ota_handler(&sample, NULL);
+}
+
+// Sends 'payload' like the firmware updater does, optionally dropping one data fragment.
+// Returns true if the provider restarted into the new image.
+static bool send_update(const blob_t *payload, bool full_image, size_t fragment_size, int drop, transfer_t *transfer)
+{
+    memset(transfer, 0, sizeof(*transfer));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_status[0] = '\0';
+    if (setjmp(s_restart) != 0)
+    {
+        s_running = s_boot;
+        return true;
+    }
+    send_fragment(transfer, full_image ? OTA_FRAGMENT_BEGIN_IMAGE : OTA_FRAGMENT_BEGIN, (uint32_t)payload->len, NULL, 0);
+    int index = 0;
+    for (size_t offset = 0; offset < payload->len; offset += fragment_size, index++)
+    {
+        size_t len = payload->len - offset < fragment_size ? payload->len - offset : fragment_size;
+        if (index != drop)
+        {
+            send_fragment(transfer, OTA_FRAGMENT_DATA, (uint32_t)offset, payload->data + offset, len);
+        }
+    }
+    send_fragment(transfer, OTA_FRAGMENT_END, (uint32_t)payload->len, NULL, 0);
+    return false;
+}
+
+static int s_failures;
+
+// Runs one update and checks its outcome: either the provider restarts into 'image'
+// from the slot next to the one it ran from, or it rejects the update with 'error'
+// and keeps booting the running image. Partitions other than the target never change.
+static void scenario(const char *name, const blob_t *payload, bool full_image, const blob_t *image, size_t fragment_size,
+                     int drop, const char *error)
+{
+    int running = s_running;
+    int target = running == PART_OTA_0 ? PART_OTA_1 : PART_OTA_0;
+    uint64_t untouched[PART_COUNT];
+    for (int i = 0; i < PART_COUNT; i++)
+    {
+        untouched[i] = digest_region(s_partitions[i].address, s_partitions[i].size);
+    }
+
+    transfer_t transfer;
+    bool restarted = send_update(payload, full_image, fragment_size, drop, &transfer);
+
+    bool ok;
+    if (error == NULL)
+    {
+        ok = restarted && s_running == target && s_image_len[target] == image->len &&
+             memcmp(s_flash + s_partitions[target].address, image->data, image->len) == 0;
+    }
+    else
+    {
+        ok = !restarted && s_running == running && s_boot == running && strstr(s_status, error) != NULL;
+    }
+    for (int i = 0; i < PART_COUNT; i++)
+    {
+        if (i != target && i != PART_OTADATA &&
+            digest_region(s_partitions[i].address, s_partitions[i].size) != untouched[i])
+        {
+            printf("FAIL: %s changed partition '%s'\n", name, s_partitions[i].label);
+            ok = false;
+        }
+    }
+    if (!ok)
+    {
+        printf("FAIL: %s, last status '%s'\n", name, s_status);
+        s_failures++;
+    }
+    printf("%-32s %-7s %-7s %9u %9u %8u %8u %9u  %s\n", name, s_partitions[running].label,
+           s_partitions[target].label, (unsigned)transfer.transferred, (unsigned)transfer.fragments,
+           (unsigned)s_stats.sectors_erased, (unsigned)s_stats.bytes_written, (unsigned)s_stats.base_read,
+           ok ? (error == NULL ? "ok, restarted" : "ok, rejected") : "FAIL");
+}
+
+int main(int argc, char **argv)
+{
+    size_t fragment_size = argc > 1 ? (size_t)atoi(argv[1]) : DEFAULT_FRAGMENT_SIZE;
+    if (fragment_size == 0 || fragment_size + OTA_FRAGMENT_HEADER_SIZE > Z_FRAG_MAX_SIZE)
+    {
+        printf("The fragment size must be between 1 and %d bytes.\n", Z_FRAG_MAX_SIZE - OTA_FRAGMENT_HEADER_SIZE);
+        return 2;
+    }
+
+    memset(s_flash, 0xff, sizeof(s_flash));
+    if (ota_declare((z_session_t){0}) != 0 || s_ota_handler == NULL)
+    {
+        printf("FAIL: ota_declare\n");
+        return 1;
+    }
+
+    blob_t v1 = image_new(900 * 1024);
+    blob_t v2 = image_next(&v1, 4, 8 * 1024);
+    blob_t v3 = image_next(&v2, 12, 0);
+    blob_t v4 = image_next(&v3, 2, 0);
+    blob_t oversized = image_new(s_partitions[PART_OTA_0].size + SECTOR_SIZE);
+    blob_t corrupted = image_next(&v3, 1, 0);
+    corrupted.data[corrupted.len / 2] ^= 0x01;
+    install_factory(&v1);
+
+    blob_t patch_v2 = patch_new(&v1, &v2);
+    blob_t patch_v4 = patch_new(&v3, &v4);
+
+    printf("Partition table: factory, ota_0 and ota_1 of 1 MB each; %zu byte fragments\n\n", fragment_size);
+    printf("%-32s %-7s %-7s %9s %9s %8s %8s %9s  %s\n", "update", "running", "target", "sent", "fragments",
+           "erased", "written", "base read", "result");
+    scenario("delta v1 -> v2", &patch_v2, false, &v2, fragment_size, -1, NULL);
+    scenario("full image v3", &v3, true, &v3, fragment_size, -1, NULL);
+    scenario("delta for another base", &patch_v2, false, NULL, fragment_size, -1, "not created for the running image");
+    scenario("delta v3 -> v4, fragment lost", &patch_v4, false, NULL, fragment_size, 7, "out of sequence");
+    scenario("delta v3 -> v4", &patch_v4, false, &v4, fragment_size, -1, NULL);
+    scenario("full image larger than the slot", &oversized, true, NULL, fragment_size, -1, "writing the image failed");
+    scenario("full image, corrupted", &corrupted, true, NULL, fragment_size, -1, "verification failed");
+
+    ota_undeclare();
+    printf("\nDelta v1 -> v2: %zu of %zu image bytes sent (%.1f%%)\n", patch_v2.len, v2.len,
+           100.0 * (double)patch_v2.len / (double)v2.len);
+    printf("%s\n", s_failures == 0 ? "All scenarios passed." : "Some scenarios FAILED.");
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1094 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+/*
+ * Host runtime of the provider, see provider_host.h. Tasks are ucontext
+ * coroutines with stacks of their own; the scheduler runs in the context of
+ * host_run_until() and so do esp_timer callbacks and WiFi events, as the
+ * esp_timer and event loop tasks would run them.
+ */
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <ucontext.h>
+#include "driver/gpio.h"
+#include "esp_event.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "provider_host.h"
+
+#define HOST_TASKS_MAX                      16
+#define HOST_STACK_SIZE                     (256 * 1024)
+#define HOST_TIMERS_MAX                     16
+#define HOST_HANDLERS_MAX                   8
+#define HOST_SUBSCRIBERS_MAX                16
+#define HOST_ADDRESSES_MAX                  8
+#define HOST_BLOCKED                        INT64_MAX
+#define HOST_TICK_US                        (1000000 / configTICK_RATE_HZ)
+
+void app_main(void);
+
+int64_t host_nvs_init_us = 20000;
+int64_t host_wifi_connect_us = 2500000;
+size_t host_heap_size = 300 * 1024;
+
+typedef struct
+{
+    ucontext_t context;
+    TaskFunction_t function;
+    void *arg;
+    int64_t wake_us;       // time the task runs again, HOST_BLOCKED while it waits without timeout
+    uint32_t notifications;
+    bool notify_waiting;
+    const void *waiting_on; // mutex or event group the task waits for
+    bool done;
+} host_task_t;
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    bool active;
+    int64_t due_us;
+};
+
+struct host_semaphore
+{
+    host_task_t *owner;
+};
+
+struct host_event_group
+{
+    EventBits_t bits;
+};
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} host_handler_t;
+
+typedef struct
+{
+    void *transport;
+    bool reading;
+} host_session_t;
+
+typedef struct
+{
+    host_session_t *session;
+    char *keyexpr;
+} host_publisher_t;
+
+typedef struct
+{
+    host_session_t *session;
+    char *keyexpr;
+    z_sample_handler_t call;
+} host_subscriber_t;
+
+typedef struct
+{
+    char *connect;
+} host_config_t;
+
+typedef struct
+{
+    size_t count;
+    z_bytes_t (*entries)[2];
+} host_bytes_map_t;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+static host_task_t s_tasks[HOST_TASKS_MAX];
+static int s_task_count;
+static host_task_t *s_current;
+static ucontext_t s_scheduler;
+
+static int64_t s_now_us; // virtual time at s_slice_ns
+static double s_slice_ns; // host time the running task was resumed at
+static double s_cpu_scale;
+
+static struct esp_timer s_timers[HOST_TIMERS_MAX];
+static int s_timer_count;
+static esp_timer_handle_t s_wifi_started;
+static esp_timer_handle_t s_wifi_connected;
+
+static host_handler_t s_handlers[HOST_HANDLERS_MAX];
+static host_subscriber_t *s_subscribers[HOST_SUBSCRIBERS_MAX];
+static uint32_t s_gpio_levels[GPIO_NUM_MAX];
+static host_gpio_edge_t s_gpio_edges[HOST_GPIO_EDGES_MAX];
+static size_t s_gpio_edge_count;
+
+static struct
+{
+    struct in_addr address;
+    int64_t rtt_us;
+} s_rtts[HOST_ADDRESSES_MAX];
+static int s_rtt_count;
+static int64_t s_socket_ready_us[FD_SETSIZE]; // Time a connecting socket may report its outcome
+static uint64_t s_rng = 1;
+static size_t s_heap_base;
+static size_t s_heap_min_free = SIZE_MAX;
+
+// Scheduler
+
+static double host_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    if (s_current == NULL || s_cpu_scale == 0)
+    {
+        return s_now_us;
+    }
+    return s_now_us + (int64_t)((host_ns() - s_slice_ns) * s_cpu_scale / 1000);
+}
+
+// Blocks the running task until 'wake_us' or until a notification, mutex or event group wakes it.
+static void host_block(int64_t wake_us, const void *waiting_on)
+{
+    if (s_current == NULL)
+    {
+        fprintf(stderr, "host: blocking outside of a task\n");
+        abort();
+    }
+    s_now_us = esp_timer_get_time();
+    s_current->wake_us = wake_us;
+    s_current->waiting_on = waiting_on;
+    swapcontext(&s_current->context, &s_scheduler);
+}
+
+static int64_t host_wake_after(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? HOST_BLOCKED : esp_timer_get_time() + (int64_t)ticks * HOST_TICK_US;
+}
+
+// Wakes the tasks waiting for a mutex or event group, they check again.
+static void host_wake_waiting(const void *waiting_on)
+{
+    for (int i = 0; i < s_task_count; i++)
+    {
+        if (s_tasks[i].waiting_on == waiting_on)
+        {
+            s_tasks[i].waiting_on = NULL;
+            s_tasks[i].wake_us = esp_timer_get_time();
+        }
+    }
+}
+
+static void host_task_entry(void)
+{
+    s_current->function(s_current->arg);
+    s_current->done = true;
+}
+
+static void host_main_task(void *arg)
+{
+    (void)arg;
+    app_main();
+}
+
+void host_start(uint64_t seed)
+{
+    s_rng = seed != 0 ? seed : 1;
+    s_heap_base = mallinfo2().uordblks;
+    xTaskCreate(host_main_task, "main", 3584, NULL, 1, NULL);
+}
+
+void host_run_until(int64_t until_us)
+{
+    while (1)
+    {
+        host_task_t *task = NULL;
+        int64_t next_us = HOST_BLOCKED;
+        for (int i = 0; i < s_task_count; i++)
+        {
+            if (!s_tasks[i].done && s_tasks[i].wake_us < next_us)
+            {
+                task = &s_tasks[i];
+                next_us = task->wake_us;
+            }
+        }
+        // Timers due at the same time run first, the esp_timer task has the highest priority.
+        struct esp_timer *timer = NULL;
+        for (int i = 0; i < s_timer_count; i++)
+        {
+            if (s_timers[i].active && s_timers[i].due_us <= next_us)
+            {
+                timer = &s_timers[i];
+                next_us = timer->due_us;
+            }
+        }
+
+        if (next_us > until_us)
+        {
+            s_now_us = s_now_us > until_us ? s_now_us : until_us;
+            return;
+        }
+        s_now_us = next_us > s_now_us ? next_us : s_now_us;
+
+        if (timer != NULL)
+        {
+            timer->active = false;
+            timer->callback(timer->arg);
+            continue;
+        }
+        s_current = task;
+        s_slice_ns = host_ns();
+        swapcontext(&s_scheduler, &task->context);
+        s_current = NULL;
+    }
+}
+
+void host_set_cpu_scale(double scale)
+{
+    s_cpu_scale = scale;
+}
+
+void host_block_us(int64_t delay_us)
+{
+    host_block(esp_timer_get_time() + delay_us, NULL);
+}
+
+// FreeRTOS
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    if (s_task_count == HOST_TASKS_MAX)
+    {
+        return pdFALSE;
+    }
+    host_task_t *task = &s_tasks[s_task_count++];
+    void *stack = mmap(NULL, HOST_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED)
+    {
+        abort();
+    }
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = stack;
+    task->context.uc_stack.ss_size = HOST_STACK_SIZE;
+    task->context.uc_link = &s_scheduler;
+    makecontext(&task->context, host_task_entry, 0);
+    task->function = function;
+    task->arg = arg;
+    task->wake_us = esp_timer_get_time();
+    if (handle != NULL)
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_block(host_wake_after(ticks), NULL);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    host_task_t *task = s_current;
+    if (task->notifications == 0 && ticks_to_wait != 0)
+    {
+        task->notify_waiting = true;
+        host_block(host_wake_after(ticks_to_wait), NULL);
+        task->notify_waiting = false;
+    }
+    uint32_t notifications = task->notifications;
+    task->notifications = clear_on_exit ? 0 : (notifications > 0 ? notifications - 1 : 0);
+    return notifications;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    host_task_t *task = handle;
+    task->notifications++;
+    if (task->notify_waiting)
+    {
+        task->wake_us = esp_timer_get_time();
+    }
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(struct host_semaphore));
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    int64_t timeout_us = host_wake_after(ticks_to_wait);
+    while (semaphore->owner != NULL)
+    {
+        if (esp_timer_get_time() >= timeout_us)
+        {
+            return pdFALSE;
+        }
+        host_block(timeout_us, semaphore);
+    }
+    semaphore->owner = s_current;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->owner = NULL;
+    host_wake_waiting(semaphore);
+    return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct host_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    host_wake_waiting(group);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    int64_t timeout_us = host_wake_after(ticks_to_wait);
+    while (wait_for_all ? (group->bits & bits) != bits : (group->bits & bits) == 0)
+    {
+        if (esp_timer_get_time() >= timeout_us)
+        {
+            break;
+        }
+        host_block(timeout_us, group);
+    }
+    EventBits_t set = group->bits;
+    if (clear_on_exit)
+    {
+        group->bits &= ~bits;
+    }
+    return set;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    free(group);
+}
+
+// Overrides the C library's sleep(), the supervision loop sleeps on the virtual clock.
+unsigned int sleep(unsigned int seconds)
+{
+    host_block(esp_timer_get_time() + (int64_t)seconds * 1000000, NULL);
+    return 0;
+}
+
+// ESP-IDF
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    if (s_timer_count == HOST_TIMERS_MAX)
+    {
+        return ESP_FAIL;
+    }
+    struct esp_timer *timer = &s_timers[s_timer_count++];
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->active)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    bool active = timer->active;
+    timer->active = false;
+    return active ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+uint32_t esp_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng >> 32);
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    host_block_us(host_nvs_init_us);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_OK;
+}
+
+static void host_post_event(esp_event_base_t base, int32_t id)
+{
+    for (int i = 0; i < HOST_HANDLERS_MAX; i++)
+    {
+        if (s_handlers[i].handler != NULL && s_handlers[i].base == base &&
+            (s_handlers[i].id == ESP_EVENT_ANY_ID || s_handlers[i].id == id))
+        {
+            s_handlers[i].handler(s_handlers[i].arg, base, id, NULL);
+        }
+    }
+}
+
+static void host_wifi_started(void *arg)
+{
+    (void)arg;
+    host_post_event(WIFI_EVENT, WIFI_EVENT_STA_START);
+}
+
+static void host_wifi_connected(void *arg)
+{
+    (void)arg;
+    host_post_event(IP_EVENT, IP_EVENT_STA_GOT_IP);
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    for (int i = 0; i < HOST_HANDLERS_MAX; i++)
+    {
+        if (s_handlers[i].handler == NULL)
+        {
+            s_handlers[i] = (host_handler_t){event_base, event_id, event_handler, event_handler_arg};
+            *instance = &s_handlers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base, int32_t event_id,
+                                                esp_event_handler_instance_t instance)
+{
+    (void)event_base;
+    (void)event_id;
+    ((host_handler_t *)instance)->handler = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+void *esp_netif_create_default_wifi_sta(void)
+{
+    return &s_wifi_started;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    (void)config;
+    esp_timer_create(&(esp_timer_create_args_t){.callback = host_wifi_started}, &s_wifi_started);
+    esp_timer_create(&(esp_timer_create_args_t){.callback = host_wifi_connected}, &s_wifi_connected);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *config)
+{
+    (void)interface;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    return esp_timer_start_once(s_wifi_started, 0);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    return esp_timer_start_once(s_wifi_connected, (uint64_t)host_wifi_connect_us);
+}
+
+/*
+ * The heap in use is what glibc's allocator holds for the host program, since
+ * host_start(). Free memory below the top of its arena counts as fragmented,
+ * the largest free block is what lies above.
+ */
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    (void)caps;
+    return host_heap_size;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    size_t used = mallinfo2().uordblks - s_heap_base;
+    size_t free_size = used < host_heap_size ? host_heap_size - used : 0;
+    s_heap_min_free = free_size < s_heap_min_free ? free_size : s_heap_min_free;
+    return free_size;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    size_t free_size = heap_caps_get_free_size(caps);
+    return free_size < s_heap_min_free ? free_size : s_heap_min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    struct mallinfo2 info = mallinfo2();
+    size_t holes = info.fordblks - info.keepcost;
+    size_t free_size = heap_caps_get_free_size(caps);
+    return free_size > holes ? free_size - holes : 0;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    s_gpio_levels[gpio_num] = 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    (void)gpio_num;
+    (void)mode;
+    return ESP_OK;
+}
+
+// Records the virtual time of every level change, edges beyond HOST_GPIO_EDGES_MAX are counted only.
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    level = level != 0;
+    if (s_gpio_levels[gpio_num] != level)
+    {
+        if (s_gpio_edge_count < HOST_GPIO_EDGES_MAX)
+        {
+            s_gpio_edges[s_gpio_edge_count] = (host_gpio_edge_t){esp_timer_get_time(), gpio_num, level};
+        }
+        s_gpio_edge_count++;
+    }
+    s_gpio_levels[gpio_num] = level;
+    return ESP_OK;
+}
+
+uint32_t host_gpio_level(int gpio_num)
+{
+    return s_gpio_levels[gpio_num];
+}
+
+size_t host_gpio_edges(const host_gpio_edge_t **edges)
+{
+    *edges = s_gpio_edges;
+    return s_gpio_edge_count;
+}
+
+void host_gpio_edges_clear(void)
+{
+    s_gpio_edge_count = 0;
+}
+
+// Network
+
+void host_set_rtt(const char *address, int64_t rtt_us)
+{
+    struct in_addr in;
+    if (inet_pton(AF_INET, address, &in) != 1)
+    {
+        abort();
+    }
+    for (int i = 0; i < s_rtt_count; i++)
+    {
+        if (s_rtts[i].address.s_addr == in.s_addr)
+        {
+            s_rtts[i].rtt_us = rtt_us;
+            return;
+        }
+    }
+    if (s_rtt_count == HOST_ADDRESSES_MAX)
+    {
+        abort();
+    }
+    s_rtts[s_rtt_count].address = in;
+    s_rtts[s_rtt_count++].rtt_us = rtt_us;
+}
+
+static int64_t host_rtt_of(struct in_addr address)
+{
+    for (int i = 0; i < s_rtt_count; i++)
+    {
+        if (s_rtts[i].address.s_addr == address.s_addr)
+        {
+            return s_rtts[i].rtt_us;
+        }
+    }
+    return 0;
+}
+
+int64_t host_rtt_us(const char *address)
+{
+    struct in_addr in;
+    return inet_pton(AF_INET, address, &in) == 1 ? host_rtt_of(in) : 0;
+}
+
+int host_connect(int fd, const struct sockaddr *address, socklen_t address_len)
+{
+    if (fd >= 0 && fd < FD_SETSIZE)
+    {
+        int64_t rtt_us = address->sa_family == AF_INET ? host_rtt_of(((const struct sockaddr_in *)address)->sin_addr) : 0;
+        s_socket_ready_us[fd] = esp_timer_get_time() + rtt_us;
+    }
+    return connect(fd, address, address_len);
+}
+
+// Keeps the sockets of 'set' that the system reported and that are due by 'now_us'.
+// Returns their number and lowers 'next_us' to the time the next one is due.
+static int host_select_due(int nfds, fd_set *set, const fd_set *ready, int64_t now_us, int64_t *next_us)
+{
+    int count = 0;
+    for (int fd = 0; set != NULL && fd < nfds; fd++)
+    {
+        if (!FD_ISSET(fd, set))
+        {
+            continue;
+        }
+        if (s_socket_ready_us[fd] > now_us)
+        {
+            *next_us = s_socket_ready_us[fd] < *next_us ? s_socket_ready_us[fd] : *next_us;
+            FD_CLR(fd, set);
+        }
+        else if (FD_ISSET(fd, ready))
+        {
+            count++;
+        }
+        else
+        {
+            FD_CLR(fd, set);
+        }
+    }
+    return count;
+}
+
+int host_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+{
+    int64_t deadline_us =
+        timeout != NULL ? esp_timer_get_time() + (int64_t)timeout->tv_sec * 1000000 + timeout->tv_usec : HOST_BLOCKED;
+    fd_set *sets[] = {readfds, writefds, exceptfds};
+    fd_set wanted[3];
+    for (int i = 0; i < 3; i++)
+    {
+        if (sets[i] != NULL)
+        {
+            wanted[i] = *sets[i];
+        }
+    }
+
+    while (1)
+    {
+        // The system answers within microseconds for local peers, the virtual clock says when it may.
+        // Waiting for the system is not computing, so it does not advance the clock.
+        fd_set ready[3];
+        for (int i = 0; i < 3; i++)
+        {
+            if (sets[i] != NULL)
+            {
+                ready[i] = wanted[i];
+            }
+        }
+        int64_t now_us = esp_timer_get_time();
+        struct timeval poll = {.tv_sec = 0, .tv_usec = 1000};
+        int result = select(nfds, sets[0] != NULL ? &ready[0] : NULL, sets[1] != NULL ? &ready[1] : NULL,
+                            sets[2] != NULL ? &ready[2] : NULL, &poll);
+        s_now_us = now_us;
+        s_slice_ns = host_ns();
+        if (result < 0)
+        {
+            return -1;
+        }
+
+        int64_t next_us = deadline_us;
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            if (sets[i] != NULL)
+            {
+                *sets[i] = wanted[i];
+                count += host_select_due(nfds, sets[i], &ready[i], now_us, &next_us);
+            }
+        }
+        if (count > 0 || now_us >= deadline_us)
+        {
+            return count;
+        }
+        if (next_us > now_us)
+        {
+            host_block(next_us, NULL);
+        }
+    }
+}
+
+// zenoh-pico, allocating where zenoh-pico does so leaks show up in the heap
+
+z_owned_config_t z_config_default(void)
+{
+    return (z_owned_config_t){.p = calloc(1, sizeof(host_config_t))};
+}
+
+z_string_t z_string_make(const char *value)
+{
+    return (z_string_t){.val = strdup(value)};
+}
+
+int8_t zp_config_insert(z_config_t config, uint8_t key, z_string_t value)
+{
+    host_config_t *host_config = config.p;
+    if (key == Z_CONFIG_CONNECT_KEY)
+    {
+        free(host_config->connect);
+        host_config->connect = value.val;
+    }
+    else
+    {
+        free(value.val);
+    }
+    return 0;
+}
+
+z_owned_session_t z_open(z_owned_config_t *config)
+{
+    host_config_t *host_config = config->p;
+    void *transport = host_transport_open(host_config->connect != NULL ? host_config->connect : "");
+    free(host_config->connect);
+    free(host_config);
+    config->p = NULL;
+    if (transport == NULL)
+    {
+        return (z_owned_session_t){.p = NULL};
+    }
+    host_session_t *session = calloc(1, sizeof(host_session_t));
+    session->transport = transport;
+    return (z_owned_session_t){.p = session};
+}
+
+int8_t z_close(z_owned_session_t *session)
+{
+    host_session_t *host_session = session->p;
+    for (int i = 0; i < HOST_SUBSCRIBERS_MAX; i++)
+    {
+        if (s_subscribers[i] != NULL && s_subscribers[i]->session == host_session)
+        {
+            free(s_subscribers[i]->keyexpr);
+            free(s_subscribers[i]);
+            s_subscribers[i] = NULL;
+        }
+    }
+    host_transport_close(host_session->transport);
+    free(host_session);
+    session->p = NULL;
+    return 0;
+}
+
+int8_t zp_start_read_task(z_session_t session, const void *options)
+{
+    (void)options;
+    ((host_session_t *)session.p)->reading = true;
+    return 0;
+}
+
+int8_t zp_stop_read_task(z_session_t session)
+{
+    ((host_session_t *)session.p)->reading = false;
+    return 0;
+}
+
+int8_t zp_start_lease_task(z_session_t session, const void *options)
+{
+    (void)session;
+    (void)options;
+    return 0;
+}
+
+int8_t zp_stop_lease_task(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+int8_t zp_send_keep_alive(z_session_t session, const void *options)
+{
+    (void)options;
+    return host_transport_alive(((host_session_t *)session.p)->transport) ? 0 : -1;
+}
+
+z_keyexpr_t z_keyexpr(const char *name)
+{
+    return (z_keyexpr_t){.suffix = name};
+}
+
+z_owned_publisher_t z_declare_publisher(z_session_t session, z_keyexpr_t keyexpr, const void *options)
+{
+    (void)options;
+    host_publisher_t *publisher = malloc(sizeof(host_publisher_t));
+    publisher->session = session.p;
+    publisher->keyexpr = strdup(keyexpr.suffix);
+    return (z_owned_publisher_t){.p = publisher};
+}
+
+int8_t z_undeclare_publisher(z_owned_publisher_t *publisher)
+{
+    host_publisher_t *host_publisher = publisher->p;
+    free(host_publisher->keyexpr);
+    free(host_publisher);
+    publisher->p = NULL;
+    return 0;
+}
+
+z_publisher_put_options_t z_publisher_put_options_default(void)
+{
+    return (z_publisher_put_options_t){.attachment = {NULL, NULL}};
+}
+
+int8_t z_publisher_put(z_publisher_t publisher, const uint8_t *payload, size_t len,
+                       const z_publisher_put_options_t *options)
+{
+    host_publisher_t *host_publisher = publisher.p;
+    const z_attachment_t *attachment =
+        options != NULL && z_attachment_check(&options->attachment) ? &options->attachment : NULL;
+    return host_transport_put(host_publisher->session->transport, host_publisher->keyexpr, payload, len, attachment) == 0
+               ? 0
+               : -1;
+}
+
+z_owned_subscriber_t z_declare_subscriber(z_session_t session, z_keyexpr_t keyexpr, z_owned_closure_sample_t *callback,
+                                          const void *options)
+{
+    (void)options;
+    for (int i = 0; i < HOST_SUBSCRIBERS_MAX; i++)
+    {
+        if (s_subscribers[i] == NULL)
+        {
+            host_subscriber_t *subscriber = malloc(sizeof(host_subscriber_t));
+            subscriber->session = session.p;
+            subscriber->keyexpr = strdup(keyexpr.suffix);
+            subscriber->call = callback->call;
+            s_subscribers[i] = subscriber;
+            return (z_owned_subscriber_t){.p = subscriber};
+        }
+    }
+    return (z_owned_subscriber_t){.p = NULL};
+}
+
+int8_t z_undeclare_subscriber(z_owned_subscriber_t *subscriber)
+{
+    for (int i = 0; i < HOST_SUBSCRIBERS_MAX; i++)
+    {
+        if (s_subscribers[i] == subscriber->p)
+        {
+            free(s_subscribers[i]->keyexpr);
+            free(s_subscribers[i]);
+            s_subscribers[i] = NULL;
+        }
+    }
+    subscriber->p = NULL;
+    return 0;
+}
+
+// Key expressions match exactly or up to a trailing "*", the only wildcard the provider declares.
+static bool host_keyexpr_matches(const char *declared, const char *keyexpr)
+{
+    size_t len = strlen(declared);
+    if (len > 0 && declared[len - 1] == '*')
+    {
+        return strncmp(declared, keyexpr, len - 1) == 0 && strchr(keyexpr + len - 1, '/') == NULL;
+    }
+    return strcmp(declared, keyexpr) == 0;
+}
+
+int host_deliver(const char *keyexpr, const char *payload, const char *type, const char *deadline)
+{
+    z_bytes_t entries[2][2];
+    host_bytes_map_t map = {.count = 0, .entries = entries};
+    if (type != NULL)
+    {
+        entries[map.count][0] = _z_bytes_wrap((const uint8_t *)"type", strlen("type"));
+        entries[map.count++][1] = _z_bytes_wrap((const uint8_t *)type, strlen(type));
+    }
+    if (deadline != NULL)
+    {
+        entries[map.count][0] = _z_bytes_wrap((const uint8_t *)"deadline", strlen("deadline"));
+        entries[map.count++][1] = _z_bytes_wrap((const uint8_t *)deadline, strlen(deadline));
+    }
+    z_owned_bytes_map_t owned = {.p = &map};
+    z_sample_t sample = {
+        .keyexpr = z_keyexpr(keyexpr),
+        .payload = _z_bytes_wrap((const uint8_t *)payload, strlen(payload)),
+        .attachment = map.count > 0 ? z_bytes_map_as_attachment(&owned) : (z_attachment_t){NULL, NULL},
+    };
+
+    int reached = 0;
+    for (int i = 0; i < HOST_SUBSCRIBERS_MAX; i++)
+    {
+        host_subscriber_t *subscriber = s_subscribers[i];
+        if (subscriber != NULL && subscriber->session->reading &&
+            host_transport_alive(subscriber->session->transport) && host_keyexpr_matches(subscriber->keyexpr, keyexpr))
+        {
+            subscriber->call(&sample, NULL);
+            reached++;
+        }
+    }
+    return reached;
+}
+
+z_bytes_t _z_bytes_wrap(const uint8_t *start, size_t len)
+{
+    return (z_bytes_t){.len = len, .start = start};
+}
+
+z_owned_bytes_map_t z_bytes_map_new(void)
+{
+    return (z_owned_bytes_map_t){.p = calloc(1, sizeof(host_bytes_map_t))};
+}
+
+void z_bytes_map_insert_by_alias(const z_owned_bytes_map_t *map, z_bytes_t key, z_bytes_t value)
+{
+    host_bytes_map_t *host_map = map->p;
+    host_map->entries = realloc(host_map->entries, (host_map->count + 1) * sizeof(*host_map->entries));
+    host_map->entries[host_map->count][0] = key;
+    host_map->entries[host_map->count][1] = value;
+    host_map->count++;
+}
+
+static int8_t host_bytes_map_iterate(const void *data, z_attachment_iter_body_t body, void *ctx)
+{
+    const host_bytes_map_t *map = data;
+    for (size_t i = 0; i < map->count; i++)
+    {
+        int8_t result = body(map->entries[i][0], map->entries[i][1], ctx);
+        if (result != 0)
+        {
+            return result;
+        }
+    }
+    return 0;
+}
+
+z_attachment_t z_bytes_map_as_attachment(const z_owned_bytes_map_t *map)
+{
+    return (z_attachment_t){.data = map->p, .iteration_driver = host_bytes_map_iterate};
+}
+
+void z_bytes_map_drop(z_owned_bytes_map_t *map)
+{
+    host_bytes_map_t *host_map = map->p;
+    if (host_map != NULL)
+    {
+        free(host_map->entries);
+        free(host_map);
+        map->p = NULL;
+    }
+}
+
+bool z_attachment_check(const z_attachment_t *attachment)
+{
+    return attachment->iteration_driver != NULL;
+}
+
+int8_t z_attachment_iterate(z_attachment_t attachment, z_attachment_iter_body_t body, void *ctx)
+{
+    return attachment.iteration_driver(attachment.data, body, ctx);
+}
+
+typedef struct
+{
+    z_bytes_t key;
+    z_bytes_t value;
+} host_attachment_lookup_t;
+
+static int8_t host_attachment_find(z_bytes_t key, z_bytes_t value, void *ctx)
+{
+    host_attachment_lookup_t *lookup = ctx;
+    if (key.len == lookup->key.len && memcmp(key.start, lookup->key.start, key.len) == 0)
+    {
+        lookup->value = value;
+        return 1;
+    }
+    return 0;
+}
+
+z_bytes_t z_attachment_get(z_attachment_t attachment, z_bytes_t key)
+{
+    host_attachment_lookup_t lookup = {.key = key, .value = {.len = 0, .start = NULL}};
+    z_attachment_iterate(attachment, host_attachment_find, &lookup);
+    return lookup.value;
+}
+
+z_owned_str_t z_keyexpr_to_string(z_keyexpr_t keyexpr)
+{
+    return (z_owned_str_t){.p = strdup(keyexpr.suffix)};
+}
+
+const char *z_str_loan(const z_owned_str_t *str)
+{
+    return str->p;
+}
+
+void z_str_drop(z_owned_str_t *str)
+{
+    free(str->p);
+    str->p = NULL;
+}
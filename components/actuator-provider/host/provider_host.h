@@ -0,0 +1,93 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef PROVIDER_HOST_H
+#define PROVIDER_HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zenoh-pico.h>
+
+/*
+ * Host runtime of the provider, for host programs that build main.c.
+ *
+ * The FreeRTOS tasks of the firmware run cooperatively on a virtual clock: a
+ * task runs until it blocks in vTaskDelay(), sleep(), a notification, a mutex
+ * or an event group, and the clock then jumps to the next task or esp_timer
+ * that is due. Computing advances the clock by the host time it took times the
+ * CPU scale, which is 0 by default, so runs are deterministic. WiFi, NVS, the
+ * heap and the GPIOs are modelled; the zenoh-pico session runs over the
+ * transport the host program provides below.
+ */
+
+// Modelled durations of the boot path, in microseconds of virtual time
+extern int64_t host_nvs_init_us;
+extern int64_t host_wifi_connect_us; // association and DHCP
+
+// Size of the modelled heap, heap_caps reports it minus what the host program allocated since host_start()
+extern size_t host_heap_size;
+
+// Creates the task running app_main(). The tasks run in host_run_until().
+void host_start(uint64_t seed);
+
+// Runs the tasks until the virtual clock reaches 'until_us'.
+void host_run_until(int64_t until_us);
+
+// Host time spent computing counts 'scale' times on the virtual clock.
+void host_set_cpu_scale(double scale);
+
+// Blocks the calling task for 'delay_us', without the tick granularity of vTaskDelay().
+void host_block_us(int64_t delay_us);
+
+// Delivers a sample to the subscribers of 'keyexpr' as the read task of an open
+// session would. 'type' and 'deadline' become attachment entries unless NULL.
+// Returns the number of subscribers the sample reached.
+int host_deliver(const char *keyexpr, const char *payload, const char *type, const char *deadline);
+
+// Level last set on a GPIO
+uint32_t host_gpio_level(int gpio_num);
+
+#define HOST_GPIO_EDGES_MAX                 4096
+
+// A level change of a GPIO at a time of the virtual clock
+typedef struct
+{
+    int64_t time_us;
+    int gpio_num;
+    uint32_t level;
+} host_gpio_edge_t;
+
+// Edges recorded since host_start() or the last clear, in order. Returns their number,
+// of which the first HOST_GPIO_EDGES_MAX are stored.
+size_t host_gpio_edges(const host_gpio_edge_t **edges);
+void host_gpio_edges_clear(void);
+
+// Round-trip time to the IPv4 'address' on the virtual clock, 0 unless set.
+// Connections made through lwip/sockets.h complete or fail after it.
+void host_set_rtt(const char *address, int64_t rtt_us);
+int64_t host_rtt_us(const char *address);
+
+/*
+ * Transport to the routers, provided by the host program. open() returns a
+ * handle for a session with the router at 'locator', or NULL if it refused;
+ * it may block the calling task. put() returns 0 once the payload was sent.
+ */
+void *host_transport_open(const char *locator);
+void host_transport_close(void *transport);
+bool host_transport_alive(void *transport);
+int host_transport_put(void *transport, const char *keyexpr, const uint8_t *payload, size_t len,
+                       const z_attachment_t *attachment);
+
+#endif
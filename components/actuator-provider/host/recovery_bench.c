@@ -0,0 +1,303 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host benchmark of in-place session recovery against recovery by a reboot.
+ *
+ * Builds main.c unchanged on the host runtime (provider_host.c) with CONNECT
+ * naming one router, a local TCP listener whose connections the host socket
+ * layer completes after RTT_MS. The session takes OPEN_ROUND_TRIPS round trips
+ * to open. The bench drops the session DROPS times by closing the router's
+ * side of the connection while the router stays up, as a router restart or a
+ * reset connection would, at varying points of the session check interval.
+ *
+ * It times on the virtual clock, up to the first publication on the new
+ * session:
+ *
+ * - the in-place recovery after each drop: detection by the supervision loop,
+ *   the probe, opening the session and declaring everything again,
+ * - the boot path of the same build: NVS, WiFi association and DHCP
+ *   (host_nvs_init_us, host_wifi_connect_us), the provider's initialization,
+ *   the probe and the session. Recovering by a reboot costs the detection,
+ *   this and the bootloader, which is not modelled.
+ *
+ * It fails unless every drop is recovered and the slowest in-place recovery
+ * is faster than the detection plus the boot path. Host CPU time counts
+ * CPU_SCALE times on the virtual clock, as in soak_sim.c.
+ *
+ * Usage: recovery_bench [drops] [seed]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "provider_host.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+
+#define ROUTER_ADDRESS                      "127.0.0.21"
+#define ROUTER_PORT                         7447
+#define RTT_MS                              20
+#define OPEN_ROUND_TRIPS                    3 // TCP handshake, zenoh InitSyn/InitAck and OpenSyn/OpenAck
+#define DROP_SPACING_S                      10 // Between two drops, plus a random part of a check interval
+#define DROPS_MAX                           64
+#define ACCEPTED_MAX                        16
+#define CPU_SCALE                           30.0
+
+int host_log_level = 1;
+
+typedef struct
+{
+    int fd;
+    bool published;
+} bench_transport_t;
+
+static int s_listener = -1;
+static int s_accepted[ACCEPTED_MAX];
+static int s_accepted_count;
+static uint64_t s_rng;
+
+static int64_t s_first_published_us; // First publication after boot
+static int64_t s_dropped_us[DROPS_MAX];
+static int64_t s_recovered_us[DROPS_MAX]; // First publication after the drop
+static int s_drops;
+static int s_drop_count;
+
+static uint32_t random_below(uint32_t bound)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)((s_rng >> 32) % bound);
+}
+
+// Router
+
+static struct sockaddr_in router_address(void)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(ROUTER_PORT)};
+    inet_pton(AF_INET, ROUTER_ADDRESS, &address.sin_addr);
+    return address;
+}
+
+static void router_start(void)
+{
+    struct sockaddr_in address = router_address();
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0)
+    {
+        fprintf(stderr, "Unable to listen on %s:%d: %s\n", ROUTER_ADDRESS, ROUTER_PORT, strerror(errno));
+        exit(2);
+    }
+    s_listener = fd;
+}
+
+// Closes the router's side of all connections, the listener stays up.
+static void router_drop_connections(void)
+{
+    for (int i = 0; i < s_accepted_count; i++)
+    {
+        close(s_accepted[i]);
+    }
+    s_accepted_count = 0;
+}
+
+// Accepts new connections and closes the ones the provider closed, e.g. probes.
+static void router_serve(void)
+{
+    for (int i = 0; i < s_accepted_count;)
+    {
+        char byte;
+        if (recv(s_accepted[i], &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+        {
+            close(s_accepted[i]);
+            s_accepted[i] = s_accepted[--s_accepted_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    int fd;
+    while (s_accepted_count < ACCEPTED_MAX && (fd = accept(s_listener, NULL, NULL)) >= 0)
+    {
+        s_accepted[s_accepted_count++] = fd;
+    }
+}
+
+// Transport to the router
+
+void *host_transport_open(const char *locator)
+{
+    (void)locator;
+    struct sockaddr_in sockaddr = router_address();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) != 0)
+    {
+        close(fd);
+        host_block_us(host_rtt_us(ROUTER_ADDRESS));
+        return NULL;
+    }
+    host_block_us(OPEN_ROUND_TRIPS * host_rtt_us(ROUTER_ADDRESS));
+
+    bench_transport_t *transport = malloc(sizeof(bench_transport_t));
+    *transport = (bench_transport_t){fd, false};
+    return transport;
+}
+
+void host_transport_close(void *transport)
+{
+    close(((bench_transport_t *)transport)->fd);
+    free(transport);
+}
+
+bool host_transport_alive(void *transport)
+{
+    char byte;
+    ssize_t received = recv(((bench_transport_t *)transport)->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return received > 0 || (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int host_transport_put(void *transport, const char *keyexpr, const uint8_t *payload, size_t len,
+                       const z_attachment_t *attachment)
+{
+    (void)keyexpr;
+    (void)payload;
+    (void)len;
+    (void)attachment;
+    bench_transport_t *t = transport;
+    if (!host_transport_alive(t))
+    {
+        return -1;
+    }
+    if (!t->published)
+    {
+        t->published = true;
+        int64_t now_us = esp_timer_get_time();
+        if (s_first_published_us == 0)
+        {
+            s_first_published_us = now_us;
+        }
+        else if (s_drop_count > 0 && s_recovered_us[s_drop_count - 1] == 0)
+        {
+            s_recovered_us[s_drop_count - 1] = now_us;
+        }
+    }
+    return 0;
+}
+
+// Bench
+
+static void bench_task(void *arg)
+{
+    (void)arg;
+    int64_t next_drop_us = 0;
+    while (1)
+    {
+        int64_t now_us = esp_timer_get_time();
+        if (next_drop_us == 0 && s_first_published_us != 0)
+        {
+            next_drop_us = now_us + DROP_SPACING_S * S;
+        }
+        // The next drop waits for the recovery from the previous one.
+        bool recovered = s_drop_count == 0 || s_recovered_us[s_drop_count - 1] != 0;
+        if (next_drop_us != 0 && now_us >= next_drop_us && recovered && s_drop_count < s_drops)
+        {
+            router_drop_connections();
+            s_dropped_us[s_drop_count++] = now_us;
+            next_drop_us = now_us + DROP_SPACING_S * S + random_below(SESSION_CHECK_INTERVAL_S * 1000) * MS;
+        }
+        router_serve();
+        host_block_us(MS);
+    }
+}
+
+static double ms(int64_t us)
+{
+    return (double)us / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    s_drops = argc > 1 ? atoi(argv[1]) : 20;
+    s_drops = s_drops < 1 ? 1 : s_drops > DROPS_MAX ? DROPS_MAX : s_drops;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    s_rng = seed != 0 ? seed : 1;
+
+    host_set_rtt(ROUTER_ADDRESS, RTT_MS * MS);
+    router_start();
+    host_set_cpu_scale(CPU_SCALE);
+    host_start(seed);
+    xTaskCreate(bench_task, "bench", 4096, NULL, 1, NULL);
+    host_run_until(host_wifi_connect_us + (int64_t)(s_drops + 2) * (DROP_SPACING_S + SESSION_CHECK_INTERVAL_S) * S);
+
+    printf("router %s (%d ms), sessions take %d round trips, %d drops\n", ROUTER_ADDRESS, RTT_MS, OPEN_ROUND_TRIPS,
+           s_drops);
+    if (s_first_published_us == 0)
+    {
+        printf("boot: the session was not established\n");
+        return 1;
+    }
+
+    bool failed = s_drop_count < s_drops;
+    int64_t total_us = 0;
+    int64_t min_us = INT64_MAX;
+    int64_t max_us = 0;
+    for (int i = 0; i < s_drop_count; i++)
+    {
+        if (s_recovered_us[i] == 0)
+        {
+            failed = true;
+            continue;
+        }
+        int64_t recovery_us = s_recovered_us[i] - s_dropped_us[i];
+        total_us += recovery_us;
+        min_us = recovery_us < min_us ? recovery_us : min_us;
+        max_us = recovery_us > max_us ? recovery_us : max_us;
+    }
+    if (failed)
+    {
+        printf("in place: %d of %d drops were not recovered\n", s_drops - s_drop_count, s_drops);
+        return 1;
+    }
+
+    // A reboot restarts once the loss is detected, which takes as long as for an in-place recovery.
+    int64_t detection_us = SESSION_CHECK_INTERVAL_S * S / 2;
+    int64_t mean_us = total_us / s_drop_count;
+    printf("in place: recovery %7.1f ms mean, %7.1f ms min, %7.1f ms max\n", ms(mean_us), ms(min_us), ms(max_us));
+    printf("reboot:   boot to session %7.1f ms (NVS %.1f ms, WiFi %.1f ms), %7.1f ms with the mean detection, "
+           "plus the bootloader\n",
+           ms(s_first_published_us), ms(host_nvs_init_us), ms(host_wifi_connect_us),
+           ms(detection_us + s_first_published_us));
+    printf("ratio:    a reboot takes %.1f times as long as recovering in place\n",
+           (double)(detection_us + s_first_published_us) / (double)mean_us);
+
+    failed = max_us >= detection_us + s_first_published_us;
+    close(s_listener);
+    router_drop_connections();
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
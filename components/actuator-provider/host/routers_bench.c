@@ -0,0 +1,396 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host benchmark of router selection, failover and failback.
+ *
+ * Builds main.c and routers.c unchanged on the host runtime (provider_host.c)
+ * with CONNECT listing three routers on local addresses, in order of
+ * decreasing round-trip time. Each router is a TCP listener of its own;
+ * routers.c probes them with real connections, which the host socket layer
+ * completes after the round-trip time injected for the address, and the
+ * Zenoh session is a TCP connection to the listener that takes
+ * OPEN_ROUND_TRIPS round trips to open. Stopping a router closes its listener
+ * and its connections, so probes are refused and the session sees the
+ * connection close.
+ *
+ * The bench boots the provider, stops the fastest router STOP_S and a half
+ * seconds after the session was established, i.e. midway between two checks
+ * of the session, starts it again RESTART_S later, and times on
+ * the virtual clock:
+ *
+ * - the probe and the selection at startup, and the session opening,
+ * - the failover: detecting the lost session, probing and selecting, and
+ *   opening the session with the next router up to its first publication,
+ * - the failback: waiting for the periodic re-probe, opening the session with
+ *   the fastest router while the current one serves, and the time the
+ *   declarations were away between closing the old session and the first
+ *   publication on the new one.
+ *
+ * It fails unless the provider selects the fastest router, fails over to the
+ * next fastest and fails back make-before-break, or stays where it is if the
+ * fastest router is not faster by more than ROUTER_FAILBACK_MARGIN_MS. Host CPU time counts
+ * CPU_SCALE times on the virtual clock, as in soak_sim.c.
+ *
+ * Usage: routers_bench [rtt_ms_fastest rtt_ms_second rtt_ms_third]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "provider_host.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+
+#define ROUTERS                             3
+#define ROUTER_PORT                         7447
+#define OPEN_ROUND_TRIPS                    3 // TCP handshake, zenoh InitSyn/InitAck and OpenSyn/OpenAck
+#define STOP_S                              20
+#define RESTART_S                           20
+#define RUN_S                               (STOP_S + RESTART_S + 2 * ROUTER_REPROBE_INTERVAL_S)
+#define ACCEPTED_MAX                        64
+#define CPU_SCALE                           30.0
+
+int host_log_level = 1;
+
+// Listed in CONNECT slowest first, so the probe has to reorder them.
+static const char *const s_addresses[ROUTERS] = {"127.0.0.13", "127.0.0.12", "127.0.0.11"};
+
+typedef struct
+{
+    int listener; // -1 while stopped
+    int accepted[ACCEPTED_MAX];
+    int accepted_count;
+} bench_router_t;
+
+typedef struct
+{
+    int fd;
+    int router;
+    bool published;
+} bench_transport_t;
+
+// What the provider did on its session, in virtual time
+typedef struct
+{
+    int64_t at_us;
+    int router;
+} bench_event_t;
+
+static bench_router_t s_routers[ROUTERS];
+static bench_event_t s_opening[16]; // Session opening started
+static bench_event_t s_opened[16];
+static bench_event_t s_closed[16];
+static bench_event_t s_published[16]; // First publication on a session
+static int s_opening_count, s_opened_count, s_closed_count, s_published_count;
+
+static void record(bench_event_t *events, int *count, int router)
+{
+    if (*count < 16)
+    {
+        events[(*count)++] = (bench_event_t){esp_timer_get_time(), router};
+    }
+}
+
+// Routers
+
+static int router_of(const char *address)
+{
+    for (int i = 0; i < ROUTERS; i++)
+    {
+        if (strcmp(s_addresses[i], address) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static struct sockaddr_in router_address(int router)
+{
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(ROUTER_PORT)};
+    inet_pton(AF_INET, s_addresses[router], &address.sin_addr);
+    return address;
+}
+
+static void router_start(int router)
+{
+    struct sockaddr_in address = router_address(router);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0)
+    {
+        fprintf(stderr, "Unable to listen on %s:%d: %s\n", s_addresses[router], ROUTER_PORT, strerror(errno));
+        exit(2);
+    }
+    s_routers[router].listener = fd;
+}
+
+static void router_stop(int router)
+{
+    bench_router_t *r = &s_routers[router];
+    close(r->listener);
+    r->listener = -1;
+    for (int i = 0; i < r->accepted_count; i++)
+    {
+        close(r->accepted[i]);
+    }
+    r->accepted_count = 0;
+}
+
+// Accepts new connections and closes the ones the provider closed, e.g. probes.
+static void router_serve(int router)
+{
+    bench_router_t *r = &s_routers[router];
+    if (r->listener < 0)
+    {
+        return;
+    }
+    for (int i = 0; i < r->accepted_count;)
+    {
+        char byte;
+        if (recv(r->accepted[i], &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+        {
+            close(r->accepted[i]);
+            r->accepted[i] = r->accepted[--r->accepted_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    int fd;
+    while (r->accepted_count < ACCEPTED_MAX && (fd = accept(r->listener, NULL, NULL)) >= 0)
+    {
+        r->accepted[r->accepted_count++] = fd;
+    }
+}
+
+// Transport to the routers
+
+void *host_transport_open(const char *locator)
+{
+    char address[INET_ADDRSTRLEN];
+    if (sscanf(locator, "tcp/%15[0-9.]", address) != 1 || router_of(address) < 0)
+    {
+        return NULL;
+    }
+    int router = router_of(address);
+    record(s_opening, &s_opening_count, router);
+
+    struct sockaddr_in sockaddr = router_address(router);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) != 0)
+    {
+        close(fd);
+        host_block_us(host_rtt_us(address));
+        return NULL;
+    }
+    host_block_us(OPEN_ROUND_TRIPS * host_rtt_us(address));
+
+    bench_transport_t *transport = malloc(sizeof(bench_transport_t));
+    *transport = (bench_transport_t){fd, router, false};
+    record(s_opened, &s_opened_count, router);
+    return transport;
+}
+
+void host_transport_close(void *transport)
+{
+    bench_transport_t *t = transport;
+    record(s_closed, &s_closed_count, t->router);
+    close(t->fd);
+    free(t);
+}
+
+bool host_transport_alive(void *transport)
+{
+    char byte;
+    ssize_t received = recv(((bench_transport_t *)transport)->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return received > 0 || (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+int host_transport_put(void *transport, const char *keyexpr, const uint8_t *payload, size_t len,
+                       const z_attachment_t *attachment)
+{
+    (void)keyexpr;
+    (void)payload;
+    (void)len;
+    (void)attachment;
+    bench_transport_t *t = transport;
+    if (!host_transport_alive(t))
+    {
+        return -1;
+    }
+    if (!t->published)
+    {
+        t->published = true;
+        record(s_published, &s_published_count, t->router);
+    }
+    return 0;
+}
+
+// Bench
+
+static int64_t s_stopped_us;
+static int64_t s_restarted_us;
+
+static void bench_task(void *arg)
+{
+    (void)arg;
+    int fastest = ROUTERS - 1;
+    while (1)
+    {
+        int64_t now_us = esp_timer_get_time();
+        if (s_stopped_us == 0 && s_published_count > 0 && now_us >= s_published[0].at_us + STOP_S * S + S / 2)
+        {
+            router_stop(fastest);
+            s_stopped_us = now_us;
+        }
+        else if (s_stopped_us != 0 && s_restarted_us == 0 && now_us >= s_stopped_us + RESTART_S * S)
+        {
+            router_start(fastest);
+            s_restarted_us = now_us;
+        }
+        for (int i = 0; i < ROUTERS; i++)
+        {
+            router_serve(i);
+        }
+        host_block_us(MS);
+    }
+}
+
+// Index of the first event for 'router' at or after 'after_us', or -1
+static int find(const bench_event_t *events, int count, int router, int64_t after_us)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (events[i].at_us >= after_us && (router < 0 || events[i].router == router))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static double ms(int64_t us)
+{
+    return (double)us / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t rtt_ms[ROUTERS] = {5, 20, 50}; // Fastest first
+    for (int i = 0; i < ROUTERS && i + 1 < argc; i++)
+    {
+        rtt_ms[i] = atoll(argv[i + 1]);
+    }
+    for (int i = 0; i < ROUTERS; i++)
+    {
+        host_set_rtt(s_addresses[ROUTERS - 1 - i], rtt_ms[i] * MS);
+        router_start(i);
+    }
+    int fastest = ROUTERS - 1;
+    int second = ROUTERS - 2;
+
+    host_set_cpu_scale(CPU_SCALE);
+    host_start(1);
+    xTaskCreate(bench_task, "bench", 4096, NULL, 1, NULL);
+    host_run_until(host_wifi_connect_us + RUN_S * S);
+
+    bool failed = false;
+    printf("routers %s (%lld ms), %s (%lld ms), %s (%lld ms), sessions take %d round trips\n",
+           s_addresses[fastest], (long long)rtt_ms[0], s_addresses[second], (long long)rtt_ms[1], s_addresses[0],
+           (long long)rtt_ms[2], OPEN_ROUND_TRIPS);
+
+    // Startup: WiFi is up at host_wifi_connect_us, the probe runs right after.
+    int opening = find(s_opening, s_opening_count, -1, 0);
+    int published = find(s_published, s_published_count, -1, 0);
+    if (opening < 0 || published < 0 || s_opening[opening].router != fastest)
+    {
+        printf("startup: did not open the session with the fastest router\n");
+        return 1;
+    }
+    printf("startup:  probe and selection %7.1f ms, session up %7.1f ms later\n",
+           ms(s_opening[opening].at_us - host_wifi_connect_us - host_nvs_init_us),
+           ms(s_published[published].at_us - s_opening[opening].at_us));
+
+    // Failover to the second fastest router
+    int closed = find(s_closed, s_closed_count, fastest, s_stopped_us);
+    opening = find(s_opening, s_opening_count, second, s_stopped_us);
+    published = find(s_published, s_published_count, second, s_stopped_us);
+    if (closed < 0 || opening < 0 || published < 0 || find(s_opening, s_opening_count, 0, s_stopped_us) >= 0)
+    {
+        printf("failover: did not move to the next fastest router\n");
+        failed = true;
+    }
+    else
+    {
+        printf("failover: detection %7.1f ms, probe and selection %7.1f ms, session up %7.1f ms later, "
+               "%7.1f ms in total\n",
+               ms(s_closed[closed].at_us - s_stopped_us), ms(s_opening[opening].at_us - s_closed[closed].at_us),
+               ms(s_published[published].at_us - s_opening[opening].at_us),
+               ms(s_published[published].at_us - s_stopped_us));
+    }
+
+    // Failback to the fastest router once the monitor probed it again, if it is faster by more than the margin
+    opening = find(s_opening, s_opening_count, fastest, s_restarted_us);
+    int opened = find(s_opened, s_opened_count, fastest, s_restarted_us);
+    closed = find(s_closed, s_closed_count, second, s_restarted_us);
+    published = find(s_published, s_published_count, fastest, s_restarted_us);
+    if (rtt_ms[1] - rtt_ms[0] <= ROUTER_FAILBACK_MARGIN_MS)
+    {
+        printf("failback: none expected within the %d ms margin, %s\n", ROUTER_FAILBACK_MARGIN_MS,
+               opening < 0 ? "none happened" : "but the session moved");
+        failed = failed || opening >= 0;
+    }
+    else if (s_restarted_us == 0 || opening < 0 || opened < 0 || closed < 0 || published < 0)
+    {
+        printf("failback: did not move back to the fastest router\n");
+        failed = true;
+    }
+    else if (s_opened[opened].at_us > s_closed[closed].at_us)
+    {
+        printf("failback: closed the current session before the new one was open\n");
+        failed = true;
+    }
+    else
+    {
+        printf("failback: re-probe after %7.1f s, new session open %7.1f ms later while the old one served, "
+               "declarations away %7.1f ms\n",
+               (double)(s_opening[opening].at_us - s_restarted_us) / S,
+               ms(s_opened[opened].at_us - s_opening[opening].at_us),
+               ms(s_published[published].at_us - s_closed[closed].at_us));
+    }
+
+    for (int i = 0; i < ROUTERS; i++)
+    {
+        if (s_routers[i].listener >= 0)
+        {
+            router_stop(i);
+        }
+    }
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
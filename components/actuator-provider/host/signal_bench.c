@@ -0,0 +1,206 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+/*
+ * Host benchmark of the signal table layout.
+ *
+ * Builds signal_table.c unchanged with SIGNAL_COUNT set by the Makefile (8, 64
+ * and 512) and times its two sweeps against the same sweeps over an array of
+ * structs holding the same fields. Every eighth signal is on with a deadline in
+ * the future and waits for its acknowledgement, so the sweeps find no expired
+ * signal and visit one in eight pending ones, as the supervision loop does
+ * while the horn is on.
+ *
+ * The figures are from the host and its data cache. On the ESP32 the table
+ * lives in internal SRAM without a data cache, there the layouts differ only
+ * in the memory a sweep reads, which the benchmark prints as cache lines.
+ *
+ * Usage: signal_bench_<count> [sweeps]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "history.h"
+#include "signal_table.h"
+#include "timer_wheel.h"
+
+int host_log_level = 1;
+
+// Array of structs with the fields of the signal table, in the order a struct per signal would have them
+typedef struct
+{
+    int64_t deadline_us;
+    uint8_t current;
+    uint8_t target;
+    uint8_t pending_ack;
+    uint32_t sequence;
+    timer_handle_t deadline_timer;
+    uint64_t gpio_mask;
+} signal_aos_t;
+
+static signal_aos_t s_aos[SIGNAL_COUNT];
+static volatile uint32_t s_visited;
+
+// ESP-IDF and the modules signal_table.c calls
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+timer_handle_t timer_wheel_schedule(uint32_t delay_ms, timer_callback_t callback, void *arg)
+{
+    (void)delay_ms;
+    (void)callback;
+    (void)arg;
+    return 1;
+}
+
+bool timer_wheel_cancel(timer_handle_t handle)
+{
+    return handle != TIMER_INVALID;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    (void)gpio_num;
+    (void)level;
+    return ESP_OK;
+}
+
+void history_record(signal_id_t id, history_event_t event, bool value)
+{
+    (void)id;
+    (void)event;
+    (void)value;
+}
+
+// The same sweeps over the array of structs, kept out of line like the ones of signal_table.c
+
+__attribute__((noinline)) static void aos_sweep_expired(int64_t now_us, signal_visit_t expired)
+{
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        int64_t deadline_us = __atomic_load_n(&s_aos[id].deadline_us, __ATOMIC_RELAXED);
+        if (deadline_us <= now_us &&
+            __atomic_compare_exchange_n(&s_aos[id].deadline_us, &deadline_us, SIGNAL_NO_DEADLINE, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED) &&
+            __atomic_load_n(&s_aos[id].current, __ATOMIC_RELAXED))
+        {
+            expired(id);
+        }
+    }
+}
+
+__attribute__((noinline)) static void aos_sweep_pending_acks(signal_visit_t pending)
+{
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        if (__atomic_load_n(&s_aos[id].pending_ack, __ATOMIC_RELAXED))
+        {
+            pending(id);
+        }
+    }
+}
+
+// Benchmark
+
+static void visit(signal_id_t id)
+{
+    s_visited += id;
+}
+
+static void failsafe(signal_id_t id)
+{
+    (void)id;
+}
+
+static double time_sweeps(void (*sweep)(int64_t now_us), uint32_t sweeps)
+{
+    int64_t now_us = esp_timer_get_time();
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < sweeps; i++)
+    {
+        sweep(now_us);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return elapsed_ns / sweeps;
+}
+
+// Read at run time, so neither layout gets the callback inlined.
+static signal_visit_t volatile s_visit = visit;
+
+static void soa_sweep(int64_t now_us)
+{
+    signal_sweep_expired(now_us, s_visit);
+    signal_sweep_pending_acks(s_visit);
+}
+
+static void aos_sweep(int64_t now_us)
+{
+    aos_sweep_expired(now_us, s_visit);
+    aos_sweep_pending_acks(s_visit);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t sweeps = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+    if (sweeps == 0)
+    {
+        sweeps = 1;
+    }
+
+    signal_table_init(failsafe);
+    int64_t deadline_us = esp_timer_get_time() + 3600LL * 1000000;
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        s_aos[id].deadline_us = SIGNAL_NO_DEADLINE;
+        if (id % 8 == 0)
+        {
+            signal_set_target(id, true);
+            signal_set_current(id, true);
+            signal_set_deadline(id, deadline_us);
+            s_aos[id].target = 1;
+            s_aos[id].sequence = 1;
+            s_aos[id].current = 1;
+            s_aos[id].pending_ack = 1;
+            s_aos[id].deadline_us = deadline_us;
+            s_aos[id].deadline_timer = 1;
+        }
+    }
+
+    // Warm up both tables before timing them.
+    time_sweeps(soa_sweep, sweeps / 10 + 1);
+    time_sweeps(aos_sweep, sweeps / 10 + 1);
+    double soa_ns = time_sweeps(soa_sweep, sweeps);
+    double aos_ns = time_sweeps(aos_sweep, sweeps);
+
+    // Cache lines a sweep reads: the deadlines and pending flags, or every struct.
+    size_t soa_lines = (SIGNAL_COUNT * sizeof(int64_t) + 63) / 64 + (SIGNAL_COUNT + 63) / 64;
+    size_t aos_lines = (SIGNAL_COUNT * sizeof(signal_aos_t) + 63) / 64;
+
+    printf("%4d signals, %u sweeps: struct of arrays %7.1f ns/sweep (%3zu cache lines), "
+           "array of structs %7.1f ns/sweep (%3zu cache lines)\n",
+           SIGNAL_COUNT, sweeps, soa_ns, soa_lines, aos_ns, aos_lines);
+    return 0;
+}
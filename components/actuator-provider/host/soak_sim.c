@@ -0,0 +1,269 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+/*
+ * Host soak run of the provider.
+ *
+ * Builds main.c with the signal table, the timer wheel, the horn lease,
+ * HornStatus and the soak monitor unchanged on the host runtime
+ * (provider_host.c) and drives it for hours of virtual time. A driver task
+ * sends about COMMANDS_PER_S samples per second on KEYEXPR: targetValues that
+ * switch the horn, heartbeats while it is on, currentValue echoes, faulty
+ * payloads and unknown types. Puts to the router fail at random and the
+ * router goes away for a while about once per OUTAGE_MEAN_S, so the sweep
+ * retries acknowledgements, the lease cuts the horn off and the session is
+ * recovered in place.
+ *
+ * Host time spent in the provider counts CPU_SCALE times on the virtual clock,
+ * an assumed ratio of the host to the ESP32 at 240 MHz, so the soak monitor
+ * sees latencies of the magnitude of the device's. The monitor prints its CSV
+ * time series (grep ^SOAK) and the run fails if:
+ *
+ * - the monitor marked a sample fail_heap or fail_latency,
+ * - the output did not follow a delivered targetValue,
+ * - the last currentValue published differs from the output at the end, or
+ * - the heap in use at the end exceeds the baseline by more than
+ *   CONFIG_SOAK_HEAP_GROWTH_LIMIT.
+ *
+ * Usage: soak_sim [hours] [seed]
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "provider_host.h"
+#include "soak.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+
+#define COMMANDS_PER_S                      100
+#define PUT_FAILURE_PERCENT                 1 // Puts the router does not take
+#define OUTAGE_MEAN_S                       3600 // Mean time between router outages
+#define OUTAGE_MAX_S                        30
+#define CONNECT_US                          (15 * MS) // TCP and zenoh handshake with the router
+#define CPU_SCALE                           30.0 // Assumed slowdown of the ESP32 against the host
+#define SETTLE_S                            10 // Time left after the last command for the sweeps
+
+int host_log_level = 1;
+
+typedef struct
+{
+    unsigned generation;
+} sim_transport_t;
+
+static uint64_t s_rng;
+static unsigned s_generation = 1; // Bumped by every outage, transports of earlier generations are dead
+static bool s_router_up = true;
+static int64_t s_outage_end_us;
+static bool s_done;
+
+static struct
+{
+    uint32_t delivered;
+    uint32_t lost; // Sent while no session was up
+    uint32_t targets;
+    uint32_t misses; // Delivered targetValues the output did not follow
+    uint32_t acks;
+    uint32_t statuses;
+    uint32_t failed_puts;
+    uint32_t outages;
+    uint32_t opens;
+    bool last_ack;
+} s_stats;
+
+static uint32_t random_below(uint32_t bound)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)((s_rng >> 32) % bound);
+}
+
+// Transport to the router
+
+void *host_transport_open(const char *locator)
+{
+    (void)locator;
+    host_block_us(CONNECT_US);
+    if (!s_router_up)
+    {
+        return NULL;
+    }
+    sim_transport_t *transport = malloc(sizeof(sim_transport_t));
+    transport->generation = s_generation;
+    s_stats.opens++;
+    return transport;
+}
+
+void host_transport_close(void *transport)
+{
+    free(transport);
+}
+
+bool host_transport_alive(void *transport)
+{
+    return s_router_up && ((sim_transport_t *)transport)->generation == s_generation;
+}
+
+static int8_t find_current_value(z_bytes_t key, z_bytes_t value, void *ctx)
+{
+    (void)ctx;
+    return key.len == 4 && memcmp(key.start, "type", 4) == 0 && value.len == 12 &&
+           memcmp(value.start, "currentValue", 12) == 0;
+}
+
+int host_transport_put(void *transport, const char *keyexpr, const uint8_t *payload, size_t len,
+                       const z_attachment_t *attachment)
+{
+    if (!host_transport_alive(transport) || random_below(100) < PUT_FAILURE_PERCENT)
+    {
+        s_stats.failed_puts++;
+        return -1;
+    }
+    if (strcmp(keyexpr, KEYEXPR) == 0 && attachment != NULL &&
+        z_attachment_iterate(*attachment, find_current_value, NULL) != 0)
+    {
+        s_stats.acks++;
+        s_stats.last_ack = len == 4 && memcmp(payload, "true", 4) == 0;
+    }
+    else if (strcmp(keyexpr, KEYEXPR) != 0)
+    {
+        s_stats.statuses++;
+    }
+    return 0;
+}
+
+// Driver
+
+static void send_target(bool on)
+{
+    int reached = host_deliver(KEYEXPR, on ? "true" : "false", "targetValue", NULL);
+    if (reached == 0)
+    {
+        s_stats.lost++;
+        return;
+    }
+    s_stats.delivered++;
+    s_stats.targets++;
+    if (host_gpio_level(LED_GPIO) != (on ? 1u : 0u))
+    {
+        s_stats.misses++;
+    }
+}
+
+static void send_other(const char *payload, const char *type)
+{
+    if (host_deliver(KEYEXPR, payload, type, NULL) == 0)
+    {
+        s_stats.lost++;
+        return;
+    }
+    s_stats.delivered++;
+}
+
+// Router outages start at random and end after up to OUTAGE_MAX_S.
+static void update_router(int64_t now_us)
+{
+    if (!s_router_up && now_us >= s_outage_end_us)
+    {
+        s_router_up = true;
+    }
+    else if (s_router_up && random_below(OUTAGE_MEAN_S * COMMANDS_PER_S) == 0)
+    {
+        s_router_up = false;
+        s_generation++;
+        s_stats.outages++;
+        s_outage_end_us = now_us + (1 + (int64_t)random_below(OUTAGE_MAX_S)) * S;
+    }
+}
+
+static void driver_task(void *arg)
+{
+    int64_t until_us = *(int64_t *)arg;
+    while (esp_timer_get_time() < until_us)
+    {
+        update_router(esp_timer_get_time());
+
+        // The horn service follows the output, a lease that ran out switched it off.
+        bool on = host_gpio_level(LED_GPIO) != 0;
+        uint32_t kind = random_below(100);
+        if (kind < 40)
+        {
+            send_target(!on);
+        }
+        else if (kind < 80)
+        {
+            send_target(on); // A heartbeat while on, a repeated "false" while off
+        }
+        else if (kind < 90)
+        {
+            send_other(on ? "true" : "false", "currentValue");
+        }
+        else if (kind < 95)
+        {
+            send_other("maybe", "targetValue");
+        }
+        else
+        {
+            send_other("true", "somethingElse");
+        }
+        host_block_us(S / COMMANDS_PER_S);
+    }
+    s_router_up = true;
+    s_done = true;
+    vTaskDelay(portMAX_DELAY);
+}
+
+int main(int argc, char **argv)
+{
+    double hours = argc > 1 ? atof(argv[1]) : 8.0;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    s_rng = seed != 0 ? seed : 1;
+
+    // The driver starts once the provider had time to boot and open its session.
+    int64_t start_us = 10 * S;
+    int64_t until_us = start_us + (int64_t)(hours * 3600.0 * S);
+    host_set_cpu_scale(CPU_SCALE);
+    host_start(seed);
+    host_run_until(start_us);
+    size_t baseline_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    xTaskCreate(driver_task, "driver", 4096, &until_us, 1, NULL);
+    host_run_until(until_us + SETTLE_S * S);
+    size_t end_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+
+    bool output = host_gpio_level(LED_GPIO) != 0;
+    bool heap_grew = baseline_free > end_free && baseline_free - end_free > CONFIG_SOAK_HEAP_GROWTH_LIMIT;
+    bool failed = !s_done || soak_failures() > 0 || s_stats.misses > 0 || s_stats.last_ack != output || heap_grew;
+
+    printf("%.1f h, %lu samples delivered (%lu targetValues), %lu lost in %lu router outages, %lu sessions opened\n",
+           hours, (unsigned long)s_stats.delivered, (unsigned long)s_stats.targets, (unsigned long)s_stats.lost,
+           (unsigned long)s_stats.outages, (unsigned long)s_stats.opens);
+    printf("%lu currentValue and %lu HornStatus publications, %lu puts failed, output not following %lu targetValues\n",
+           (unsigned long)s_stats.acks, (unsigned long)s_stats.statuses, (unsigned long)s_stats.failed_puts,
+           (unsigned long)s_stats.misses);
+    printf("output %s, last currentValue %s, heap in use %ld bytes against the baseline, %lu failed soak samples\n",
+           output ? "on" : "off", s_stats.last_ack ? "true" : "false", (long)baseline_free - (long)end_free,
+           (unsigned long)soak_failures());
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
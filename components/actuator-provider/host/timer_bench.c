@@ -0,0 +1,247 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+/*
+ * Host benchmark of the timer wheel.
+ *
+ * Builds timer_wheel.c unchanged against a simulated clock and hardware timer.
+ * The timer wheel task runs whenever it was notified: the host shim of
+ * ulTaskNotifyTake() returns to the benchmark once no notification is left,
+ * and the next wake-up enters the task function afresh, which is the same as
+ * continuing its loop.
+ *
+ * For thousands of timers it times scheduling, cancelling and expiry on the
+ * host clock, checks that every timer fired within its tick and not before,
+ * counts the wake-ups of the task against the ticks covered and reports the
+ * longest wake-up, the time the wheel adds to the latency of a tick on the
+ * host. The device logs its own worst-case tick latency.
+ *
+ * Usage: timer_bench [timers] [seconds] [seed]
+ */
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "timer_wheel.h"
+
+#define MS                                  1000LL
+#define S                                   (1000 * MS)
+#define TICK_US                             ((int64_t)TIMER_WHEEL_TICK_MS * MS)
+
+int host_log_level = 1;
+
+static int64_t s_now_us = S;
+static esp_timer_cb_t s_hw_callback;
+static bool s_hw_active;
+static int64_t s_hw_due_us;
+static TaskFunction_t s_task;
+static uint32_t s_notifications;
+static jmp_buf s_task_blocked;
+
+typedef struct
+{
+    int64_t due_us;
+    int64_t fired_us;
+} bench_timer_t;
+
+static bench_timer_t s_timers[TIMER_WHEEL_POOL_SIZE];
+static timer_handle_t s_handles[TIMER_WHEEL_POOL_SIZE];
+static uint32_t s_fired;
+static uint64_t s_rng;
+
+// ESP-IDF and FreeRTOS
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    s_hw_callback = args->callback;
+    *handle = (esp_timer_handle_t)&s_hw_callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    (void)timer;
+    if (s_hw_active)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_hw_active = true;
+    s_hw_due_us = s_now_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    (void)timer;
+    bool active = s_hw_active;
+    s_hw_active = false;
+    return active ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)arg;
+    (void)priority;
+    s_task = function;
+    *handle = (TaskHandle_t)&s_task;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    s_notifications++;
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    (void)clear_on_exit;
+    (void)ticks_to_wait;
+    if (s_notifications == 0)
+    {
+        longjmp(s_task_blocked, 1);
+    }
+    uint32_t notifications = s_notifications;
+    s_notifications = 0;
+    return notifications;
+}
+
+// Benchmark
+
+static double now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static uint32_t random_below(uint32_t bound)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng % bound);
+}
+
+static void fired(void *arg)
+{
+    bench_timer_t *timer = arg;
+    timer->fired_us = s_now_us;
+    s_fired++;
+}
+
+// Runs the timer wheel task until it waits for the next notification.
+static void run_task(void)
+{
+    if (setjmp(s_task_blocked) == 0)
+    {
+        s_task(NULL);
+    }
+}
+
+static void schedule_all(uint32_t count, uint32_t max_delay_ms)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t delay_ms = random_below(max_delay_ms + 1);
+        s_timers[i].due_us = s_now_us + (int64_t)delay_ms * MS;
+        s_timers[i].fired_us = -1;
+        s_handles[i] = timer_wheel_schedule(delay_ms, fired, &s_timers[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : TIMER_WHEEL_POOL_SIZE;
+    uint32_t seconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 60;
+    s_rng = argc > 3 ? strtoull(argv[3], NULL, 0) : 1;
+    if (count > TIMER_WHEEL_POOL_SIZE)
+    {
+        count = TIMER_WHEEL_POOL_SIZE;
+    }
+    if (s_rng == 0)
+    {
+        s_rng = 1;
+    }
+
+    timer_wheel_start();
+    run_task();
+
+    // Scheduling and cancelling, with delays up to an hour to fill all levels
+    double started_ns = now_ns();
+    schedule_all(count, 3600 * 1000);
+    double schedule_ns = (now_ns() - started_ns) / count;
+    started_ns = now_ns();
+    uint32_t cancelled = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        cancelled += timer_wheel_cancel(s_handles[i]);
+    }
+    double cancel_ns = (now_ns() - started_ns) / count;
+    run_task();
+
+    // Expiry, the clock jumping to each wake-up of the hardware timer
+    schedule_all(count, seconds * 1000);
+    int64_t first_us = s_now_us;
+    uint32_t wakeups = 0;
+    uint32_t early = 0;
+    uint32_t late = 0;
+    double expiry_ns = 0;
+    double worst_wakeup_ns = 0;
+    run_task();
+    while (s_hw_active)
+    {
+        s_now_us = s_hw_due_us;
+        s_hw_active = false;
+        s_hw_callback(NULL);
+        started_ns = now_ns();
+        run_task();
+        double wakeup_ns = now_ns() - started_ns;
+        expiry_ns += wakeup_ns;
+        worst_wakeup_ns = wakeup_ns > worst_wakeup_ns ? wakeup_ns : worst_wakeup_ns;
+        wakeups++;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (s_timers[i].fired_us < 0)
+        {
+            continue;
+        }
+        early += s_timers[i].fired_us < s_timers[i].due_us;
+        late += s_timers[i].fired_us >= s_timers[i].due_us + TICK_US;
+    }
+
+    printf("%u timers, pool of %d, %d ms ticks\n", count, TIMER_WHEEL_POOL_SIZE, TIMER_WHEEL_TICK_MS);
+    printf("  schedule %.1f ns, cancel %.1f ns per timer (%u cancelled)\n", schedule_ns, cancel_ns, cancelled);
+    printf("  expiry over %u s: %u of %u fired, %u early, %u a tick or more late, %.1f ns per timer\n", seconds,
+           s_fired, count, early, late, s_fired > 0 ? expiry_ns / s_fired : 0.0);
+    printf("  %u wake-ups for %lld ticks, longest wake-up %.1f us\n", wakeups,
+           (long long)((s_now_us - first_us) / TICK_US), worst_wakeup_ns / 1000.0);
+    return s_fired == count && early == 0 && late == 0 ? 0 : 1;
+}
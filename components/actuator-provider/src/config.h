@@ -29,8 +29,13 @@
 CONNECT specifies the connection string to the Zenoh router.
 Replace <ip> with the IP address of the machine hosting the blueprint Docker setup.
 Format: "tcp/<ip>:7447#iface=docker0".
+Several routers can be listed separated by ';', e.g. "tcp/<ip1>:7447;tcp/<ip2>:7447".
+They are probed at startup and the session is opened with the one answering fastest.
+It can also be given at build time, e.g. -DCONNECT='"tcp/<ip>:7447"'.
 */
+#ifndef CONNECT
 #define CONNECT                             ""
+#endif
 #elif CLIENT_OR_PEER == 1
 #define MODE                                "peer"
 /*
@@ -42,5 +47,68 @@ Format: "tcp/<ip>:7447#iface=docker0".
 #error "Unknown Zenoh operation mode. Check CLIENT_OR_PEER value."
 #endif
 
+#define SESSION_CHECK_INTERVAL_S            1 // How often the session with the router is checked
+#define SESSION_RETRY_MIN_MS                100 // First backoff delay when the session cannot be established
+#define SESSION_RETRY_MAX_MS                5000 // Upper limit of the backoff delay between session attempts
+#define ROUTER_PROBE_TIMEOUT_MS             1000 // How long to wait for routers to answer a probe
+#define ROUTER_REPROBE_INTERVAL_S           60 // How often the routers are probed again to fail back to a faster one
+#define ROUTER_FAILBACK_MARGIN_MS           5 // How much faster another router must answer to move the session
+
+#ifdef ZENOH_PROFILE_MINIMAL
+#define ZENOH_PROFILE                       "minimal" // zenoh-pico built with zenoh-minimal.flags
+_Static_assert(sizeof(CONNECT) > 1,
+               "the minimal zenoh-pico profile cannot scout, set CONNECT in config.h or with -DCONNECT to the router");
+#else
+#define ZENOH_PROFILE                       "default"
+#endif
+
+#define TIMER_WHEEL_TICK_MS                 10 // Resolution of the timer wheel
+#define TIMER_WHEEL_POOL_SIZE               CONFIG_TIMER_WHEEL_POOL_SIZE // Number of timers that can be pending at the same time
+
 #define KEYEXPR                             "Vehicle/Body/Horn/IsActive" // The key to subscribe/publish to
 #define LED_GPIO                            GPIO_NUM_25 // Number of the GPIO pin with the LED connected
+
+/*
+ * Placement of the provider's actuation path (classify, apply, acknowledge).
+ * With CONFIG_ACTUATION_IN_IRAM it runs from IRAM and its constants live in
+ * DRAM. The zenoh-pico calls it makes still run from flash.
+ */
+#ifdef CONFIG_ACTUATION_IN_IRAM
+#include <esp_attr.h>
+#define ACTUATION_ATTR                      IRAM_ATTR
+#define ACTUATION_DATA_ATTR                 DRAM_ATTR
+#else
+#define ACTUATION_ATTR
+#define ACTUATION_DATA_ATTR
+#endif
+
+#ifdef CONFIG_ACTUATION_PM_POLICY_ACTIVE
+#define ACTUATION_PM_LINGER_MS              CONFIG_ACTUATION_PM_LINGER_MS // Time the locks stay held after a command
+#endif
+
+#ifdef CONFIG_DELTA_OTA_ENABLED
+#define OTA_KEYEXPR                         CONFIG_DELTA_OTA_KEYEXPR // The key to receive delta update fragments on
+#define OTA_STATUS_KEYEXPR                  CONFIG_DELTA_OTA_KEYEXPR "/status" // The key to report the update result to
+#endif
+
+#ifdef CONFIG_HORN_LEASE_ENABLED
+#define HORN_LEASE_MS                       CONFIG_HORN_LEASE_MS // Time the horn stays on without a heartbeat
+#endif
+
+#ifdef CONFIG_CURRENT_VALUE_ON_DEMAND
+#define CONSUMERS_KEYEXPR                   KEYEXPR "/Consumers/*" // The key consumers announce themselves on
+#define CONSUMER_LEASE_MS                   CONFIG_CONSUMER_LEASE_MS // Time a consumer counts as present after announcing
+#endif
+
+#ifdef CONFIG_HISTORY_ENABLED
+#define HISTORY_KEYEXPR                     CONFIG_HISTORY_KEYEXPR // The key the actuation history is queried on
+#endif
+
+#if defined(CONFIG_HORN_STATUS_ENABLED) || defined(CONFIG_HORN_RPC_ENABLED)
+#define HORN_SERVICE_AUTHORITY              CONFIG_HORN_SERVICE_AUTHORITY // uProtocol authority of the horn service
+#define HORN_SERVICE_ID                     0x1C // service_id of the Horn service in horn_service.proto
+#define HORN_SERVICE_VERSION_MAJOR          1
+#define HORN_STATUS_RESOURCE_ID             0x8000 // publish_topic of the Horn service
+#define HORN_ACTIVATE_METHOD_ID             1 // method_id of ActivateHorn
+#define HORN_DEACTIVATE_METHOD_ID           2 // method_id of DeactivateHorn
+#endif
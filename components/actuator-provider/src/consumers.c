@@ -0,0 +1,149 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "config.h"
+#include "consumers.h"
+
+#ifdef CONFIG_CURRENT_VALUE_ON_DEMAND
+static const char *TAG = "CONSUMERS";
+
+static consumers_appeared_t s_appeared;
+static z_owned_subscriber_t s_sub;
+static bool s_declared = false;
+
+// Time of the latest announcement, 0 before the first one
+static int64_t s_last_seen_us = 0;
+// Publications skipped since the last consumer left
+static uint32_t s_skipped = 0;
+static uint32_t s_skipped_bytes = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static ACTUATION_ATTR bool consumers_present_at(int64_t now_us)
+{
+    return s_last_seen_us != 0 && now_us - s_last_seen_us < (int64_t)CONSUMER_LEASE_MS * 1000;
+}
+
+ACTUATION_ATTR bool consumers_present(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool present = consumers_present_at(now_us);
+    portEXIT_CRITICAL(&s_lock);
+    return present;
+}
+
+bool consumers_announced(int64_t now_us, bool joining)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool appeared = !consumers_present_at(now_us);
+    s_last_seen_us = now_us;
+    uint32_t skipped = s_skipped;
+    uint32_t skipped_bytes = s_skipped_bytes;
+    if (appeared)
+    {
+        s_skipped = 0;
+        s_skipped_bytes = 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (appeared)
+    {
+        ESP_LOGI(TAG, "A consumer appeared, %lu currentValue publications (%lu bytes) were skipped without one.",
+                 (unsigned long)skipped, (unsigned long)skipped_bytes);
+    }
+    return appeared || joining;
+}
+
+void consumers_skipped(uint32_t bytes)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_skipped++;
+    s_skipped_bytes += bytes;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void consumers_handler(const z_sample_t *sample, void *arg)
+{
+    (void)arg;
+    bool joining = sample->payload.len == 4 && memcmp(sample->payload.start, "join", 4) == 0;
+    if (consumers_announced(esp_timer_get_time(), joining) && s_appeared != NULL)
+    {
+        s_appeared();
+    }
+}
+
+void consumers_init(consumers_appeared_t appeared)
+{
+    s_appeared = appeared;
+}
+
+int consumers_declare(z_session_t session)
+{
+    z_owned_closure_sample_t callback = z_closure(consumers_handler);
+    s_sub = z_declare_subscriber(session, z_keyexpr(CONSUMERS_KEYEXPR), z_move(callback), NULL);
+    if (!z_check(s_sub))
+    {
+        ESP_LOGE(TAG, "Unable to declare subscriber on '%s'.", CONSUMERS_KEYEXPR);
+        return -1;
+    }
+    s_declared = true;
+    ESP_LOGI(TAG, "Publishing currentValue only while consumers announce themselves on '%s'.", CONSUMERS_KEYEXPR);
+    return 0;
+}
+
+void consumers_undeclare(void)
+{
+    if (s_declared)
+    {
+        s_declared = false;
+        z_undeclare_subscriber(z_move(s_sub));
+    }
+}
+#else
+void consumers_init(consumers_appeared_t appeared)
+{
+    (void)appeared;
+}
+
+int consumers_declare(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+void consumers_undeclare(void)
+{
+}
+
+ACTUATION_ATTR bool consumers_present(void)
+{
+    return true;
+}
+
+bool consumers_announced(int64_t now_us, bool joining)
+{
+    (void)now_us;
+    (void)joining;
+    return false;
+}
+
+void consumers_skipped(uint32_t bytes)
+{
+    (void)bytes;
+}
+#endif
@@ -0,0 +1,53 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef CONSUMERS_H
+#define CONSUMERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zenoh-pico.h>
+
+/*
+ * Presence of currentValue consumers.
+ *
+ * zenoh-pico 0.11 has neither publisher matching status nor liveliness tokens,
+ * and a client session never learns about remote subscribers. Consumers
+ * therefore announce themselves instead: they put "join" on CONSUMERS_KEYEXPR
+ * ("<KEYEXPR>/Consumers/<id>") right after subscribing and an empty payload
+ * periodically after that, well within the lease. A consumer counts as present until
+ * CONSUMER_LEASE_MS pass without an announcement.
+ *
+ * While no consumer is present currentValue is not published and only the
+ * latest state is kept in the signal table. A "join", or the first
+ * announcement while nobody was present, calls 'appeared' in the Zenoh read
+ * task, which publishes the latest state.
+ */
+typedef void (*consumers_appeared_t)(void);
+
+void consumers_init(consumers_appeared_t appeared);
+int consumers_declare(z_session_t session);
+void consumers_undeclare(void);
+
+// True while a consumer announced itself within the lease
+bool consumers_present(void);
+
+// Records an announcement at 'now_us'. Returns true if the latest state has to be
+// published, because the consumer joins or no consumer was present before.
+bool consumers_announced(int64_t now_us, bool joining);
+
+// Records a publication skipped for lack of consumers, of 'bytes' payload and attachment.
+void consumers_skipped(uint32_t bytes);
+
+#endif
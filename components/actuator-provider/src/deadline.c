@@ -0,0 +1,98 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <sys/time.h>
+#include "config.h"
+#include "deadline.h"
+
+#ifdef CONFIG_DEADLINE_ENABLED
+#include <esp_netif_sntp.h>
+
+static const char *TAG = "DEADLINE";
+
+static const char *const s_hop_names[DEADLINE_HOP_COUNT] = {"subscriber", "RPC endpoint", "sequence player"};
+static uint32_t s_expired[DEADLINE_HOP_COUNT];
+static bool s_clock_synced = false;
+
+static void deadline_clock_synced(struct timeval *tv)
+{
+    (void)tv;
+    if (!s_clock_synced)
+    {
+        ESP_LOGI(TAG, "Wall clock synchronized, deadlines are enforced from now on.");
+    }
+    s_clock_synced = true;
+}
+
+void deadline_clock_start(void)
+{
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_DEADLINE_SNTP_SERVER);
+    config.sync_cb = deadline_clock_synced;
+    esp_netif_sntp_init(&config);
+}
+
+// The wall clock read itself goes through newlib and may run from flash.
+static uint64_t deadline_now_ms(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+ACTUATION_ATTR bool deadline_expired(uint64_t deadline_ms)
+{
+    return deadline_ms != DEADLINE_NONE && s_clock_synced && deadline_now_ms() > deadline_ms;
+}
+
+void deadline_record_expired(deadline_hop_t hop, uint64_t deadline_ms)
+{
+    uint32_t expired = __atomic_add_fetch(&s_expired[hop], 1, __ATOMIC_RELAXED);
+    ESP_LOGW(TAG, "Dropped a command in the %s %llu ms after its deadline (%lu dropped there so far).",
+             s_hop_names[hop], (unsigned long long)(deadline_now_ms() - deadline_ms), (unsigned long)expired);
+}
+#else
+void deadline_clock_start(void)
+{
+}
+
+ACTUATION_ATTR bool deadline_expired(uint64_t deadline_ms)
+{
+    (void)deadline_ms;
+    return false;
+}
+
+void deadline_record_expired(deadline_hop_t hop, uint64_t deadline_ms)
+{
+    (void)hop;
+    (void)deadline_ms;
+}
+#endif
+
+ACTUATION_ATTR uint64_t deadline_parse(const uint8_t *value, size_t len)
+{
+    uint64_t deadline_ms = 0;
+    if (len == 0 || len > 19)
+    {
+        return DEADLINE_NONE;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (value[i] < '0' || value[i] > '9')
+        {
+            return DEADLINE_NONE;
+        }
+        deadline_ms = deadline_ms * 10 + (value[i] - '0');
+    }
+    return deadline_ms;
+}
@@ -0,0 +1,52 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Absolute deadlines of commands, in milliseconds since the Unix epoch.
+ *
+ * Commands that arrive or would start after their deadline are dropped and
+ * counted per hop. Deadlines come from the TTL of uProtocol requests or from
+ * a "deadline" attachment entry of a targetValue. They can only be compared
+ * with a synchronized wall clock, so until SNTP has set the clock nothing is
+ * treated as expired.
+ */
+#define DEADLINE_NONE                       0
+
+typedef enum
+{
+    DEADLINE_HOP_SUBSCRIBER,
+    DEADLINE_HOP_RPC,
+    DEADLINE_HOP_PLAYER,
+    DEADLINE_HOP_COUNT
+} deadline_hop_t;
+
+// Starts synchronizing the wall clock. Requires the network to be up.
+void deadline_clock_start(void);
+
+// True if the deadline has passed. Always false for DEADLINE_NONE or an unsynchronized clock.
+bool deadline_expired(uint64_t deadline_ms);
+
+// Counts and logs a command dropped at the given hop.
+void deadline_record_expired(deadline_hop_t hop, uint64_t deadline_ms);
+
+// Parses a decimal deadline. Returns DEADLINE_NONE if the value is not a number.
+uint64_t deadline_parse(const uint8_t *value, size_t len);
+
+#endif
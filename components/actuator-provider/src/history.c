@@ -0,0 +1,420 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include "config.h"
+#include "history.h"
+
+#ifdef CONFIG_HISTORY_ENABLED
+
+#define HISTORY_MASK                        (CONFIG_HISTORY_SIZE - 1)
+#define HISTORY_EVENT_MAX_LEN               9 // header, a 16 bit signal id and a delta of up to 2^35 ms
+#define HISTORY_DELTA_MAX                   ((1ULL << 35) - 1)
+#define HISTORY_CHUNK_LEN                   512 // bytes copied out of the ring at a time
+#define HISTORY_PAGE_HEADER_MAX_LEN         32
+
+_Static_assert((CONFIG_HISTORY_SIZE & HISTORY_MASK) == 0, "the history size must be a power of two");
+
+static const char *TAG = "HISTORY";
+
+/*
+ * Positions count bytes since boot and only ever grow; a position maps to the
+ * ring modulo its size. The event at the tail is the oldest one kept; its time
+ * is tracked separately because the event it was encoded against is gone.
+ */
+static uint8_t s_ring[CONFIG_HISTORY_SIZE];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_head;
+static uint32_t s_tail;
+static uint32_t s_tail_seq;
+static int64_t s_tail_time_ms;
+static int64_t s_head_time_ms;
+
+static z_owned_queryable_t s_queryable;
+static bool s_declared = false;
+
+typedef struct
+{
+    uint8_t header;
+    signal_id_t id;
+    uint32_t seq;
+    int64_t time_ms;
+} history_entry_t;
+
+static inline ACTUATION_ATTR size_t history_put_varint(uint8_t *buf, uint64_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        buf[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t)value;
+    return len;
+}
+
+// Decodes a varint from 'buf'. Returns its length, or 0 if it does not end within 'len' bytes.
+static size_t history_get_varint(const uint8_t *buf, size_t len, uint64_t *value)
+{
+    *value = 0;
+    for (size_t i = 0; i < len && i < 10; i++)
+    {
+        *value |= (uint64_t)(buf[i] & 0x7F) << (7 * i);
+        if ((buf[i] & 0x80) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Decodes the event at the start of 'buf': the header, the escaped signal id
+ * and the delta. Returns its length, or 0 if it does not end within 'len' bytes.
+ */
+static size_t history_parse_event(const uint8_t *buf, size_t len, signal_id_t *id, uint64_t *delta)
+{
+    if (len < 2)
+    {
+        return 0;
+    }
+    size_t pos = 1;
+    *id = buf[0] >> 4;
+    if (*id == HISTORY_ID_ESCAPE)
+    {
+        uint64_t escaped;
+        size_t id_len = history_get_varint(&buf[pos], len - pos, &escaped);
+        if (id_len == 0)
+        {
+            return 0;
+        }
+        *id = (signal_id_t)escaped;
+        pos += id_len;
+    }
+    size_t delta_len = history_get_varint(&buf[pos], len - pos, delta);
+    return delta_len == 0 ? 0 : pos + delta_len;
+}
+
+// Ring position after the varint at 'pos'.
+static inline ACTUATION_ATTR uint32_t history_ring_skip_varint(uint32_t pos)
+{
+    while (s_ring[pos & HISTORY_MASK] & 0x80)
+    {
+        pos++;
+    }
+    return pos + 1;
+}
+
+// Ring position of the delta of the event at 'pos', after the header and an escaped id.
+static inline ACTUATION_ATTR uint32_t history_ring_delta_pos(uint32_t pos)
+{
+    bool escaped = s_ring[pos & HISTORY_MASK] >> 4 == HISTORY_ID_ESCAPE;
+    pos++;
+    return escaped ? history_ring_skip_varint(pos) : pos;
+}
+
+// Length of the event at ring position 'pos'.
+static inline ACTUATION_ATTR uint32_t history_ring_event_len(uint32_t pos)
+{
+    return history_ring_skip_varint(history_ring_delta_pos(pos)) - pos;
+}
+
+static inline ACTUATION_ATTR uint64_t history_ring_delta(uint32_t pos)
+{
+    uint64_t delta = 0;
+    pos = history_ring_delta_pos(pos);
+    for (uint32_t shift = 0;; shift += 7)
+    {
+        uint8_t byte = s_ring[pos++ & HISTORY_MASK];
+        delta |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return delta;
+        }
+    }
+}
+
+ACTUATION_ATTR void history_record(signal_id_t id, history_event_t event, bool value)
+{
+    uint8_t encoded[HISTORY_EVENT_MAX_LEN];
+    uint32_t len = 1;
+    encoded[0] = (uint8_t)event | (uint8_t)value << 3 | (uint8_t)((id < HISTORY_ID_ESCAPE ? id : HISTORY_ID_ESCAPE) << 4);
+    if (id >= HISTORY_ID_ESCAPE)
+    {
+        len += history_put_varint(&encoded[len], id);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    uint64_t delta = s_head != s_tail ? (uint64_t)(now_ms - s_head_time_ms) : 0;
+    len += history_put_varint(&encoded[len], delta < HISTORY_DELTA_MAX ? delta : HISTORY_DELTA_MAX);
+
+    while (s_head + len - s_tail > CONFIG_HISTORY_SIZE)
+    {
+        s_tail += history_ring_event_len(s_tail);
+        s_tail_seq++;
+        s_tail_time_ms += s_head != s_tail ? history_ring_delta(s_tail) : 0;
+    }
+    if (s_head == s_tail)
+    {
+        s_tail_time_ms = now_ms;
+    }
+    for (uint32_t i = 0; i < len; i++)
+    {
+        s_ring[(s_head + i) & HISTORY_MASK] = encoded[i];
+    }
+    s_head += len;
+    s_head_time_ms = now_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/*
+ * Reads the ring front to back in chunks, each copied out under the lock so
+ * recording is never held up for longer than a short memcpy. Events evicted
+ * between two chunks are skipped.
+ */
+typedef struct
+{
+    uint8_t chunk[HISTORY_CHUNK_LEN];
+    size_t chunk_len;
+    size_t chunk_pos;
+    uint32_t pos; // ring position of chunk[0]
+    uint32_t seq;
+    int64_t time_ms;
+    bool started;
+} history_reader_t;
+
+static bool history_reader_fill(history_reader_t *reader)
+{
+    uint32_t pos = reader->pos + reader->chunk_pos;
+    portENTER_CRITICAL(&s_lock);
+    if (!reader->started || (int32_t)(pos - s_tail) < 0)
+    {
+        // Start over at the oldest event, its delta is not relative to a known event.
+        reader->started = false;
+        pos = s_tail;
+        reader->seq = s_tail_seq;
+        reader->time_ms = s_tail_time_ms;
+    }
+    uint32_t len = s_head - pos < HISTORY_CHUNK_LEN ? s_head - pos : HISTORY_CHUNK_LEN;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        reader->chunk[i] = s_ring[(pos + i) & HISTORY_MASK];
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    reader->pos = pos;
+    reader->chunk_len = len;
+    reader->chunk_pos = 0;
+    return len > 0;
+}
+
+static bool history_reader_next(history_reader_t *reader, history_entry_t *entry)
+{
+    uint64_t delta = 0;
+    size_t event_len = history_parse_event(&reader->chunk[reader->chunk_pos],
+                                           reader->chunk_len - reader->chunk_pos, &entry->id, &delta);
+    if (event_len == 0)
+    {
+        if (!history_reader_fill(reader))
+        {
+            return false;
+        }
+        event_len = history_parse_event(reader->chunk, reader->chunk_len, &entry->id, &delta);
+        if (event_len == 0)
+        {
+            return false;
+        }
+    }
+
+    entry->header = reader->chunk[reader->chunk_pos];
+    if (reader->started)
+    {
+        reader->seq++;
+        reader->time_ms += delta;
+    }
+    reader->started = true;
+    entry->seq = reader->seq;
+    entry->time_ms = reader->time_ms;
+    reader->chunk_pos += event_len;
+    return true;
+}
+
+// Parses the unsigned parameter 'name' of a selector like "from=10;to=20".
+static bool history_param(z_bytes_t params, const char *name, uint64_t *value)
+{
+    size_t name_len = strlen(name);
+    const char *start = (const char *)params.start;
+    const char *end = start + params.len;
+    while (start < end)
+    {
+        const char *next = start;
+        while (next < end && *next != ';' && *next != '&')
+        {
+            next++;
+        }
+        if ((size_t)(next - start) > name_len && memcmp(start, name, name_len) == 0 && start[name_len] == '=')
+        {
+            *value = 0;
+            for (const char *c = start + name_len + 1; c < next; c++)
+            {
+                if (*c < '0' || *c > '9')
+                {
+                    return false;
+                }
+                *value = *value * 10 + (uint64_t)(*c - '0');
+            }
+            return true;
+        }
+        start = next + 1;
+    }
+    return false;
+}
+
+static void history_reply_page(const z_query_t *query, const uint8_t *events, size_t events_len,
+                               const history_entry_t *first, uint32_t count, bool more)
+{
+    static uint8_t page[HISTORY_PAGE_HEADER_MAX_LEN + HISTORY_PAGE_EVENTS * HISTORY_EVENT_MAX_LEN];
+    size_t len = 0;
+    page[len++] = HISTORY_PAGE_VERSION;
+    page[len++] = more ? HISTORY_PAGE_MORE : 0;
+    len += history_put_varint(&page[len], first->seq);
+    len += history_put_varint(&page[len], (uint64_t)first->time_ms);
+    len += history_put_varint(&page[len], (uint64_t)(esp_timer_get_time() / 1000));
+    len += history_put_varint(&page[len], count);
+    memcpy(&page[len], events, events_len);
+    len += events_len;
+
+    z_query_reply_options_t options = z_query_reply_options_default();
+    z_query_reply(query, z_keyexpr(HISTORY_KEYEXPR), page, len, &options);
+}
+
+// Streams the events selected by the query parameters in pages.
+static void history_query_handler(const z_query_t *query, void *ctx)
+{
+    (void)ctx;
+    static history_reader_t reader;
+    static uint8_t events[HISTORY_PAGE_EVENTS * HISTORY_EVENT_MAX_LEN];
+    int64_t started_us = esp_timer_get_time();
+
+    z_bytes_t params = z_query_parameters(query);
+    uint64_t from_ms = 0;
+    uint64_t to_ms = INT64_MAX;
+    uint64_t cursor = 0;
+    uint64_t limit = HISTORY_QUERY_MAX_EVENTS;
+    history_param(params, "from", &from_ms);
+    history_param(params, "to", &to_ms);
+    history_param(params, "cursor", &cursor);
+    if (history_param(params, "limit", &limit) && (limit == 0 || limit > HISTORY_QUERY_MAX_EVENTS))
+    {
+        limit = HISTORY_QUERY_MAX_EVENTS;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    history_entry_t entry;
+    history_entry_t first = {0};
+    int64_t previous_ms = 0;
+    size_t events_len = 0;
+    uint32_t page_count = 0;
+    uint32_t total = 0;
+    uint32_t pages = 0;
+    bool more = false;
+    while (history_reader_next(&reader, &entry))
+    {
+        if (entry.seq < cursor || (uint64_t)entry.time_ms < from_ms)
+        {
+            continue;
+        }
+        if ((uint64_t)entry.time_ms > to_ms)
+        {
+            break;
+        }
+        if (total == limit)
+        {
+            more = true;
+            break;
+        }
+        if (page_count == HISTORY_PAGE_EVENTS)
+        {
+            history_reply_page(query, events, events_len, &first, page_count, false);
+            pages++;
+            page_count = 0;
+            events_len = 0;
+        }
+        if (page_count == 0)
+        {
+            first = entry;
+            previous_ms = entry.time_ms;
+        }
+        events[events_len++] = entry.header;
+        if (entry.id >= HISTORY_ID_ESCAPE)
+        {
+            events_len += history_put_varint(&events[events_len], entry.id);
+        }
+        events_len += history_put_varint(&events[events_len], (uint64_t)(entry.time_ms - previous_ms));
+        previous_ms = entry.time_ms;
+        page_count++;
+        total++;
+    }
+    // An empty page tells the client that nothing matched.
+    history_reply_page(query, events, events_len, &first, page_count, more);
+    pages++;
+
+    ESP_LOGI(TAG, "Served %lu event(s) in %lu page(s) in %lld us.", (unsigned long)total, (unsigned long)pages,
+             (long long)(esp_timer_get_time() - started_us));
+}
+
+int history_declare(z_session_t session)
+{
+    z_owned_closure_query_t callback = z_closure(history_query_handler);
+    s_queryable = z_declare_queryable(session, z_keyexpr(HISTORY_KEYEXPR), z_move(callback), NULL);
+    if (!z_check(s_queryable))
+    {
+        ESP_LOGE(TAG, "Unable to declare queryable on '%s'.", HISTORY_KEYEXPR);
+        return -1;
+    }
+    ESP_LOGI(TAG, "Serving the actuation history on '%s'.", HISTORY_KEYEXPR);
+    s_declared = true;
+    return 0;
+}
+
+void history_undeclare(void)
+{
+    if (s_declared)
+    {
+        s_declared = false;
+        z_undeclare_queryable(z_move(s_queryable));
+    }
+}
+#else
+void history_record(signal_id_t id, history_event_t event, bool value)
+{
+    (void)id;
+    (void)event;
+    (void)value;
+}
+
+int history_declare(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+void history_undeclare(void)
+{
+}
+#endif
@@ -0,0 +1,75 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <zenoh-pico.h>
+#include "signal_table.h"
+
+/*
+ * On-device history of actuation events.
+ *
+ * Events are kept in a byte ring of CONFIG_HISTORY_SIZE bytes. Each event is a
+ * header byte followed by the time since the previous event in milliseconds as
+ * a varint, so an event takes two or three bytes and the oldest events are
+ * overwritten once the ring is full:
+ *
+ *   bits 0-2   event kind (history_event_t)
+ *   bit  3     value of the signal
+ *   bits 4-7   signal id, or HISTORY_ID_ESCAPE
+ *
+ * Signal ids from HISTORY_ID_ESCAPE up are stored as a varint between the
+ * header and the delta.
+ *
+ * The ring is served on HISTORY_KEYEXPR. A query selects events by the
+ * parameters "from" and "to" (milliseconds since boot, inclusive), "cursor"
+ * (the first sequence number to return) and "limit" (maximum number of events,
+ * HISTORY_QUERY_MAX_EVENTS by default and at most). The events are streamed in
+ * one or more replies of at most HISTORY_PAGE_EVENTS events each:
+ *
+ *   byte       format version, HISTORY_PAGE_VERSION
+ *   byte       flags, HISTORY_PAGE_MORE if further events match past the limit
+ *   varint     sequence number of the first event, counted since boot
+ *   varint     time of the first event, milliseconds since boot
+ *   varint     time of the reply, milliseconds since boot
+ *   varint     number of events
+ *   events     encoded as in the ring, the first one with a delta of zero
+ *
+ * A client continues a query that hit its limit with "cursor" set to the
+ * sequence number after the last event received.
+ */
+#define HISTORY_PAGE_VERSION                2
+#define HISTORY_ID_ESCAPE                   15
+#define HISTORY_PAGE_MORE                   0x01
+#define HISTORY_PAGE_EVENTS                 128
+#define HISTORY_QUERY_MAX_EVENTS            1024
+
+typedef enum
+{
+    HISTORY_TARGET = 0,   // a target value was received
+    HISTORY_APPLIED = 1,  // the output changed
+    HISTORY_ACKED = 2,    // the current value was published
+    HISTORY_REJECTED = 3, // a command was dropped, e.g. after its deadline
+    HISTORY_FAILSAFE = 4, // the output was turned off at its deadline
+} history_event_t;
+
+// Appends an event with the current time. Safe to call from any task.
+void history_record(signal_id_t id, history_event_t event, bool value);
+
+int history_declare(z_session_t session);
+void history_undeclare(void);
+
+#endif
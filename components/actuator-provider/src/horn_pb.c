@@ -0,0 +1,161 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include "horn_pb.h"
+#include "pb.h"
+#include "uprotocol.h"
+
+size_t horn_status_encode(const horn_status_t *status, uint8_t *buf, size_t size)
+{
+    pb_writer_t writer;
+    pb_writer_init(&writer, buf, size);
+    if (status->is_active)
+    {
+        pb_write_varint(&writer, 1, 1);
+    }
+    if (status->mode != HM_UNSPECIFIED)
+    {
+        pb_write_varint(&writer, 2, status->mode);
+    }
+    if (status->is_fault_active)
+    {
+        pb_write_varint(&writer, 3, 1);
+    }
+    if (status->has_current_sequence)
+    {
+        pb_write_int32(&writer, 4, status->current_sequence);
+    }
+    if (status->has_remaining_cycles)
+    {
+        pb_write_int32(&writer, 5, status->remaining_cycles);
+    }
+    if (status->has_total_sequences)
+    {
+        pb_write_int32(&writer, 6, status->total_sequences);
+    }
+    if (status->priority != 0)
+    {
+        pb_write_int32(&writer, 7, status->priority);
+    }
+    return writer.overflow ? 0 : writer.len;
+}
+
+static int horn_cycle_decode(const uint8_t *buf, size_t len, horn_cycle_t *cycle)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    pb_reader_init(&reader, buf, len);
+    cycle->on_ms = 0;
+    cycle->off_ms = 0;
+    while (pb_read_field(&reader, &field))
+    {
+        // Negative durations are treated as zero.
+        uint32_t value = (int64_t)field.value < 0 ? 0 : (uint32_t)field.value;
+        if (field.number == 1 && field.wire_type == PB_WIRE_VARINT)
+        {
+            cycle->on_ms = value;
+        }
+        else if (field.number == 2 && field.wire_type == PB_WIRE_VARINT)
+        {
+            cycle->off_ms = value;
+        }
+    }
+    return pb_reader_done(&reader) ? HORN_CODE_OK : HORN_CODE_INVALID_ARGUMENT;
+}
+
+static int horn_sequence_decode(const uint8_t *buf, size_t len, horn_sequence_t *sequence)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    pb_reader_init(&reader, buf, len);
+    sequence->cycle_count = 0;
+    while (pb_read_field(&reader, &field))
+    {
+        if (field.number != 1 || field.wire_type != PB_WIRE_LEN)
+        {
+            continue;
+        }
+        if (sequence->cycle_count == HORN_CYCLES_MAX)
+        {
+            return HORN_CODE_RESOURCE_EXHAUSTED;
+        }
+        int ret = horn_cycle_decode(field.data, field.data_len, &sequence->cycles[sequence->cycle_count++]);
+        if (ret != HORN_CODE_OK)
+        {
+            return ret;
+        }
+    }
+    return pb_reader_done(&reader) ? HORN_CODE_OK : HORN_CODE_INVALID_ARGUMENT;
+}
+
+int horn_request_decode(uint8_t payload_format, const uint8_t *buf, size_t len, horn_request_t *request)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    request->mode = HM_UNSPECIFIED;
+    request->sequence_count = 0;
+    if (payload_format == UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY)
+    {
+        if (!pb_any_unpack(buf, len, HORN_ACTIVATE_REQUEST_TYPE, &buf, &len))
+        {
+            return HORN_CODE_INVALID_ARGUMENT;
+        }
+    }
+    else if (payload_format != UP_PAYLOAD_FORMAT_UNSPECIFIED && payload_format != UP_PAYLOAD_FORMAT_PROTOBUF)
+    {
+        return HORN_CODE_INVALID_ARGUMENT;
+    }
+
+    pb_reader_init(&reader, buf, len);
+    while (pb_read_field(&reader, &field))
+    {
+        if (field.number == 1 && field.wire_type == PB_WIRE_VARINT)
+        {
+            request->mode = (horn_mode_t)field.value;
+        }
+        else if (field.number == 2 && field.wire_type == PB_WIRE_LEN)
+        {
+            if (request->sequence_count == HORN_SEQUENCES_MAX)
+            {
+                return HORN_CODE_RESOURCE_EXHAUSTED;
+            }
+            int ret = horn_sequence_decode(field.data, field.data_len,
+                                           &request->sequences[request->sequence_count++]);
+            if (ret != HORN_CODE_OK)
+            {
+                return ret;
+            }
+        }
+    }
+    return pb_reader_done(&reader) ? HORN_CODE_OK : HORN_CODE_INVALID_ARGUMENT;
+}
+
+size_t horn_response_encode(int32_t code, const char *message, uint8_t *buf, size_t size)
+{
+    uint8_t status[HORN_RESPONSE_MAX_LEN];
+    pb_writer_t nested;
+    pb_writer_init(&nested, status, sizeof(status));
+    if (code != HORN_CODE_OK)
+    {
+        pb_write_int32(&nested, 1, code);
+    }
+    if (message != NULL && message[0] != '\0')
+    {
+        pb_write_string(&nested, 2, message);
+    }
+
+    pb_writer_t writer;
+    pb_writer_init(&writer, buf, size);
+    pb_write_bytes(&writer, 1, status, nested.len);
+    return nested.overflow || writer.overflow ? 0 : writer.len;
+}
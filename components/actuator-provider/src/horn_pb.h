@@ -0,0 +1,102 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef HORN_PB_H
+#define HORN_PB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Static encoders and decoders of the messages in
+ * vehicle/body/horn/v1/horn_topics.proto and horn_service.proto.
+ */
+typedef enum
+{
+    HM_UNSPECIFIED = 0,
+    HM_UNKNOWN = 1,
+    HM_SEQUENCED = 2,
+    HM_CONTINUOUS = 3,
+} horn_mode_t;
+
+#define HORN_STATUS_MAX_LEN                 32
+
+typedef struct
+{
+    bool is_active;
+    horn_mode_t mode;
+    bool is_fault_active;
+    bool has_current_sequence;
+    int32_t current_sequence;
+    bool has_remaining_cycles;
+    int32_t remaining_cycles;
+    bool has_total_sequences;
+    int32_t total_sequences;
+    int32_t priority;
+} horn_status_t;
+
+// Serializes a HornStatus message. Returns the length or 0 if the buffer is too small.
+size_t horn_status_encode(const horn_status_t *status, uint8_t *buf, size_t size);
+
+/*
+ * ActivateHornRequest is decoded into fixed-size tables. Requests with more
+ * sequences or cycles than fit are rejected instead of truncated.
+ */
+#define HORN_SEQUENCES_MAX                  8
+#define HORN_CYCLES_MAX                     16
+
+typedef struct
+{
+    uint32_t on_ms;
+    uint32_t off_ms;
+} horn_cycle_t;
+
+typedef struct
+{
+    uint8_t cycle_count;
+    horn_cycle_t cycles[HORN_CYCLES_MAX];
+} horn_sequence_t;
+
+typedef struct
+{
+    horn_mode_t mode;
+    uint8_t sequence_count;
+    horn_sequence_t sequences[HORN_SEQUENCES_MAX];
+} horn_request_t;
+
+// google.rpc.Code values used in responses
+#define HORN_CODE_OK                        0
+#define HORN_CODE_INVALID_ARGUMENT          3
+#define HORN_CODE_RESOURCE_EXHAUSTED        8
+
+#define HORN_RESPONSE_MAX_LEN               64
+
+#define HORN_ACTIVATE_REQUEST_TYPE          "vehicle.body.horn.v1.ActivateHornRequest"
+
+/*
+ * Decodes an ActivateHornRequest in the given UP_PAYLOAD_FORMAT_*. up-rust wraps
+ * protobuf payloads in a google.protobuf.Any, which has to hold an
+ * ActivateHornRequest; unspecified payloads are taken as plain protobuf.
+ * Returns 0 on success or the google.rpc.Code to reply with.
+ */
+int horn_request_decode(uint8_t payload_format, const uint8_t *buf, size_t len, horn_request_t *request);
+
+/*
+ * Serializes an ActivateHornResponse or DeactivateHornResponse, which share
+ * their layout: a google.rpc.Status with the given code and message (may be
+ * NULL). Returns the length or 0 if the buffer is too small.
+ */
+size_t horn_response_encode(int32_t code, const char *message, uint8_t *buf, size_t size);
+
+#endif
@@ -0,0 +1,316 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "deadline.h"
+#include "history.h"
+#include "horn_rpc.h"
+#include "pm_locks.h"
+
+#ifdef CONFIG_HORN_RPC_ENABLED
+#include "uprotocol.h"
+
+static const char *TAG = "HORN_RPC";
+
+static const up_uri_t s_activate_method = {
+    .authority = HORN_SERVICE_AUTHORITY,
+    .ue_id = HORN_SERVICE_ID,
+    .ue_version_major = HORN_SERVICE_VERSION_MAJOR,
+    .resource_id = HORN_ACTIVATE_METHOD_ID,
+};
+
+static const up_uri_t s_deactivate_method = {
+    .authority = HORN_SERVICE_AUTHORITY,
+    .ue_id = HORN_SERVICE_ID,
+    .ue_version_major = HORN_SERVICE_VERSION_MAJOR,
+    .resource_id = HORN_DEACTIVATE_METHOD_ID,
+};
+
+static char s_activate_keyexpr[UP_KEYEXPR_MAX_LEN];
+static char s_deactivate_keyexpr[UP_KEYEXPR_MAX_LEN];
+static z_owned_queryable_t s_activate_queryable;
+static z_owned_queryable_t s_deactivate_queryable;
+static bool s_declared = false;
+
+static horn_rpc_output_t s_output;
+static TaskHandle_t s_player;
+static SemaphoreHandle_t s_pending_lock;
+
+// The latest accepted request, handed from the Zenoh read task to the player.
+// A request with mode HM_UNSPECIFIED turns the horn off.
+static horn_request_t s_pending;
+static int64_t s_pending_received_us;
+static uint64_t s_pending_deadline_ms;
+
+// The request being played, owned by the player task
+static horn_request_t s_active;
+
+// Worst-case time from receiving a request to its first output edge
+static int64_t s_worst_first_edge_us = 0;
+
+static void horn_rpc_submit(const horn_request_t *request, int64_t received_us, uint64_t deadline_ms)
+{
+    xSemaphoreTake(s_pending_lock, portMAX_DELAY);
+    s_pending = *request;
+    s_pending_received_us = received_us;
+    s_pending_deadline_ms = deadline_ms;
+    xSemaphoreGive(s_pending_lock);
+    xTaskNotifyGive(s_player);
+}
+
+static void horn_rpc_edge(bool on, horn_mode_t mode, int64_t *received_us)
+{
+    s_output(on, mode);
+    if (*received_us != 0)
+    {
+        int64_t first_edge_us = esp_timer_get_time() - *received_us;
+        *received_us = 0;
+        if (first_edge_us > s_worst_first_edge_us)
+        {
+            s_worst_first_edge_us = first_edge_us;
+            ESP_LOGI(TAG, "New worst-case request to first edge latency: %lld us", (long long)first_edge_us);
+        }
+    }
+}
+
+// Waits until the absolute deadline. Returns true if a new request arrived first.
+// The wait is rounded up to whole ticks, so an edge is never played early.
+static bool horn_rpc_wait_until(int64_t deadline_us)
+{
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    TickType_t ticks = 0;
+    if (remaining_us > 0)
+    {
+        int64_t remaining_ms = (remaining_us + 999) / 1000;
+        ticks = (TickType_t)((remaining_ms * configTICK_RATE_HZ + 999) / 1000);
+    }
+    return ulTaskNotifyTake(pdTRUE, ticks) > 0;
+}
+
+// Plays a request. Returns true if it was interrupted by a new one.
+static bool horn_rpc_play(const horn_request_t *request, int64_t received_us)
+{
+    if (request->mode == HM_CONTINUOUS)
+    {
+        horn_rpc_edge(true, HM_CONTINUOUS, &received_us);
+        return false;
+    }
+    if (request->mode != HM_SEQUENCED)
+    {
+        horn_rpc_edge(false, HM_UNSPECIFIED, &received_us);
+        return false;
+    }
+
+    // Edges are scheduled against absolute deadlines, so the time spent
+    // reporting them does not add up over a sequence.
+    int64_t deadline_us = esp_timer_get_time();
+    for (int i = 0; i < request->sequence_count; i++)
+    {
+        const horn_sequence_t *sequence = &request->sequences[i];
+        for (int j = 0; j < sequence->cycle_count; j++)
+        {
+            horn_rpc_edge(true, HM_SEQUENCED, &received_us);
+            deadline_us += (int64_t)sequence->cycles[j].on_ms * 1000;
+            if (horn_rpc_wait_until(deadline_us))
+            {
+                return true;
+            }
+            horn_rpc_edge(false, HM_SEQUENCED, &received_us);
+            deadline_us += (int64_t)sequence->cycles[j].off_ms * 1000;
+            if (horn_rpc_wait_until(deadline_us))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void horn_rpc_player_task(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool interrupted;
+        do
+        {
+            xSemaphoreTake(s_pending_lock, portMAX_DELAY);
+            s_active = s_pending;
+            int64_t received_us = s_pending_received_us;
+            uint64_t deadline_ms = s_pending_deadline_ms;
+            xSemaphoreGive(s_pending_lock);
+
+            // Deactivations carry no deadline and are always applied.
+            interrupted = false;
+            if (deadline_expired(deadline_ms))
+            {
+                deadline_record_expired(DEADLINE_HOP_PLAYER, deadline_ms);
+                history_record(SIGNAL_HORN, HISTORY_REJECTED, true);
+            }
+            else
+            {
+                interrupted = horn_rpc_play(&s_active, received_us);
+            }
+        } while (interrupted);
+    }
+}
+
+static void horn_rpc_reply(const z_query_t *query, const up_received_t *request, int32_t code)
+{
+    static uint8_t payload[HORN_RESPONSE_MAX_LEN];
+    static up_attachment_t attachment;
+
+    size_t len = horn_response_encode(code, NULL, payload, sizeof(payload));
+    up_attributes_t attributes = {
+        .id = up_uuid_new(),
+        .type = UP_MESSAGE_TYPE_RESPONSE,
+        .source = &request->sink,
+        .sink = &request->source,
+        .priority = request->priority != 0 ? request->priority : UP_PRIORITY_CS4,
+        .reqid = &request->id,
+        .payload_format = UP_PAYLOAD_FORMAT_PROTOBUF,
+    };
+
+    z_query_reply_options_t options = z_query_reply_options_default();
+    options.attachment = up_attachment(&attachment, &attributes);
+    z_query_reply(query, z_query_keyexpr(query), payload, len, &options);
+}
+
+static void horn_rpc_activate_handler(const z_query_t *query, void *ctx)
+{
+    (void)ctx;
+    static horn_request_t decoded;
+    int64_t received_us = esp_timer_get_time();
+    actuation_pm_command();
+
+    up_received_t request;
+    if (up_attachment_parse(z_query_attachment(query), &request) != 0)
+    {
+        ESP_LOGW(TAG, "Discarding an ActivateHorn request without valid attributes.");
+        return;
+    }
+
+    // The caller stops waiting at the deadline, so an expired request gets no reply.
+    uint64_t deadline_ms = request.ttl_ms != 0 ? up_uuid_time_ms(&request.id) + request.ttl_ms : DEADLINE_NONE;
+    if (deadline_expired(deadline_ms))
+    {
+        deadline_record_expired(DEADLINE_HOP_RPC, deadline_ms);
+        history_record(SIGNAL_HORN, HISTORY_REJECTED, true);
+        return;
+    }
+
+    z_value_t value = z_query_value(query);
+    int code = horn_request_decode(request.payload_format, value.payload.start, value.payload.len, &decoded);
+    if (code == HORN_CODE_OK && decoded.mode != HM_SEQUENCED && decoded.mode != HM_CONTINUOUS)
+    {
+        code = HORN_CODE_INVALID_ARGUMENT;
+    }
+    if (code == HORN_CODE_OK)
+    {
+        horn_rpc_submit(&decoded, received_us, deadline_ms);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Rejecting an ActivateHorn request with code %d.", code);
+        history_record(SIGNAL_HORN, HISTORY_REJECTED, true);
+    }
+    horn_rpc_reply(query, &request, code);
+}
+
+static void horn_rpc_deactivate_handler(const z_query_t *query, void *ctx)
+{
+    (void)ctx;
+    static const horn_request_t off = {.mode = HM_UNSPECIFIED};
+    int64_t received_us = esp_timer_get_time();
+    actuation_pm_command();
+
+    up_received_t request;
+    if (up_attachment_parse(z_query_attachment(query), &request) != 0)
+    {
+        ESP_LOGW(TAG, "Discarding a DeactivateHorn request without valid attributes.");
+        return;
+    }
+    horn_rpc_submit(&off, received_us, DEADLINE_NONE);
+    horn_rpc_reply(query, &request, HORN_CODE_OK);
+}
+
+void horn_rpc_start(horn_rpc_output_t output)
+{
+    s_output = output;
+    s_pending_lock = xSemaphoreCreateMutex();
+    xTaskCreate(horn_rpc_player_task, "horn_player", 3072, NULL, configMAX_PRIORITIES - 2, &s_player);
+}
+
+int horn_rpc_declare(z_session_t session)
+{
+    if (up_request_keyexpr(s_activate_keyexpr, sizeof(s_activate_keyexpr), &s_activate_method) != 0 ||
+        up_request_keyexpr(s_deactivate_keyexpr, sizeof(s_deactivate_keyexpr), &s_deactivate_method) != 0)
+    {
+        ESP_LOGE(TAG, "The Horn methods do not fit the key expression buffer.");
+        return -1;
+    }
+
+    z_owned_closure_query_t activate_callback = z_closure(horn_rpc_activate_handler);
+    s_activate_queryable = z_declare_queryable(session, z_keyexpr(s_activate_keyexpr), z_move(activate_callback), NULL);
+    if (!z_check(s_activate_queryable))
+    {
+        ESP_LOGE(TAG, "Unable to declare queryable on '%s'.", s_activate_keyexpr);
+        return -1;
+    }
+
+    z_owned_closure_query_t deactivate_callback = z_closure(horn_rpc_deactivate_handler);
+    s_deactivate_queryable = z_declare_queryable(session, z_keyexpr(s_deactivate_keyexpr), z_move(deactivate_callback), NULL);
+    if (!z_check(s_deactivate_queryable))
+    {
+        ESP_LOGE(TAG, "Unable to declare queryable on '%s'.", s_deactivate_keyexpr);
+        z_undeclare_queryable(z_move(s_activate_queryable));
+        return -1;
+    }
+    ESP_LOGI(TAG, "Serving the Horn methods on '%s' and '%s'.", s_activate_keyexpr, s_deactivate_keyexpr);
+    s_declared = true;
+    return 0;
+}
+
+void horn_rpc_undeclare(void)
+{
+    if (s_declared)
+    {
+        s_declared = false;
+        z_undeclare_queryable(z_move(s_deactivate_queryable));
+        z_undeclare_queryable(z_move(s_activate_queryable));
+    }
+}
+#else
+void horn_rpc_start(horn_rpc_output_t output)
+{
+    (void)output;
+}
+
+int horn_rpc_declare(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+void horn_rpc_undeclare(void)
+{
+}
+#endif
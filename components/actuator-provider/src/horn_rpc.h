@@ -0,0 +1,39 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef HORN_RPC_H
+#define HORN_RPC_H
+
+#include <stdbool.h>
+#include <zenoh-pico.h>
+#include "horn_pb.h"
+
+/*
+ * On-device Horn RPC endpoint.
+ *
+ * Serves the ActivateHorn (1) and DeactivateHorn (2) methods of the Horn
+ * service (horn_service.proto) directly, so a request reaches the output in a
+ * single hop instead of passing horn-service-kuksa and the databroker.
+ * Requests are decoded into static tables and handed to a player task, which
+ * runs sequences on the device. A new request interrupts the one being played.
+ * The reply is sent as soon as the request was accepted, the output callback
+ * reports every edge, e.g. to mirror the state to the databroker.
+ */
+typedef void (*horn_rpc_output_t)(bool on, horn_mode_t mode);
+
+// Starts the player task. Must be called once before the first declaration.
+void horn_rpc_start(horn_rpc_output_t output);
+int horn_rpc_declare(z_session_t session);
+void horn_rpc_undeclare(void);
+
+#endif
@@ -0,0 +1,134 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "horn_status.h"
+
+#ifdef CONFIG_HORN_STATUS_ENABLED
+#include "uprotocol.h"
+
+static const char *TAG = "HORN_STATUS";
+
+static const up_uri_t s_topic = {
+    .authority = HORN_SERVICE_AUTHORITY,
+    .ue_id = HORN_SERVICE_ID,
+    .ue_version_major = HORN_SERVICE_VERSION_MAJOR,
+    .resource_id = HORN_STATUS_RESOURCE_ID,
+};
+
+static char s_keyexpr[UP_KEYEXPR_MAX_LEN];
+static z_owned_publisher_t s_status_pub;
+static bool s_declared = false;
+// The latest status, published again on every declaration
+static horn_status_t s_status = {.mode = HM_UNSPECIFIED};
+static portMUX_TYPE s_status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Worst-case time from the output change to the status being handed to Zenoh
+static int64_t s_worst_publish_us = 0;
+
+// The read, player and supervision tasks publish, so the buffers live on the
+// caller's stack (about 250 bytes).
+static void horn_status_put(const horn_status_t *status)
+{
+    uint8_t payload[HORN_STATUS_MAX_LEN];
+    up_attachment_t attachment;
+
+    size_t len = horn_status_encode(status, payload, sizeof(payload));
+    up_attributes_t attributes = {
+        .id = up_uuid_new(),
+        .type = UP_MESSAGE_TYPE_PUBLISH,
+        .source = &s_topic,
+        .priority = UP_PRIORITY_CS1,
+        .payload_format = UP_PAYLOAD_FORMAT_PROTOBUF,
+    };
+
+    z_publisher_put_options_t options = z_publisher_put_options_default();
+    options.attachment = up_attachment(&attachment, &attributes);
+    z_publisher_put(z_loan(s_status_pub), payload, len, &options);
+}
+
+int horn_status_declare(z_session_t session)
+{
+    if (up_keyexpr(s_keyexpr, sizeof(s_keyexpr), &s_topic, NULL) != 0)
+    {
+        ESP_LOGE(TAG, "The HornStatus topic does not fit the key expression buffer.");
+        return -1;
+    }
+
+    s_status_pub = z_declare_publisher(session, z_keyexpr(s_keyexpr), NULL);
+    if (!z_check(s_status_pub))
+    {
+        ESP_LOGE(TAG, "Unable to declare publisher for '%s'.", s_keyexpr);
+        return -1;
+    }
+    ESP_LOGI(TAG, "Publishing HornStatus on '%s'.", s_keyexpr);
+    s_declared = true;
+
+    portENTER_CRITICAL(&s_status_lock);
+    horn_status_t status = s_status;
+    portEXIT_CRITICAL(&s_status_lock);
+    horn_status_put(&status);
+    return 0;
+}
+
+void horn_status_undeclare(void)
+{
+    if (s_declared)
+    {
+        s_declared = false;
+        z_undeclare_publisher(z_move(s_status_pub));
+    }
+}
+
+void horn_status_publish(bool is_active, horn_mode_t mode)
+{
+    int64_t changed_us = esp_timer_get_time();
+    horn_status_t status = {.is_active = is_active, .mode = is_active ? mode : HM_UNSPECIFIED};
+    portENTER_CRITICAL(&s_status_lock);
+    s_status = status;
+    portEXIT_CRITICAL(&s_status_lock);
+    if (!s_declared)
+    {
+        return;
+    }
+
+    horn_status_put(&status);
+    int64_t publish_us = esp_timer_get_time() - changed_us;
+    if (publish_us > s_worst_publish_us)
+    {
+        s_worst_publish_us = publish_us;
+        ESP_LOGI(TAG, "New worst-case HornStatus publication latency: %lld us", (long long)publish_us);
+    }
+}
+#else
+int horn_status_declare(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+void horn_status_undeclare(void)
+{
+}
+
+void horn_status_publish(bool is_active, horn_mode_t mode)
+{
+    (void)is_active;
+    (void)mode;
+}
+#endif
@@ -0,0 +1,34 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef HORN_STATUS_H
+#define HORN_STATUS_H
+
+#include <stdbool.h>
+#include <zenoh-pico.h>
+#include "horn_pb.h"
+
+/*
+ * Native HornStatus publication.
+ *
+ * The provider encodes HornStatus (horn_topics.proto) itself and publishes it
+ * on the uProtocol topic of the horn service (resource 0x8000) right after the
+ * output changed, so uProtocol consumers do not wait for the state to travel
+ * through the databroker and horn-service-kuksa. Encoding uses static buffers
+ * only. The latest status is published again when a session is declared.
+ */
+int horn_status_declare(z_session_t session);
+void horn_status_undeclare(void);
+void horn_status_publish(bool is_active, horn_mode_t mode);
+
+#endif
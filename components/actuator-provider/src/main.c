@@ -12,11 +12,15 @@
  ********************************************************************************/
 
 #include <esp_event.h>
+#include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <esp_random.h>
 #include <esp_system.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <nvs_flash.h>
 #include <stdio.h>
@@ -25,8 +29,18 @@
 #include <unistd.h>
 #include <zenoh-pico.h>
 #include "config.h"
+#include "consumers.h"
+#include "deadline.h"
+#include "history.h"
 #include "driver/gpio.h"
-#include <regex.h>
+#include "horn_rpc.h"
+#include "horn_status.h"
+#include "ota.h"
+#include "pm_locks.h"
+#include "routers.h"
+#include "signal_table.h"
+#include "soak.h"
+#include "timer_wheel.h"
 
 #if Z_FEATURE_PUBLICATION == 1
 static bool s_is_wifi_connected = false;
@@ -35,31 +49,64 @@ static int s_retry_count = 0;
 
 static const char *TAG = "MAIN";
 
+static z_owned_session_t s_session;
 static z_owned_publisher_t pub;
+static z_owned_subscriber_t s_sub;
+#if Z_FEATURE_QUERYABLE == 1
+static z_owned_queryable_t s_queryable;
+#endif
+
+// Publishing on the session is only allowed while it is up. The read, player
+// and supervision tasks publish while holding the lock, so the supervision
+// loop can take the session down without a publication in flight.
+static SemaphoreHandle_t s_session_lock;
+static bool s_session_up = false;
 
+// z_attachment_iterate() stops at the first non-zero result, so 0 continues
+// the iteration and is what a sample without a "type" entry yields.
 typedef enum
 {
+    SIGNAL_TYPE_NONE,
     SIGNAL_TYPE_CURRENT_VALUE,
     SIGNAL_TYPE_TARGET_VALUE,
     SIGNAL_TYPE_UNKNOWN
 } signal_type_t;
 
+/*
+ * Everything compared on the actuation path lives in DRAM, so classifying a
+ * sample does not touch flash when the path is placed in IRAM.
+ */
+static const char ACTUATION_DATA_ATTR s_key_type[] = "type";
+static const char ACTUATION_DATA_ATTR s_key_deadline[] = "deadline";
+static const char ACTUATION_DATA_ATTR s_type_current_value[] = "currentValue";
+static const char ACTUATION_DATA_ATTR s_type_target_value[] = "targetValue";
+static const char ACTUATION_DATA_ATTR s_value_true[] = "true";
+static const char ACTUATION_DATA_ATTR s_value_false[] = "false";
+
+// Worst-case time from receiving a targetValue to applying it to the output
+static int64_t s_worst_actuation_us = 0;
+
+static ACTUATION_ATTR bool bytes_equal(z_bytes_t bytes, const char *str, size_t len)
+{
+    return bytes.len == len && memcmp(bytes.start, str, len) == 0;
+}
+
 #if Z_FEATURE_ATTACHMENT == 1
 
-signal_type_t attachment_handler(z_bytes_t key, z_bytes_t value, void *ctx)
+// Classifies a sample by its "type" entry as a signal_type_t, other entries such as "deadline" are skipped.
+ACTUATION_ATTR int8_t attachment_handler(z_bytes_t key, z_bytes_t value, void *ctx)
 {
     (void)ctx;
 
-    char type[50] = "";
-    size_t type_len = value.len;
-    strncpy(type, (const char *)value.start, type_len);
-    type[type_len] = '\0';
-
-    if (strcmp(type, "currentValue") == 0)
+    if (!bytes_equal(key, s_key_type, sizeof(s_key_type) - 1))
+    {
+        return SIGNAL_TYPE_NONE;
+    }
+    if (bytes_equal(value, s_type_current_value, sizeof(s_type_current_value) - 1))
     {
         return SIGNAL_TYPE_CURRENT_VALUE;
     }
-    else if (strcmp(type, "targetValue") == 0)
+    else if (bytes_equal(value, s_type_target_value, sizeof(s_type_target_value) - 1))
     {
         return SIGNAL_TYPE_TARGET_VALUE;
     }
@@ -68,22 +115,15 @@ signal_type_t attachment_handler(z_bytes_t key, z_bytes_t value, void *ctx)
         return SIGNAL_TYPE_UNKNOWN;
     }
 }
-#endif
 
-int is_valid_tcp_url(char *url)
+// The "deadline" entry of a targetValue, in milliseconds since the Unix epoch
+static ACTUATION_ATTR uint64_t sample_deadline(const z_sample_t *sample)
 {
-    char pattern[] = "^tcp/.*:[0-9]+$";
-    int result;
-    regex_t reg;
-
-    if (regcomp(&reg, pattern, REG_EXTENDED | REG_NOSUB) != 0)
-        return -1;
-
-    result = regexec(&reg, url, 0, 0, 0);
-    regfree(&reg);
-
-    return result;
+    z_bytes_t value = z_attachment_get(sample->attachment,
+                                       _z_bytes_wrap((const uint8_t *)s_key_deadline, sizeof(s_key_deadline) - 1));
+    return deadline_parse(value.start, value.len);
 }
+#endif
 
 void gpio_init()
 {
@@ -91,56 +131,147 @@ void gpio_init()
     gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
 }
 
-void turn_led(bool on)
+/*
+ * Who switched the horn on: the databroker through a targetValue, or an
+ * on-device RPC request. Only the databroker sends heartbeats, so only its
+ * output has a lease. An RPC request holds the output until its sequence ends
+ * or DeactivateHorn arrives.
+ */
+typedef enum
+{
+    OUTPUT_OWNER_NONE,
+    OUTPUT_OWNER_DATABROKER,
+    OUTPUT_OWNER_RPC
+} output_owner_t;
+
+static output_owner_t s_output_owner = OUTPUT_OWNER_NONE;
+
+static ACTUATION_ATTR output_owner_t output_owner(void)
+{
+    return __atomic_load_n(&s_output_owner, __ATOMIC_RELAXED);
+}
+
+// Hands the output to 'owner' and starts, renews or ends the lease of the horn
+// accordingly: while the databroker owns the output, it is turned off unless
+// the next targetValue "true" arrives within HORN_LEASE_MS.
+static void horn_lease(output_owner_t owner)
 {
-    if (on)
-    {
-        gpio_set_level(LED_GPIO, 1);
-    }
-    else if (!on)
-    {
-        gpio_set_level(LED_GPIO, 0);
-    }
+    __atomic_store_n(&s_output_owner, owner, __ATOMIC_RELAXED);
+#ifdef CONFIG_HORN_LEASE_ENABLED
+    signal_set_deadline(SIGNAL_HORN, owner == OUTPUT_OWNER_DATABROKER
+                                         ? esp_timer_get_time() + (int64_t)HORN_LEASE_MS * 1000
+                                         : SIGNAL_NO_DEADLINE);
+#endif
 }
 
-void pub_status(char *value_str)
+ACTUATION_ATTR void turn_led(bool on)
 {
-    char buf[32];
-    sprintf(buf, "%s", value_str);
+    actuation_pm_output(on);
+    signal_set_current(SIGNAL_HORN, on);
+    signal_drive(SIGNAL_HORN, on);
+}
 
+// Reports the state of the horn as currentValue. If that fails, the change
+// stays pending and is reported again by the next sweep. While no consumer is
+// present the change counts as reported, consumers_appeared() catches up.
+ACTUATION_ATTR void pub_status(bool on)
+{
+    const char *value = on ? s_value_true : s_value_false;
+    if (!consumers_present())
+    {
+        consumers_skipped(strlen(value) + sizeof(s_key_type) - 1 + sizeof(s_type_current_value) - 1);
+        signal_acked(SIGNAL_HORN, on);
+        return;
+    }
     z_publisher_put_options_t options = z_publisher_put_options_default();
     z_owned_bytes_map_t map = z_bytes_map_new();
-    z_bytes_map_insert_by_alias(&map, _z_bytes_wrap((uint8_t *)"type", 4), _z_bytes_wrap((uint8_t *)"currentValue", 12));
+    z_bytes_map_insert_by_alias(&map, _z_bytes_wrap((const uint8_t *)s_key_type, sizeof(s_key_type) - 1),
+                                _z_bytes_wrap((const uint8_t *)s_type_current_value, sizeof(s_type_current_value) - 1));
     options.attachment = z_bytes_map_as_attachment(&map);
 
-    z_publisher_put(z_loan(pub), (const uint8_t *)buf, strlen(buf), &options);
+    if (z_publisher_put(z_loan(pub), (const uint8_t *)value, strlen(value), &options) == 0)
+    {
+        signal_acked(SIGNAL_HORN, on);
+    }
+    z_bytes_map_drop(z_move(map));
+}
+
+// Mode reported for a state the databroker or a sweep set, i.e. without a known
+// RPC request: HM_UNKNOWN while on, HM_UNSPECIFIED while off.
+static horn_mode_t state_mode(bool on)
+{
+    return on ? HM_UNKNOWN : HM_UNSPECIFIED;
 }
 
-char *payload_to_string(const z_bytes_t *payload)
+// Reports the state of the horn as HornStatus and currentValue while the
+// session is up. A change that could not be reported stays pending for the
+// next sweep.
+static void publish_state(bool on, horn_mode_t mode)
 {
-    char *string = (char *)malloc(payload->len + 1);
-    if (string == NULL)
+    xSemaphoreTake(s_session_lock, portMAX_DELAY);
+    if (s_session_up)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        horn_status_publish(on, mode);
+        pub_status(on);
     }
+    xSemaphoreGive(s_session_lock);
+}
 
-    for (size_t i = 0; i < payload->len; i++)
+static void session_set_up(bool up)
+{
+    xSemaphoreTake(s_session_lock, portMAX_DELAY);
+    s_session_up = up;
+    xSemaphoreGive(s_session_lock);
+}
+
+// Publishes the latest state to a consumer that just announced itself. Runs in
+// the Zenoh read task.
+static void consumers_appeared(void)
+{
+    xSemaphoreTake(s_session_lock, portMAX_DELAY);
+    if (s_session_up)
     {
-        string[i] = payload->start[i];
+        pub_status(signal_current(SIGNAL_HORN));
     }
+    xSemaphoreGive(s_session_lock);
+}
+
+// Applies the edges of sequences played for on-device RPC requests. The RPC
+// request takes the output over before it changes, so a lease left from the
+// databroker cannot cut it off. The state is mirrored to the databroker after
+// the output changed, the RPC reply does not wait for it.
+static void rpc_output(bool on, horn_mode_t mode)
+{
+    horn_lease(on ? OUTPUT_OWNER_RPC : OUTPUT_OWNER_NONE);
+    turn_led(on);
+    publish_state(on, mode);
+}
+
+#if Z_FEATURE_QUERYABLE == 1
+// Answers queries on KEYEXPR with the latest currentValue, so consumers that
+// start after the last change do not have to wait for the next one.
+void query_handler(const z_query_t *query, void *ctx)
+{
+    (void)ctx;
 
-    string[payload->len] = '\0';
+    z_query_reply_options_t options = z_query_reply_options_default();
+    z_owned_bytes_map_t map = z_bytes_map_new();
+    z_bytes_map_insert_by_alias(&map, _z_bytes_wrap((const uint8_t *)s_key_type, sizeof(s_key_type) - 1),
+                                _z_bytes_wrap((const uint8_t *)s_type_current_value, sizeof(s_type_current_value) - 1));
+    options.attachment = z_bytes_map_as_attachment(&map);
 
-    return string;
+    const char *value = signal_current(SIGNAL_HORN) ? s_value_true : s_value_false;
+    z_query_reply(query, z_keyexpr(KEYEXPR), (const uint8_t *)value, strlen(value), &options);
+    z_bytes_map_drop(z_move(map));
 }
+#endif
 
-void sample_handler(const z_sample_t *sample, void *arg)
+ACTUATION_ATTR void sample_handler(const z_sample_t *sample, void *arg)
 {
-    z_owned_str_t keystr = z_keyexpr_to_string(sample->keyexpr);
-    ESP_LOGI(TAG, ">> [Subscriber handler] Received ('%s': '%.*s')\n",
-             z_str_loan(&keystr), (int)sample->payload.len,
-             sample->payload.start);
+    (void)arg;
+
+    int64_t received_us = esp_timer_get_time();
+    actuation_pm_command();
 
 #if Z_FEATURE_ATTACHMENT == 1
     if (z_attachment_check(&sample->attachment))
@@ -154,31 +285,49 @@ void sample_handler(const z_sample_t *sample, void *arg)
         }
         else if (type_result == SIGNAL_TYPE_TARGET_VALUE)
         {
-            ESP_LOGI(TAG, "[Subscriber handler] Recieved targetValue\n");
-
-            char *value_str = payload_to_string(&sample->payload);
-
-            if (strcmp(value_str, "true") == 0)
+            // Logging is slow compared to the actuation, so it follows the output change.
+            bool on = bytes_equal(sample->payload, s_value_true, sizeof(s_value_true) - 1);
+            uint64_t deadline_ms = on ? sample_deadline(sample) : DEADLINE_NONE;
+            if (deadline_expired(deadline_ms))
             {
-                ESP_LOGI(TAG, "[Subscriber handler] Activating the horn.\n");
-                turn_led(true);
-
-                pub_status(value_str);
-                free(value_str);
+                // Only switching on is dropped, a late "false" still turns the horn off.
+                deadline_record_expired(DEADLINE_HOP_SUBSCRIBER, deadline_ms);
+                history_record(SIGNAL_HORN, HISTORY_REJECTED, on);
+            }
+            else if (on && signal_current(SIGNAL_HORN))
+            {
+                // A repeated "true" is a heartbeat of the horn service and only renews the lease.
+                // While an RPC request holds the output there is no lease to renew.
+                signal_set_target(SIGNAL_HORN, on);
+                if (output_owner() != OUTPUT_OWNER_RPC)
+                {
+                    horn_lease(OUTPUT_OWNER_DATABROKER);
+                }
             }
-            else if (strcmp(value_str, "false") == 0)
+            else if (on || bytes_equal(sample->payload, s_value_false, sizeof(s_value_false) - 1))
             {
-                ESP_LOGI(TAG, "[Subscriber handler] Turning off the horn.\n");
-                turn_led(false);
-                pub_status(value_str);
-                free(value_str);
+                signal_set_target(SIGNAL_HORN, on);
+                turn_led(on);
+                int64_t actuation_us = esp_timer_get_time() - received_us;
+                // The lease is scheduled on the timer wheel in flash, after the output changed.
+                horn_lease(on ? OUTPUT_OWNER_DATABROKER : OUTPUT_OWNER_NONE);
+                publish_state(on, state_mode(on));
+
+                ESP_LOGI(TAG, "[Subscriber handler] Recieved targetValue\n");
+                ESP_LOGI(TAG, "[Subscriber handler] %s\n", on ? "Activating the horn." : "Turning off the horn.");
+                if (actuation_us > s_worst_actuation_us)
+                {
+                    s_worst_actuation_us = actuation_us;
+                    ESP_LOGI(TAG, "[Subscriber handler] New worst-case actuation latency: %lld us\n",
+                             (long long)actuation_us);
+                }
             }
             else
             {
                 ESP_LOGI(TAG, "[Subscriber handler] Received a faulty payload value.");
             }
         }
-        else if (type_result == SIGNAL_TYPE_UNKNOWN)
+        else
         {
             ESP_LOGI(TAG, "[Subscriber handler] Received an unknown signal type. Discarding the signal.\n");
         };
@@ -187,12 +336,20 @@ void sample_handler(const z_sample_t *sample, void *arg)
     ESP_LOGI(TAG, "The attachment feature is not enabled but is required for the full functionality.")
 #endif
 
+    z_owned_str_t keystr = z_keyexpr_to_string(sample->keyexpr);
+    ESP_LOGI(TAG, ">> [Subscriber handler] Received ('%s': '%.*s')\n",
+             z_str_loan(&keystr), (int)sample->payload.len,
+             sample->payload.start);
     z_str_drop(z_str_move(&keystr));
+    soak_record_latency(esp_timer_get_time() - received_us);
 }
 
 static void event_handler(void *arg, esp_event_base_t event_base,
                           int32_t event_id, void *event_data)
 {
+    (void)arg;
+    (void)event_data;
+
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
     {
         esp_wifi_connect();
@@ -257,95 +414,434 @@ void wifi_init_sta(void)
     vEventGroupDelete(s_event_group_handler);
 }
 
-void app_main()
+// Opens a Zenoh session with the router at 'locator' and starts its read and
+// lease tasks. Returns 0 on success.
+static int session_start(const char *locator, z_owned_session_t *session)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
-        ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-    {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-
-    // Set WiFi in STA mode and trigger attachment
-    ESP_LOGI(TAG, "Connecting to WiFi...");
-    wifi_init_sta();
-    while (!s_is_wifi_connected)
-    {
-        printf(".");
-        sleep(1);
-    }
-    ESP_LOGI(TAG, "Establishing the Wifi connection was successful!\n");
-
-    // Initialize GPIO pin with led
-    gpio_init();
-
-    // Initialize Zenoh Session and other parameters
     z_owned_config_t config = z_config_default();
     zp_config_insert(z_loan(config), Z_CONFIG_MODE_KEY, z_string_make(MODE));
-
-    if (strcmp(CONNECT, "") == 0)
+    if (strcmp(locator, "") != 0)
     {
-        ESP_LOGI(TAG, "CONNECT string is empty. Using scouting to find peers in the network.\n");
-    }
-    else
-    {
-        if (is_valid_tcp_url(CONNECT))
-        {
-            zp_config_insert(z_loan(config), Z_CONFIG_CONNECT_KEY,
-                             z_string_make(CONNECT));
-        }
+        zp_config_insert(z_loan(config), Z_CONFIG_CONNECT_KEY, z_string_make(locator));
     }
 
     // Open Zenoh session
-    ESP_LOGI(TAG, "Opening Zenoh session at %s\n", CONNECT);
-    z_owned_session_t s = z_open(z_move(config));
-    if (!z_check(s))
+    ESP_LOGI(TAG, "Opening Zenoh session at %s\n", locator);
+    *session = z_open(z_move(config));
+    if (!z_check(*session))
     {
         ESP_LOGE(TAG, "Unable to open session!\n");
-        exit(-1);
+        return -1;
     }
     ESP_LOGI(TAG, "Opening Zenoh session was succesful!\n");
 
     // Start the receive and the session lease loop for zenoh-pico
-    zp_start_read_task(z_loan(s), NULL);
-    zp_start_lease_task(z_loan(s), NULL);
+    zp_start_read_task(z_loan(*session), NULL);
+    zp_start_lease_task(z_loan(*session), NULL);
+    return 0;
+}
 
+static void session_stop(z_owned_session_t *session)
+{
+    // Stop the receive and the session lease loop for zenoh-pico
+    zp_stop_read_task(z_loan(*session));
+    zp_stop_lease_task(z_loan(*session));
+    z_close(session);
+}
+
+// Declares all publishers and subscribers on the open session. Returns 0 on
+// success. On failure everything declared so far is released again, the
+// session is closed and -1 is returned, so the caller can simply retry.
+static int session_declare(void)
+{
     ESP_LOGI(TAG, "Declaring publisher for '%s'...", KEYEXPR);
-    pub = z_declare_publisher(z_loan(s), z_keyexpr(KEYEXPR), NULL);
+    pub = z_declare_publisher(z_loan(s_session), z_keyexpr(KEYEXPR), NULL);
     if (!z_check(pub))
     {
         ESP_LOGE(TAG, "Unable to declare publisher for key expression!\n");
-        exit(-1);
+        goto close_session;
     }
     ESP_LOGI(TAG, "Successfully declared publisher for '%s'\n", KEYEXPR);
 
     ESP_LOGI(TAG, "Declaring subscriber on '%s'...", KEYEXPR);
     z_owned_closure_sample_t callback = z_closure(sample_handler);
-    z_owned_subscriber_t sub = z_declare_subscriber(
-        z_loan(s), z_keyexpr(KEYEXPR), z_move(callback), NULL);
-    if (!z_check(sub))
+    s_sub = z_declare_subscriber(
+        z_loan(s_session), z_keyexpr(KEYEXPR), z_move(callback), NULL);
+    if (!z_check(s_sub))
     {
         ESP_LOGE(TAG, "Unable to declare subscriber.\n");
-        exit(-1);
+        goto undeclare_publisher;
     }
     ESP_LOGI(TAG, "Succesfully declared subscriber on '%s'\n", KEYEXPR);
 
+#if Z_FEATURE_QUERYABLE == 1
+    z_owned_closure_query_t query_callback = z_closure(query_handler);
+    s_queryable = z_declare_queryable(z_loan(s_session), z_keyexpr(KEYEXPR), z_move(query_callback), NULL);
+    if (!z_check(s_queryable))
+    {
+        ESP_LOGE(TAG, "Unable to declare queryable on '%s'.\n", KEYEXPR);
+        goto undeclare_subscriber;
+    }
+#endif
+
+    if (ota_declare(z_loan(s_session)) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to declare the delta update endpoint.\n");
+        goto undeclare_queryable;
+    }
+
+    if (horn_status_declare(z_loan(s_session)) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to declare the HornStatus publisher.\n");
+        goto undeclare_ota;
+    }
+
+    if (horn_rpc_declare(z_loan(s_session)) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to declare the Horn RPC endpoint.\n");
+        goto undeclare_horn_status;
+    }
+
+    if (history_declare(z_loan(s_session)) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to declare the actuation history queryable.\n");
+        goto undeclare_horn_rpc;
+    }
+
+    if (consumers_declare(z_loan(s_session)) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to declare the consumer presence subscriber.\n");
+        goto undeclare_history;
+    }
+
+    // Subscribers reached through a new session may have missed the last
+    // change, so the latest state is published once right away.
+    session_set_up(true);
+    bool on = signal_current(SIGNAL_HORN);
+    publish_state(on, state_mode(on));
+    actuation_pm_session(true);
+    return 0;
+
+undeclare_history:
+    history_undeclare();
+undeclare_horn_rpc:
+    horn_rpc_undeclare();
+undeclare_horn_status:
+    horn_status_undeclare();
+undeclare_ota:
+    ota_undeclare();
+undeclare_queryable:
+#if Z_FEATURE_QUERYABLE == 1
+    z_undeclare_queryable(z_move(s_queryable));
+undeclare_subscriber:
+#endif
+    z_undeclare_subscriber(z_move(s_sub));
+undeclare_publisher:
+    z_undeclare_publisher(z_move(pub));
+close_session:
+    session_stop(&s_session);
+    return -1;
+}
+
+// Opens the Zenoh session and declares all publishers and subscribers on it.
+// Returns 0 on success and -1 with nothing left open on failure.
+static int session_open(const char *locator)
+{
+    if (session_start(locator, &s_session) != 0)
+    {
+        return -1;
+    }
+    return session_declare();
+}
+
+// Releases all declarations, the session itself stays open.
+static void session_undeclare(void)
+{
+    actuation_pm_session(false);
+    consumers_undeclare();
+    history_undeclare();
+    horn_rpc_undeclare();
+    horn_status_undeclare();
+    ota_undeclare();
+#if Z_FEATURE_QUERYABLE == 1
+    z_undeclare_queryable(z_move(s_queryable));
+#endif
+    z_undeclare_subscriber(z_move(s_sub));
+    z_undeclare_publisher(z_move(pub));
+}
+
+// Takes the session down. Publishing stops first and the read task next, so
+// neither another task nor a callback uses a declaration while it is released.
+static void session_close(void)
+{
+    ESP_LOGI(TAG, "Closing Zenoh session...\n");
+    session_set_up(false);
+    zp_stop_read_task(z_loan(s_session));
+    session_undeclare();
+    zp_stop_lease_task(z_loan(s_session));
+    z_close(z_move(s_session));
+    ESP_LOGI(TAG, "Successfully closed the Zenoh session.\n");
+}
+
+// A keep-alive can only be sent while the transport to the router is open,
+// so a failing send means the session dropped.
+static bool session_is_alive(void)
+{
+    return zp_send_keep_alive(z_loan(s_session), NULL) == 0;
+}
+
+// Opens a session with the first router in probe order that accepts it.
+// Returns the index of that router or -1 if none did.
+static int connect_first_available(router_t *routers, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (routers[i].rtt_us != ROUTER_UNREACHABLE && session_open(routers[i].locator) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Opens a session and retries in place with exponential backoff until it
+ * succeeds. WiFi stays associated, only the Zenoh session and its declarations
+ * are rebuilt. Returns the index of the router in use, or -1 without routers.
+ */
+static int session_connect(router_t *routers, int count)
+{
+    uint32_t backoff_ms = SESSION_RETRY_MIN_MS;
+
     while (1)
     {
+        int current = -1;
+        if (count == 0)
+        {
+            // Scouting, or a peer mode locator which is passed on unchanged
+            if (session_open(CONNECT) == 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            routers_probe(routers, count, ROUTER_PROBE_TIMEOUT_MS);
+            current = connect_first_available(routers, count);
+            if (current >= 0)
+            {
+                return current;
+            }
+        }
+
+        // Half of the delay is randomized so a fleet does not reconnect in lockstep.
+        uint32_t delay_ms = backoff_ms / 2 + esp_random() % (backoff_ms / 2 + 1);
+        ESP_LOGW(TAG, "Unable to establish the session, retrying in %lu ms.", (unsigned long)delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        backoff_ms = backoff_ms * 2 > SESSION_RETRY_MAX_MS ? SESSION_RETRY_MAX_MS : backoff_ms * 2;
+    }
+}
+
+// Turns a signal off that stayed on past its deadline. Runs in the timer wheel task,
+// so the acknowledgement is left to the next sweep of the supervision loop. The
+// horn is only cut off while the databroker still owns it, an RPC request that
+// took it over meanwhile keeps it.
+static void failsafe_off(signal_id_t id)
+{
+    output_owner_t owner = OUTPUT_OWNER_DATABROKER;
+    if (id == SIGNAL_HORN && __atomic_compare_exchange_n(&s_output_owner, &owner, OUTPUT_OWNER_NONE, false,
+                                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        ESP_LOGW(TAG, "The horn stayed on past its deadline, turning it off.");
+        history_record(id, HISTORY_FAILSAFE, false);
+        turn_led(false);
+    }
+}
+
+// Reports a change whose acknowledgement was not published yet.
+static void sweep_pending_ack(signal_id_t id)
+{
+    if (id == SIGNAL_HORN)
+    {
+        bool on = signal_current(SIGNAL_HORN);
+        publish_state(on, state_mode(on));
+    }
+}
+
+/*
+ * Periodic pass over the signal table: turns off signals whose deadline the
+ * timer wheel could not enforce and reports changes whose acknowledgement was
+ * not published.
+ */
+static void sweep_signals(int64_t now_us)
+{
+    signal_sweep_expired(now_us, failsafe_off);
+    signal_sweep_pending_acks(sweep_pending_ack);
+}
+
+/*
+ * Moves the session to the router at 'locator' make-before-break: the new
+ * session is opened while the current one keeps serving, and only once it is
+ * up the declarations move over. Returns 0 if the session moved and 1 if the
+ * new router did not accept a session, in which case the current one is kept.
+ * Returns -1 if the declarations failed on the new session, which leaves no
+ * session open.
+ */
+static int session_move(const char *locator)
+{
+    z_owned_session_t next;
+    if (session_start(locator, &next) != 0)
+    {
+        ESP_LOGW(TAG, "Keeping the current session, '%s' did not accept a new one.", locator);
+        return 1;
+    }
+
+    int64_t started_us = esp_timer_get_time();
+    session_close();
+    s_session = next;
+    if (session_declare() != 0)
+    {
+        return -1;
+    }
+    ESP_LOGI(TAG, "Moved the session to '%s', declarations were away for %lld ms.", locator,
+             (long long)((esp_timer_get_time() - started_us) / 1000));
+    return 0;
+}
+
+/*
+ * Watches the session and recovers it in place when it drops, moving to another
+ * router if the current one is gone. The routers are re-probed every
+ * ROUTER_REPROBE_INTERVAL_S seconds by the monitor task, and the session fails
+ * back once a router is faster than the current one by more than
+ * ROUTER_FAILBACK_MARGIN_MS.
+ */
+static void supervise_session(router_t *routers, int count, int current)
+{
+    uint32_t outages = 0;
+    int64_t total_recovery_us = 0;
+
+    if (count > 1)
+    {
+        routers_monitor_start(routers, count, ROUTER_REPROBE_INTERVAL_S, ROUTER_PROBE_TIMEOUT_MS);
+    }
+
+    while (1)
+    {
+        sleep(SESSION_CHECK_INTERVAL_S);
+
+        int64_t now_us = esp_timer_get_time();
+        sweep_signals(now_us);
+        if (!session_is_alive())
+        {
+            ESP_LOGW(TAG, "Lost the Zenoh session, recovering.");
+            session_close();
+            current = session_connect(routers, count);
+
+            int64_t recovery_us = esp_timer_get_time() - now_us;
+            outages++;
+            total_recovery_us += recovery_us;
+            ESP_LOGI(TAG, "Recovered the session%s%s after %lld ms (%lu outages, mean time to recovery %lld ms).",
+                     current >= 0 ? " with " : "", current >= 0 ? routers[current].locator : "",
+                     (long long)(recovery_us / 1000), (unsigned long)outages,
+                     (long long)(total_recovery_us / outages / 1000));
+        }
+        else if (count > 1 && current >= 0)
+        {
+            router_t probed[ROUTER_MAX];
+            if (!routers_monitor_take(probed))
+            {
+                continue;
+            }
+
+            // Probing reorders the routers, find the current one again.
+            char current_locator[ROUTER_LOCATOR_MAX_LEN];
+            strcpy(current_locator, routers[current].locator);
+            memcpy(routers, probed, sizeof(router_t) * count);
+            for (int i = 0; i < count; i++)
+            {
+                if (strcmp(routers[i].locator, current_locator) == 0)
+                {
+                    current = i;
+                }
+            }
+            if (current != 0 && routers[0].rtt_us != ROUTER_UNREACHABLE &&
+                (routers[current].rtt_us == ROUTER_UNREACHABLE ||
+                 routers[0].rtt_us + (int64_t)ROUTER_FAILBACK_MARGIN_MS * 1000 < routers[current].rtt_us))
+            {
+                ESP_LOGI(TAG, "Failing back to the faster router '%s'.", routers[0].locator);
+                int moved = session_move(routers[0].locator);
+                if (moved == 0)
+                {
+                    current = 0;
+                }
+                else if (moved < 0)
+                {
+                    current = session_connect(routers, count);
+                }
+            }
+        }
+    }
+}
+
+void app_main()
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
+        ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
+    // Set WiFi in STA mode and trigger attachment
+    ESP_LOGI(TAG, "Connecting to WiFi...");
+    wifi_init_sta();
+    while (!s_is_wifi_connected)
+    {
+        printf(".");
         sleep(1);
     }
+    ESP_LOGI(TAG, "Establishing the Wifi connection was successful!\n");
+    deadline_clock_start();
 
-    ESP_LOGI(TAG, "Closing Zenoh session...\n");
-    z_undeclare_subscriber(z_move(sub));
+    // Initialize GPIO pin with led
+    gpio_init();
+    s_session_lock = xSemaphoreCreateMutex();
+    timer_wheel_start();
+    signal_table_init(failsafe_off);
+    actuation_pm_init();
+    horn_rpc_start(rpc_output);
+    consumers_init(consumers_appeared);
+
+    router_t routers[ROUTER_MAX];
+    int router_count = 0;
+    if (strcmp(CONNECT, "") == 0)
+    {
+        ESP_LOGI(TAG, "CONNECT string is empty. Using scouting to find peers in the network.\n");
+    }
+    else if (CLIENT_OR_PEER == 0)
+    {
+        router_count = routers_parse(CONNECT, routers, ROUTER_MAX);
+    }
 
-    // Stop the receive and the session lease loop for zenoh-pico
-    zp_stop_read_task(z_loan(s));
-    zp_stop_lease_task(z_loan(s));
+    // The time after boot is what recovering by a restart would cost, against
+    // the mean time to recovery logged for in-place recoveries. esp_timer starts
+    // early during boot, the bootloader's own time is not included.
+    int64_t started_us = esp_timer_get_time();
+    int current = session_connect(routers, router_count);
+    ESP_LOGI(TAG, "Session established after %lld ms (%lld ms after boot), peak heap use %u bytes (zenoh-pico profile %s).",
+             (long long)((esp_timer_get_time() - started_us) / 1000), (long long)(esp_timer_get_time() / 1000),
+             (unsigned)(heap_caps_get_total_size(MALLOC_CAP_DEFAULT) -
+                        heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT)),
+             ZENOH_PROFILE);
 
-    z_close(z_move(s));
-    ESP_LOGI(TAG, "Successfully closed the Zenoh session.\n");
+    // Reaching the router with all declarations in place confirms an updated image.
+    ota_confirm_image();
+
+    soak_monitor_start();
+
+    supervise_session(routers, router_count, current);
 }
 #else
 void app_main()
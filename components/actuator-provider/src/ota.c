@@ -0,0 +1,358 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <zenoh-pico.h>
+#include "config.h"
+#include "ota.h"
+
+#ifdef CONFIG_DELTA_OTA_ENABLED
+#include <esp_delta_ota.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+/*
+ * Every patch starts with a 64 byte header: a magic number followed by the
+ * SHA-256 of the base image the diff was created against. The rest of the
+ * header is reserved.
+ */
+#define PATCH_HEADER_SIZE                   64
+#define PATCH_MAGIC                         0xfccdde10
+#define PATCH_DIGEST_OFFSET                 4
+#define PATCH_DIGEST_SIZE                   32
+
+static const char *TAG = "OTA";
+
+typedef enum
+{
+    OTA_STATE_IDLE,
+    OTA_STATE_HEADER,
+    OTA_STATE_PATCH,
+    OTA_STATE_IMAGE
+} ota_state_t;
+
+static struct
+{
+    ota_state_t state;
+    uint32_t patch_size;
+    uint32_t received;
+    uint8_t header[PATCH_HEADER_SIZE];
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t ota_handle;
+    esp_delta_ota_handle_t delta_handle;
+    int64_t started_us;
+} s_ota;
+
+static z_owned_subscriber_t s_ota_sub;
+static z_owned_publisher_t s_ota_status_pub;
+
+static void ota_publish_status(const char *format, ...)
+{
+    char buf[96];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    ESP_LOGI(TAG, "%s", buf);
+    z_publisher_put(z_loan(s_ota_status_pub), (const uint8_t *)buf, strlen(buf), NULL);
+}
+
+static esp_err_t ota_read_base(uint8_t *buf, size_t size, int src_offset)
+{
+    if (size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return esp_partition_read(s_ota.running, src_offset, buf, size);
+}
+
+static esp_err_t ota_write_image(const uint8_t *buf, size_t size, void *user_data)
+{
+    (void)user_data;
+    if (size == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return esp_ota_write(s_ota.ota_handle, buf, size);
+}
+
+static void ota_release(void)
+{
+    if (s_ota.delta_handle != NULL)
+    {
+        esp_delta_ota_deinit(s_ota.delta_handle);
+        s_ota.delta_handle = NULL;
+    }
+    s_ota.state = OTA_STATE_IDLE;
+}
+
+static void ota_abort(const char *reason)
+{
+    if (s_ota.state != OTA_STATE_IDLE)
+    {
+        esp_ota_abort(s_ota.ota_handle);
+    }
+    ota_release();
+    ota_publish_status("error: %s", reason);
+}
+
+static void ota_begin(uint32_t patch_size, bool full_image)
+{
+    if (s_ota.state != OTA_STATE_IDLE)
+    {
+        ota_abort("superseded by a new update");
+    }
+
+    s_ota.running = esp_ota_get_running_partition();
+    s_ota.target = esp_ota_get_next_update_partition(NULL);
+    if (s_ota.target == NULL)
+    {
+        ota_publish_status("error: no inactive OTA partition");
+        return;
+    }
+
+    // Sequential writes erase the partition sector by sector while the image
+    // is written instead of erasing it completely upfront.
+    if (esp_ota_begin(s_ota.target, OTA_WITH_SEQUENTIAL_WRITES, &s_ota.ota_handle) != ESP_OK)
+    {
+        ota_publish_status("error: esp_ota_begin failed");
+        return;
+    }
+
+    if (!full_image)
+    {
+        esp_delta_ota_cfg_t cfg = {
+            .user_data = NULL,
+            .read_cb = &ota_read_base,
+            .write_cb_with_user_data = &ota_write_image,
+        };
+        s_ota.delta_handle = esp_delta_ota_init(&cfg);
+        if (s_ota.delta_handle == NULL)
+        {
+            esp_ota_abort(s_ota.ota_handle);
+            ota_publish_status("error: esp_delta_ota_init failed");
+            return;
+        }
+    }
+
+    s_ota.state = full_image ? OTA_STATE_IMAGE : OTA_STATE_HEADER;
+    s_ota.patch_size = patch_size;
+    s_ota.received = 0;
+    s_ota.started_us = esp_timer_get_time();
+    ota_publish_status("begin: %lu byte %s into '%s'", (unsigned long)patch_size, full_image ? "image" : "patch",
+                       s_ota.target->label);
+}
+
+static int ota_verify_header(void)
+{
+    uint32_t magic;
+    memcpy(&magic, s_ota.header, sizeof(magic));
+    if (magic != PATCH_MAGIC)
+    {
+        ota_abort("invalid patch header");
+        return -1;
+    }
+
+    uint8_t digest[PATCH_DIGEST_SIZE];
+    if (esp_partition_get_sha256(s_ota.running, digest) != ESP_OK ||
+        memcmp(digest, s_ota.header + PATCH_DIGEST_OFFSET, PATCH_DIGEST_SIZE) != 0)
+    {
+        ota_abort("patch was not created for the running image");
+        return -1;
+    }
+    return 0;
+}
+
+static void ota_feed(uint32_t offset, const uint8_t *data, size_t len)
+{
+    if (s_ota.state == OTA_STATE_IDLE)
+    {
+        return;
+    }
+    if (offset != s_ota.received || s_ota.received + len > s_ota.patch_size)
+    {
+        ota_abort("fragment out of sequence");
+        return;
+    }
+    s_ota.received += len;
+
+    if (s_ota.state == OTA_STATE_IMAGE)
+    {
+        if (esp_ota_write(s_ota.ota_handle, data, len) != ESP_OK)
+        {
+            ota_abort("writing the image failed");
+        }
+        return;
+    }
+
+    if (s_ota.state == OTA_STATE_HEADER)
+    {
+        size_t header_len = PATCH_HEADER_SIZE - offset;
+        if (header_len > len)
+        {
+            header_len = len;
+        }
+        memcpy(s_ota.header + offset, data, header_len);
+        data += header_len;
+        len -= header_len;
+
+        if (offset + header_len < PATCH_HEADER_SIZE)
+        {
+            return;
+        }
+        if (ota_verify_header() != 0)
+        {
+            return;
+        }
+        s_ota.state = OTA_STATE_PATCH;
+    }
+
+    if (len > 0 && esp_delta_ota_feed_patch(s_ota.delta_handle, data, len) != ESP_OK)
+    {
+        ota_abort("applying the patch failed");
+    }
+}
+
+static void ota_end(uint32_t patch_size)
+{
+    if ((s_ota.state != OTA_STATE_PATCH && s_ota.state != OTA_STATE_IMAGE) ||
+        s_ota.received != patch_size || patch_size != s_ota.patch_size)
+    {
+        ota_abort("incomplete patch");
+        return;
+    }
+
+    if (s_ota.state == OTA_STATE_PATCH && esp_delta_ota_finalize(s_ota.delta_handle) != ESP_OK)
+    {
+        ota_abort("finalizing the patch failed");
+        return;
+    }
+    ota_release();
+
+    // esp_ota_end validates the written image before it can become bootable,
+    // including its signature if signed app verification is enabled.
+    if (esp_ota_end(s_ota.ota_handle) != ESP_OK)
+    {
+        ota_publish_status("error: image verification failed");
+        return;
+    }
+    if (esp_ota_set_boot_partition(s_ota.target) != ESP_OK)
+    {
+        ota_publish_status("error: switching the boot partition failed");
+        return;
+    }
+
+    int64_t elapsed_ms = (esp_timer_get_time() - s_ota.started_us) / 1000;
+    ota_publish_status("done: %lu bytes in %lld ms, restarting", (unsigned long)patch_size, elapsed_ms);
+    vTaskDelay(pdMS_TO_TICKS(500));
+    esp_restart();
+}
+
+static void ota_sample_handler(const z_sample_t *sample, void *arg)
+{
+    (void)arg;
+    if (sample->payload.len < OTA_FRAGMENT_HEADER_SIZE)
+    {
+        ESP_LOGW(TAG, "Discarding a fragment without header.");
+        return;
+    }
+
+    const uint8_t *fragment = sample->payload.start;
+    uint32_t value = (uint32_t)fragment[4] | ((uint32_t)fragment[5] << 8) |
+                     ((uint32_t)fragment[6] << 16) | ((uint32_t)fragment[7] << 24);
+
+    switch (fragment[0])
+    {
+    case OTA_FRAGMENT_BEGIN:
+        ota_begin(value, false);
+        break;
+    case OTA_FRAGMENT_BEGIN_IMAGE:
+        ota_begin(value, true);
+        break;
+    case OTA_FRAGMENT_DATA:
+        ota_feed(value, fragment + OTA_FRAGMENT_HEADER_SIZE,
+                 sample->payload.len - OTA_FRAGMENT_HEADER_SIZE);
+        break;
+    case OTA_FRAGMENT_END:
+        ota_end(value);
+        break;
+    default:
+        ESP_LOGW(TAG, "Discarding a fragment of unknown kind %d.", fragment[0]);
+    }
+}
+
+int ota_declare(z_session_t session)
+{
+    s_ota_status_pub = z_declare_publisher(session, z_keyexpr(OTA_STATUS_KEYEXPR), NULL);
+    if (!z_check(s_ota_status_pub))
+    {
+        ESP_LOGE(TAG, "Unable to declare publisher for '%s'.", OTA_STATUS_KEYEXPR);
+        return -1;
+    }
+
+    z_owned_closure_sample_t callback = z_closure(ota_sample_handler);
+    s_ota_sub = z_declare_subscriber(session, z_keyexpr(OTA_KEYEXPR), z_move(callback), NULL);
+    if (!z_check(s_ota_sub))
+    {
+        ESP_LOGE(TAG, "Unable to declare subscriber on '%s'.", OTA_KEYEXPR);
+        z_undeclare_publisher(z_move(s_ota_status_pub));
+        return -1;
+    }
+#ifndef CONFIG_SECURE_SIGNED_ON_UPDATE
+    ESP_LOGW(TAG, "Updates are not authenticated, anyone publishing on '%s' can replace the firmware.", OTA_KEYEXPR);
+#endif
+    ESP_LOGI(TAG, "Waiting for delta updates on '%s'", OTA_KEYEXPR);
+    return 0;
+}
+
+void ota_undeclare(void)
+{
+    if (s_ota.state != OTA_STATE_IDLE)
+    {
+        esp_ota_abort(s_ota.ota_handle);
+        ota_release();
+    }
+    z_undeclare_subscriber(z_move(s_ota_sub));
+    z_undeclare_publisher(z_move(s_ota_status_pub));
+}
+
+void ota_confirm_image(void)
+{
+#ifdef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+    esp_ota_mark_app_valid_cancel_rollback();
+#endif
+}
+#else
+int ota_declare(z_session_t session)
+{
+    (void)session;
+    return 0;
+}
+
+void ota_undeclare(void)
+{
+}
+
+void ota_confirm_image(void)
+{
+}
+#endif
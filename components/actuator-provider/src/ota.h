@@ -0,0 +1,49 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef OTA_H
+#define OTA_H
+
+#include <zenoh-pico.h>
+
+/*
+ * Delta firmware updates over Zenoh.
+ *
+ * A compressed binary diff (see README) is published on OTA_KEYEXPR as a stream
+ * of fragments. Every fragment starts with an 8 byte header:
+ *
+ *   byte 0     kind: OTA_FRAGMENT_BEGIN, OTA_FRAGMENT_DATA or OTA_FRAGMENT_END
+ *   bytes 1-3  reserved, zero
+ *   bytes 4-7  little endian u32: total patch size (BEGIN, END) or the offset
+ *              of the fragment's data within the patch (DATA)
+ *
+ * Data fragments are applied while they arrive and written straight into the
+ * inactive OTA partition, so the image is never buffered in RAM. The result of
+ * the update is published on OTA_STATUS_KEYEXPR.
+ *
+ * A stream started with OTA_FRAGMENT_BEGIN_IMAGE carries a full application
+ * image instead of a diff, which is written as is. It serves as the reference
+ * the delta transfer is measured against.
+ */
+#define OTA_FRAGMENT_BEGIN                  0x01
+#define OTA_FRAGMENT_DATA                   0x02
+#define OTA_FRAGMENT_END                    0x03
+#define OTA_FRAGMENT_BEGIN_IMAGE            0x04
+#define OTA_FRAGMENT_HEADER_SIZE            8
+
+int ota_declare(z_session_t session);
+void ota_undeclare(void);
+// Confirms the running image after an update, so the bootloader does not roll it back.
+void ota_confirm_image(void);
+
+#endif
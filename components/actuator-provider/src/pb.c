@@ -0,0 +1,216 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <string.h>
+#include "pb.h"
+
+void pb_writer_init(pb_writer_t *writer, uint8_t *buf, size_t size)
+{
+    writer->buf = buf;
+    writer->size = size;
+    writer->len = 0;
+    writer->overflow = false;
+}
+
+static void pb_put(pb_writer_t *writer, const void *data, size_t len)
+{
+    if (writer->overflow || writer->size - writer->len < len)
+    {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void pb_put_varint(pb_writer_t *writer, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t len = 0;
+    do
+    {
+        bytes[len] = (uint8_t)(value & 0x7f);
+        value >>= 7;
+        if (value != 0)
+        {
+            bytes[len] |= 0x80;
+        }
+        len++;
+    } while (value != 0);
+    pb_put(writer, bytes, len);
+}
+
+static void pb_put_tag(pb_writer_t *writer, uint32_t number, uint8_t wire_type)
+{
+    pb_put_varint(writer, ((uint64_t)number << 3) | wire_type);
+}
+
+void pb_write_varint(pb_writer_t *writer, uint32_t number, uint64_t value)
+{
+    pb_put_tag(writer, number, PB_WIRE_VARINT);
+    pb_put_varint(writer, value);
+}
+
+void pb_write_int32(pb_writer_t *writer, uint32_t number, int32_t value)
+{
+    // Negative int32 values are sign extended to 64 bit on the wire.
+    pb_write_varint(writer, number, (uint64_t)(int64_t)value);
+}
+
+void pb_write_fixed64(pb_writer_t *writer, uint32_t number, uint64_t value)
+{
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++)
+    {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+    pb_put_tag(writer, number, PB_WIRE_FIXED64);
+    pb_put(writer, bytes, sizeof(bytes));
+}
+
+void pb_write_bytes(pb_writer_t *writer, uint32_t number, const void *data, size_t len)
+{
+    pb_put_tag(writer, number, PB_WIRE_LEN);
+    pb_put_varint(writer, len);
+    pb_put(writer, data, len);
+}
+
+void pb_write_string(pb_writer_t *writer, uint32_t number, const char *str)
+{
+    pb_write_bytes(writer, number, str, strlen(str));
+}
+
+void pb_reader_init(pb_reader_t *reader, const uint8_t *buf, size_t len)
+{
+    reader->buf = buf;
+    reader->len = len;
+    reader->pos = 0;
+}
+
+static bool pb_get_varint(pb_reader_t *reader, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (reader->pos >= reader->len)
+        {
+            return false;
+        }
+        uint8_t byte = reader->buf[reader->pos++];
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool pb_get_fixed(pb_reader_t *reader, size_t size, uint64_t *value)
+{
+    if (reader->len - reader->pos < size)
+    {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        *value |= (uint64_t)reader->buf[reader->pos++] << (8 * i);
+    }
+    return true;
+}
+
+bool pb_read_field(pb_reader_t *reader, pb_field_t *field)
+{
+    uint64_t tag;
+    if (reader->pos >= reader->len || !pb_get_varint(reader, &tag))
+    {
+        return false;
+    }
+    field->number = (uint32_t)(tag >> 3);
+    field->wire_type = (uint8_t)(tag & 0x07);
+    field->value = 0;
+    field->data = NULL;
+    field->data_len = 0;
+
+    switch (field->wire_type)
+    {
+    case PB_WIRE_VARINT:
+        return pb_get_varint(reader, &field->value);
+    case PB_WIRE_FIXED64:
+        return pb_get_fixed(reader, 8, &field->value);
+    case PB_WIRE_FIXED32:
+        return pb_get_fixed(reader, 4, &field->value);
+    case PB_WIRE_LEN:
+    {
+        uint64_t len;
+        if (!pb_get_varint(reader, &len) || len > reader->len - reader->pos)
+        {
+            return false;
+        }
+        field->data = reader->buf + reader->pos;
+        field->data_len = (size_t)len;
+        reader->pos += (size_t)len;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool pb_reader_done(const pb_reader_t *reader)
+{
+    return reader->pos == reader->len;
+}
+
+bool pb_any_unpack(const uint8_t *buf, size_t len, const char *full_name, const uint8_t **data, size_t *data_len)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    const uint8_t *type_url = NULL;
+    size_t type_url_len = 0;
+    pb_reader_init(&reader, buf, len);
+    *data = NULL;
+    *data_len = 0;
+    while (pb_read_field(&reader, &field))
+    {
+        if (field.number == 1 && field.wire_type == PB_WIRE_LEN)
+        {
+            type_url = field.data;
+            type_url_len = field.data_len;
+        }
+        else if (field.number == 2 && field.wire_type == PB_WIRE_LEN)
+        {
+            *data = field.data;
+            *data_len = field.data_len;
+        }
+    }
+    if (!pb_reader_done(&reader) || type_url == NULL)
+    {
+        return false;
+    }
+
+    // The type URL is "<prefix>/<full name>", the prefix is usually "type.googleapis.com".
+    size_t name_len = strlen(full_name);
+    if (type_url_len <= name_len || type_url[type_url_len - name_len - 1] != '/' ||
+        memcmp(type_url + type_url_len - name_len, full_name, name_len) != 0)
+    {
+        return false;
+    }
+    // An empty message has no value field.
+    if (*data == NULL)
+    {
+        *data = buf;
+    }
+    return true;
+}
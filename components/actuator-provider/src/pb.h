@@ -0,0 +1,75 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef PB_H
+#define PB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Minimal protobuf wire format encoder and decoder working on caller provided
+ * buffers. It covers what the horn and uProtocol messages need: varints,
+ * fixed64 and length-delimited fields. Nothing is allocated on the heap.
+ */
+#define PB_WIRE_VARINT                      0
+#define PB_WIRE_FIXED64                     1
+#define PB_WIRE_LEN                         2
+#define PB_WIRE_FIXED32                     5
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} pb_writer_t;
+
+typedef struct
+{
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+} pb_reader_t;
+
+typedef struct
+{
+    uint32_t number;
+    uint8_t wire_type;
+    uint64_t value;        // varint and fixed values
+    const uint8_t *data;   // length-delimited values
+    size_t data_len;
+} pb_field_t;
+
+void pb_writer_init(pb_writer_t *writer, uint8_t *buf, size_t size);
+void pb_write_varint(pb_writer_t *writer, uint32_t number, uint64_t value);
+void pb_write_int32(pb_writer_t *writer, uint32_t number, int32_t value);
+void pb_write_fixed64(pb_writer_t *writer, uint32_t number, uint64_t value);
+void pb_write_bytes(pb_writer_t *writer, uint32_t number, const void *data, size_t len);
+void pb_write_string(pb_writer_t *writer, uint32_t number, const char *str);
+
+void pb_reader_init(pb_reader_t *reader, const uint8_t *buf, size_t len);
+// Reads the next field. Returns false at the end of the buffer or on malformed input.
+bool pb_read_field(pb_reader_t *reader, pb_field_t *field);
+// True if the reader consumed the whole buffer without errors.
+bool pb_reader_done(const pb_reader_t *reader);
+
+/*
+ * Unpacks a google.protobuf.Any. Returns true if it holds a message of type
+ * 'full_name', the last segment of its type URL, and points 'data' at the
+ * serialized message.
+ */
+bool pb_any_unpack(const uint8_t *buf, size_t len, const char *full_name, const uint8_t **data, size_t *data_len);
+
+#endif
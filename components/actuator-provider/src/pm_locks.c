@@ -0,0 +1,235 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "pm_locks.h"
+
+#if defined(CONFIG_PM_ENABLE) && !defined(CONFIG_ACTUATION_PM_POLICY_NONE)
+#include <esp_pm.h>
+
+static const char *TAG = "PM";
+
+static esp_pm_lock_handle_t s_cpu_freq_lock;
+static esp_pm_lock_handle_t s_no_sleep_lock;
+
+// Guards the hold state below, which the read, player and supervision tasks
+// and the linger timer change.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_holders = 0;
+static int64_t s_held_since_us;
+static int64_t s_held_us = 0;
+static uint32_t s_warm_commands = 0;
+static uint32_t s_cold_commands = 0;
+
+// Must be called with s_lock held. The locks count their acquisitions, so
+// every reason to hold them acquires and releases them independently.
+static ACTUATION_ATTR void actuation_pm_hold(bool hold)
+{
+    if (hold)
+    {
+        if (s_holders++ == 0)
+        {
+            s_held_since_us = esp_timer_get_time();
+        }
+        esp_pm_lock_acquire(s_cpu_freq_lock);
+        esp_pm_lock_acquire(s_no_sleep_lock);
+    }
+    else
+    {
+        esp_pm_lock_release(s_no_sleep_lock);
+        esp_pm_lock_release(s_cpu_freq_lock);
+        if (--s_holders == 0)
+        {
+            s_held_us += esp_timer_get_time() - s_held_since_us;
+        }
+    }
+}
+
+// Counts a command by whether it found the locks held, i.e. ran at full clock without a wake-up delay.
+static ACTUATION_ATTR void actuation_pm_count_command(void)
+{
+    if (s_holders > 0)
+    {
+        s_warm_commands++;
+    }
+    else
+    {
+        s_cold_commands++;
+    }
+}
+
+static esp_err_t actuation_pm_create_locks(void)
+{
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "actuation_cpu", &s_cpu_freq_lock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "actuation_sleep", &s_no_sleep_lock) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Unable to create the power management locks.");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void actuation_pm_stats(actuation_pm_stats_t *stats)
+{
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    stats->held_us = s_held_us + (s_holders > 0 ? now_us - s_held_since_us : 0);
+    stats->warm_commands = s_warm_commands;
+    stats->cold_commands = s_cold_commands;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#ifdef CONFIG_ACTUATION_PM_POLICY_SESSION
+static bool s_session_held = false;
+
+void actuation_pm_init(void)
+{
+    actuation_pm_create_locks();
+}
+
+void actuation_pm_session(bool established)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (established != s_session_held)
+    {
+        s_session_held = established;
+        actuation_pm_hold(established);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+ACTUATION_ATTR void actuation_pm_output(bool on)
+{
+    (void)on;
+}
+
+ACTUATION_ATTR void actuation_pm_command(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    actuation_pm_count_command();
+    portEXIT_CRITICAL(&s_lock);
+}
+#else
+static esp_timer_handle_t s_linger_timer;
+static bool s_output_held = false;
+static bool s_command_held = false;
+static int64_t s_linger_until_us;
+
+// Releases the locks taken for commands once ACTUATION_PM_LINGER_MS passed
+// without another one, or re-arms for the rest of the window.
+static void actuation_pm_linger_expired(void *arg)
+{
+    (void)arg;
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    int64_t remaining_us = s_linger_until_us - now_us;
+    if (remaining_us <= 0 && s_command_held)
+    {
+        s_command_held = false;
+        actuation_pm_hold(false);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (remaining_us > 0)
+    {
+        esp_timer_start_once(s_linger_timer, remaining_us);
+    }
+}
+
+void actuation_pm_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = actuation_pm_linger_expired,
+        .name = "actuation_pm_linger",
+    };
+    if (actuation_pm_create_locks() != ESP_OK || esp_timer_create(&args, &s_linger_timer) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Unable to create the linger timer.");
+    }
+}
+
+void actuation_pm_session(bool established)
+{
+    (void)established;
+}
+
+ACTUATION_ATTR void actuation_pm_output(bool on)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (on != s_output_held)
+    {
+        s_output_held = on;
+        actuation_pm_hold(on);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// Commands come in bursts (sequences, heartbeats, a driver pressing the horn
+// repeatedly). The locks are taken when a command arrives and kept for
+// ACTUATION_PM_LINGER_MS, so the commands following it find the CPU at full
+// clock. The command that opens a window was already received at reduced
+// clock, only holding the locks for the whole session avoids that.
+ACTUATION_ATTR void actuation_pm_command(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    actuation_pm_count_command();
+    s_linger_until_us = now_us + (int64_t)ACTUATION_PM_LINGER_MS * 1000;
+    bool opened = !s_command_held;
+    if (opened)
+    {
+        s_command_held = true;
+        actuation_pm_hold(true);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    // A running timer re-arms itself for the extended window.
+    if (opened)
+    {
+        esp_timer_start_once(s_linger_timer, (uint64_t)ACTUATION_PM_LINGER_MS * 1000);
+    }
+}
+#endif
+#else
+static uint32_t s_commands = 0;
+
+void actuation_pm_init(void)
+{
+}
+
+void actuation_pm_session(bool established)
+{
+    (void)established;
+}
+
+ACTUATION_ATTR void actuation_pm_output(bool on)
+{
+    (void)on;
+}
+
+ACTUATION_ATTR void actuation_pm_command(void)
+{
+    __atomic_fetch_add(&s_commands, 1, __ATOMIC_RELAXED);
+}
+
+void actuation_pm_stats(actuation_pm_stats_t *stats)
+{
+    stats->held_us = 0;
+    stats->warm_commands = 0;
+    stats->cold_commands = __atomic_load_n(&s_commands, __ATOMIC_RELAXED);
+}
+#endif
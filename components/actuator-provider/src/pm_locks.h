@@ -0,0 +1,48 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef PM_LOCKS_H
+#define PM_LOCKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Power management locks for the actuation path.
+ *
+ * With dynamic frequency scaling and light sleep enabled (CONFIG_PM_ENABLE),
+ * the first instructions after idle may run at reduced clock after a wake-up
+ * delay. Depending on CONFIG_ACTUATION_PM_POLICY, the provider pins the CPU to
+ * its maximum frequency and prevents light sleep
+ *   - SESSION: while a Zenoh session is established, or
+ *   - ACTIVE:  while the output is on and for ACTUATION_PM_LINGER_MS after
+ *              every command.
+ * Without CONFIG_PM_ENABLE or with the NONE policy no lock is taken.
+ */
+typedef struct
+{
+    int64_t held_us;        // Time the locks were held since boot
+    uint32_t warm_commands; // Commands received while the locks were held
+    uint32_t cold_commands; // Commands received while they were not
+} actuation_pm_stats_t;
+
+void actuation_pm_init(void);
+void actuation_pm_session(bool established);
+void actuation_pm_output(bool on);
+
+// Called as soon as a command was received, from any task.
+void actuation_pm_command(void);
+
+void actuation_pm_stats(actuation_pm_stats_t *stats);
+
+#endif
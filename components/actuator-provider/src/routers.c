@@ -0,0 +1,257 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "routers.h"
+
+static const char *TAG = "ROUTERS";
+
+// Routers probed by the monitor task, and the result of its latest probe
+static router_t s_monitored[ROUTER_MAX];
+static router_t s_probed[ROUTER_MAX];
+static int s_monitored_count;
+static int s_monitor_interval_s;
+static int s_monitor_timeout_ms;
+static bool s_probe_fresh = false;
+static portMUX_TYPE s_monitor_lock = portMUX_INITIALIZER_UNLOCKED;
+
+int is_valid_tcp_url(const char *url)
+{
+    char pattern[] = "^tcp/.*:[0-9]+(#.*)?$";
+    int result;
+    regex_t reg;
+
+    if (regcomp(&reg, pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        return -1;
+
+    result = regexec(&reg, url, 0, 0, 0);
+    regfree(&reg);
+
+    return result;
+}
+
+int routers_parse(const char *list, router_t *routers, int max)
+{
+    int count = 0;
+    const char *start = list;
+
+    while (*start != '\0' && count < max)
+    {
+        const char *end = strchr(start, ';');
+        size_t len = end != NULL ? (size_t)(end - start) : strlen(start);
+
+        if (len > 0 && len < ROUTER_LOCATOR_MAX_LEN)
+        {
+            memcpy(routers[count].locator, start, len);
+            routers[count].locator[len] = '\0';
+            routers[count].rtt_us = ROUTER_UNREACHABLE;
+
+            if (is_valid_tcp_url(routers[count].locator) == 0)
+            {
+                count++;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Ignoring invalid router locator '%s'.", routers[count].locator);
+            }
+        }
+
+        if (end == NULL)
+        {
+            break;
+        }
+        start = end + 1;
+    }
+    return count;
+}
+
+// Resolves the locator and starts a non-blocking connect. Returns the socket or -1.
+static int router_connect_start(const router_t *router)
+{
+    char host[ROUTER_LOCATOR_MAX_LEN];
+    const char *address = router->locator + strlen("tcp/");
+    size_t len = strcspn(address, "#");
+    memcpy(host, address, len);
+    host[len] = '\0';
+
+    char *port = strrchr(host, ':');
+    if (port == NULL)
+    {
+        return -1;
+    }
+    *port++ = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *info = NULL;
+    if (getaddrinfo(host, port, &hints, &info) != 0 || info == NULL)
+    {
+        return -1;
+    }
+
+    int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd >= 0)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        if (connect(fd, info->ai_addr, info->ai_addrlen) != 0 && errno != EINPROGRESS)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(info);
+    return fd;
+}
+
+int routers_probe(router_t *routers, int count, int timeout_ms)
+{
+    int fds[ROUTER_MAX];
+    int64_t started_us[ROUTER_MAX];
+    int pending = 0;
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+
+    for (int i = 0; i < count; i++)
+    {
+        routers[i].rtt_us = ROUTER_UNREACHABLE;
+        started_us[i] = esp_timer_get_time();
+        fds[i] = router_connect_start(&routers[i]);
+        if (fds[i] >= 0)
+        {
+            pending++;
+        }
+    }
+
+    while (pending > 0)
+    {
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (remaining_us <= 0)
+        {
+            break;
+        }
+
+        fd_set writable;
+        FD_ZERO(&writable);
+        int max_fd = -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (fds[i] >= 0)
+            {
+                FD_SET(fds[i], &writable);
+                max_fd = fds[i] > max_fd ? fds[i] : max_fd;
+            }
+        }
+
+        struct timeval timeout = {.tv_sec = remaining_us / 1000000, .tv_usec = remaining_us % 1000000};
+        if (select(max_fd + 1, NULL, &writable, NULL, &timeout) <= 0)
+        {
+            break;
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        for (int i = 0; i < count; i++)
+        {
+            if (fds[i] >= 0 && FD_ISSET(fds[i], &writable))
+            {
+                int error = 0;
+                socklen_t error_len = sizeof(error);
+                getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &error, &error_len);
+                if (error == 0)
+                {
+                    routers[i].rtt_us = now_us - started_us[i];
+                }
+                close(fds[i]);
+                fds[i] = -1;
+                pending--;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            close(fds[i]);
+        }
+    }
+
+    // Stable insertion sort, the list holds a handful of entries at most.
+    int reachable = 0;
+    for (int i = 1; i < count; i++)
+    {
+        router_t router = routers[i];
+        int j = i - 1;
+        while (j >= 0 && routers[j].rtt_us > router.rtt_us)
+        {
+            routers[j + 1] = routers[j];
+            j--;
+        }
+        routers[j + 1] = router;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (routers[i].rtt_us != ROUTER_UNREACHABLE)
+        {
+            ESP_LOGI(TAG, "Router '%s' answered after %lld us.", routers[i].locator, (long long)routers[i].rtt_us);
+            reachable++;
+        }
+    }
+    return reachable;
+}
+
+static void routers_monitor_task(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(s_monitor_interval_s * 1000));
+        routers_probe(s_monitored, s_monitored_count, s_monitor_timeout_ms);
+
+        portENTER_CRITICAL(&s_monitor_lock);
+        memcpy(s_probed, s_monitored, sizeof(router_t) * s_monitored_count);
+        s_probe_fresh = true;
+        portEXIT_CRITICAL(&s_monitor_lock);
+    }
+}
+
+void routers_monitor_start(const router_t *routers, int count, int interval_s, int timeout_ms)
+{
+    memcpy(s_monitored, routers, sizeof(router_t) * count);
+    s_monitored_count = count;
+    s_monitor_interval_s = interval_s;
+    s_monitor_timeout_ms = timeout_ms;
+    xTaskCreate(routers_monitor_task, "router_probe", 4096, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+
+bool routers_monitor_take(router_t *routers)
+{
+    portENTER_CRITICAL(&s_monitor_lock);
+    bool fresh = s_probe_fresh;
+    if (fresh)
+    {
+        memcpy(routers, s_probed, sizeof(router_t) * s_monitored_count);
+        s_probe_fresh = false;
+    }
+    portEXIT_CRITICAL(&s_monitor_lock);
+    return fresh;
+}
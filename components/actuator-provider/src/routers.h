@@ -0,0 +1,59 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef ROUTERS_H
+#define ROUTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ROUTER_MAX                          4
+#define ROUTER_LOCATOR_MAX_LEN              96
+#define ROUTER_UNREACHABLE                  INT64_MAX
+
+typedef struct
+{
+    char locator[ROUTER_LOCATOR_MAX_LEN];
+    int64_t rtt_us; // TCP handshake time of the last probe, ROUTER_UNREACHABLE if it failed
+} router_t;
+
+// Returns 0 if the url has the form "tcp/<host>:<port>[#<options>]".
+int is_valid_tcp_url(const char *url);
+
+/*
+ * Splits a ';' separated list of "tcp/<host>:<port>[#<options>]" locators.
+ * Invalid entries are skipped. Returns the number of routers stored.
+ */
+int routers_parse(const char *list, router_t *routers, int max);
+
+/*
+ * Probes all routers in parallel by opening a TCP connection to each of them and
+ * sorts them by the measured round-trip time, fastest first. Unreachable routers
+ * keep their configured order at the end. Returns the number of reachable routers.
+ */
+int routers_probe(router_t *routers, int count, int timeout_ms);
+
+/*
+ * Starts a task that probes a copy of the routers every 'interval_s' seconds, so
+ * the periodic probe does not hold up the caller.
+ */
+void routers_monitor_start(const router_t *routers, int count, int interval_s, int timeout_ms);
+
+/*
+ * Copies the routers as sorted by the latest probe of the monitor task into
+ * 'routers'. Returns false, leaving 'routers' unchanged, if no probe completed
+ * since the last call.
+ */
+bool routers_monitor_take(router_t *routers);
+
+#endif
@@ -0,0 +1,167 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "config.h"
+#include "history.h"
+#include "signal_table.h"
+#include "timer_wheel.h"
+
+static struct
+{
+    // Hot fields, read by every sweep
+    int64_t deadline_us[SIGNAL_COUNT];
+    uint8_t current[SIGNAL_COUNT];
+    uint8_t target[SIGNAL_COUNT];
+    uint8_t pending_ack[SIGNAL_COUNT];
+
+    // Cold fields
+    uint32_t sequence[SIGNAL_COUNT];
+    timer_handle_t deadline_timer[SIGNAL_COUNT];
+    uint64_t gpio_mask[SIGNAL_COUNT]; // The GPIOs driving the output, bit n for GPIO n
+} s_signals;
+
+// Keeps current and pending_ack of a signal consistent: the read task, the
+// player and the timer wheel task apply values while any of them may acknowledge.
+// Also pairs a deadline with the timer enforcing it.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static signal_failsafe_t s_failsafe;
+
+// Clears an expired deadline. Returns true if the caller has to turn the signal
+// off; the timer and the sweep may both find the deadline expired, only one wins.
+static bool signal_claim_expired(signal_id_t id, int64_t now_us)
+{
+    int64_t deadline_us = __atomic_load_n(&s_signals.deadline_us[id], __ATOMIC_RELAXED);
+    return deadline_us <= now_us &&
+           __atomic_compare_exchange_n(&s_signals.deadline_us[id], &deadline_us, SIGNAL_NO_DEADLINE, false,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED) &&
+           __atomic_load_n(&s_signals.current[id], __ATOMIC_RELAXED);
+}
+
+static void signal_deadline_timer(void *arg)
+{
+    signal_id_t id = (signal_id_t)(uintptr_t)arg;
+    if (signal_claim_expired(id, esp_timer_get_time()))
+    {
+        s_failsafe(id);
+    }
+}
+
+void signal_table_init(signal_failsafe_t failsafe)
+{
+    s_failsafe = failsafe;
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        s_signals.deadline_us[id] = SIGNAL_NO_DEADLINE;
+    }
+    s_signals.gpio_mask[SIGNAL_HORN] = 1ULL << LED_GPIO;
+}
+
+ACTUATION_ATTR void signal_set_target(signal_id_t id, bool value)
+{
+    if (s_signals.target[id] != value || s_signals.sequence[id] == 0)
+    {
+        history_record(id, HISTORY_TARGET, value);
+    }
+    s_signals.target[id] = value;
+    s_signals.sequence[id]++;
+}
+
+ACTUATION_ATTR void signal_set_current(signal_id_t id, bool value)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool changed = s_signals.current[id] != value;
+    if (changed)
+    {
+        __atomic_store_n(&s_signals.current[id], value, __ATOMIC_RELAXED);
+        __atomic_store_n(&s_signals.pending_ack[id], 1, __ATOMIC_RELAXED);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (changed)
+    {
+        history_record(id, HISTORY_APPLIED, value);
+    }
+}
+
+ACTUATION_ATTR void signal_acked(signal_id_t id, bool value)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_signals.current[id] == value)
+    {
+        __atomic_store_n(&s_signals.pending_ack[id], 0, __ATOMIC_RELAXED);
+    }
+    portEXIT_CRITICAL(&s_lock);
+    history_record(id, HISTORY_ACKED, value);
+}
+
+ACTUATION_ATTR bool signal_current(signal_id_t id)
+{
+    return __atomic_load_n(&s_signals.current[id], __ATOMIC_RELAXED);
+}
+
+ACTUATION_ATTR void signal_drive(signal_id_t id, bool value)
+{
+    uint64_t mask = s_signals.gpio_mask[id];
+    while (mask != 0)
+    {
+        gpio_set_level((gpio_num_t)__builtin_ctzll(mask), value);
+        mask &= mask - 1;
+    }
+}
+
+void signal_set_deadline(signal_id_t id, int64_t deadline_us)
+{
+    timer_handle_t timer = TIMER_INVALID;
+    if (deadline_us != SIGNAL_NO_DEADLINE)
+    {
+        int64_t delay_us = deadline_us - esp_timer_get_time();
+        uint32_t delay_ms = delay_us > 0 ? (uint32_t)((delay_us + 999) / 1000) : 0;
+        timer = timer_wheel_schedule(delay_ms, signal_deadline_timer, (void *)(uintptr_t)id);
+    }
+
+    // The read task and the player both set deadlines. Whichever swaps in its
+    // timer second cancels the one of the first, so no timer is left behind.
+    portENTER_CRITICAL(&s_lock);
+    timer_handle_t previous = s_signals.deadline_timer[id];
+    s_signals.deadline_timer[id] = timer;
+    __atomic_store_n(&s_signals.deadline_us[id], deadline_us, __ATOMIC_RELAXED);
+    portEXIT_CRITICAL(&s_lock);
+    timer_wheel_cancel(previous);
+}
+
+void signal_sweep_expired(int64_t now_us, signal_visit_t expired)
+{
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        if (__atomic_load_n(&s_signals.deadline_us[id], __ATOMIC_RELAXED) <= now_us && signal_claim_expired(id, now_us))
+        {
+            expired(id);
+        }
+    }
+}
+
+void signal_sweep_pending_acks(signal_visit_t pending)
+{
+    for (signal_id_t id = 0; id < SIGNAL_COUNT; id++)
+    {
+        if (__atomic_load_n(&s_signals.pending_ack[id], __ATOMIC_RELAXED))
+        {
+            pending(id);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef SIGNAL_TABLE_H
+#define SIGNAL_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Central state of all actuated signals, indexed by signal id.
+ *
+ * The table is laid out as a struct of arrays: the fields touched by the
+ * periodic sweeps (deadline, current and target value, pending acknowledgement)
+ * are each packed into one contiguous array, so a sweep over all signals is a
+ * linear pass over a few cache lines. Rarely read fields are kept apart.
+ * Sweeps visit the matching signals through a callback, so the number of
+ * signals is only limited by signal_id_t. host/signal_bench.c compares the
+ * layout with an array of structs.
+ */
+#define SIGNAL_HORN                         0
+#ifndef SIGNAL_COUNT
+#define SIGNAL_COUNT                        1
+#endif
+
+#define SIGNAL_NO_DEADLINE                  INT64_MAX
+
+typedef uint16_t signal_id_t;
+
+// Called by the sweeps for each matching signal.
+typedef void (*signal_visit_t)(signal_id_t id);
+
+// Turns the output of a signal off when it stayed on past its deadline.
+typedef void (*signal_failsafe_t)(signal_id_t id);
+
+// Registers the signals and their outputs. All signals start off without a deadline.
+void signal_table_init(signal_failsafe_t failsafe);
+
+// Records a received target value and the number of targets received for the signal so far.
+// Only changes of the target are added to the actuation history, not heartbeats repeating it.
+void signal_set_target(signal_id_t id, bool value);
+
+// Records the value applied to the output. A change is marked for acknowledgement.
+void signal_set_current(signal_id_t id, bool value);
+
+// Records that the value was published. Clears the pending acknowledgement only
+// if the value is still the current one, a change applied meanwhile stays pending.
+void signal_acked(signal_id_t id, bool value);
+
+bool signal_current(signal_id_t id);
+
+// Sets every GPIO of the signal's output to 'value'. The horn is driven by LED_GPIO.
+void signal_drive(signal_id_t id, bool value);
+
+/*
+ * Sets the esp_timer time after which the signal has to fall back to off, or
+ * SIGNAL_NO_DEADLINE. The deadline is enforced by a timer wheel timer, which
+ * replaces the one of the previous deadline. If the timer pool is exhausted,
+ * the next expiry sweep enforces it instead. Safe to call from several tasks.
+ */
+void signal_set_deadline(signal_id_t id, int64_t deadline_us);
+
+// Clears the deadlines of the signals that are on past them and passes each to 'expired'.
+void signal_sweep_expired(int64_t now_us, signal_visit_t expired);
+
+// Passes each signal whose latest change has not been acknowledged yet to
+// 'pending'. The acknowledgement stays pending until signal_acked() is called.
+void signal_sweep_pending_acks(signal_visit_t pending);
+
+#endif
@@ -0,0 +1,203 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "pm_locks.h"
+#include "soak.h"
+
+#ifdef CONFIG_SOAK_MONITOR_ENABLED
+
+/*
+ * Latencies are counted in a log-linear histogram: four buckets per power of
+ * two, which bounds the percentile error to 25% while recording stays a couple
+ * of instructions. Counters are cumulative and only ever incremented by the
+ * Zenoh read task; the monitor task differentiates them per interval.
+ */
+#define SOAK_SUB_BUCKETS                    4
+#define SOAK_BUCKETS                        124
+
+static const char *TAG = "SOAK";
+
+static uint32_t s_buckets[SOAK_BUCKETS];
+static uint32_t s_interval_max_us;
+static uint32_t s_failures;
+
+static inline int soak_bucket(uint32_t value)
+{
+    if (value < SOAK_SUB_BUCKETS)
+    {
+        return value;
+    }
+    int msb = 31 - __builtin_clz(value);
+    return SOAK_SUB_BUCKETS * (msb - 1) + ((value >> (msb - 2)) & (SOAK_SUB_BUCKETS - 1));
+}
+
+static uint32_t soak_bucket_upper_bound(int bucket)
+{
+    if (bucket < SOAK_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    int msb = bucket / SOAK_SUB_BUCKETS + 1;
+    uint32_t lower = (uint32_t)(SOAK_SUB_BUCKETS + bucket % SOAK_SUB_BUCKETS) << (msb - 2);
+    return lower + (1u << (msb - 2)) - 1;
+}
+
+void soak_record_latency(int64_t latency_us)
+{
+    uint32_t value = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    __atomic_fetch_add(&s_buckets[soak_bucket(value)], 1, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&s_interval_max_us, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&s_interval_max_us, &max, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+static uint32_t soak_percentile(const uint32_t *counts, uint32_t total, uint32_t percent)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < SOAK_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank && seen > 0)
+        {
+            return soak_bucket_upper_bound(i);
+        }
+    }
+    return 0;
+}
+
+static void soak_monitor_task(void *arg)
+{
+    (void)arg;
+    static uint32_t previous[SOAK_BUCKETS];
+    static uint32_t interval[SOAK_BUCKETS];
+    bool has_baseline = false;
+    size_t baseline_free = 0;
+    uint32_t baseline_p99 = 0;
+
+    actuation_pm_stats_t pm_previous;
+    actuation_pm_stats(&pm_previous);
+    int64_t pm_previous_us = esp_timer_get_time();
+
+    printf("SOAK,uptime_s,free_heap,min_free_heap,largest_free_block,fragmentation_pct,"
+           "samples,p50_us,p99_us,max_us,pm_held_pct,cold_commands,status\n");
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_SOAK_MONITOR_INTERVAL * 1000));
+
+        uint32_t total = 0;
+        for (int i = 0; i < SOAK_BUCKETS; i++)
+        {
+            uint32_t current = __atomic_load_n(&s_buckets[i], __ATOMIC_RELAXED);
+            interval[i] = current - previous[i];
+            previous[i] = current;
+            total += interval[i];
+        }
+        uint32_t max_us = __atomic_exchange_n(&s_interval_max_us, 0, __ATOMIC_RELAXED);
+        uint32_t p50_us = soak_percentile(interval, total, 50);
+        uint32_t p99_us = soak_percentile(interval, total, 99);
+
+        // Share of the interval the power management locks were held, and the
+        // commands that arrived without them, i.e. at reduced clock.
+        actuation_pm_stats_t pm;
+        actuation_pm_stats(&pm);
+        int64_t now_us = esp_timer_get_time();
+        uint32_t pm_held_pct = (uint32_t)((pm.held_us - pm_previous.held_us) * 100 / (now_us - pm_previous_us));
+        uint32_t cold_commands = pm.cold_commands - pm_previous.cold_commands;
+        pm_previous = pm;
+        pm_previous_us = now_us;
+
+        size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+        size_t min_free_heap = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+        size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+        uint32_t fragmentation = free_heap > 0 ? 100 - (uint32_t)(largest_block * 100 / free_heap) : 0;
+
+        const char *status = "ok";
+        if (!has_baseline)
+        {
+            if (total > 0)
+            {
+                has_baseline = true;
+                baseline_free = free_heap;
+                baseline_p99 = p99_us;
+                status = "baseline";
+            }
+            else
+            {
+                status = "warmup";
+            }
+        }
+        else
+        {
+            bool heap_grew = baseline_free > free_heap &&
+                             baseline_free - free_heap > CONFIG_SOAK_HEAP_GROWTH_LIMIT;
+            bool latency_drifted = total > 0 &&
+                                   (uint64_t)p99_us * 100 >
+                                       (uint64_t)baseline_p99 * (100 + CONFIG_SOAK_LATENCY_DRIFT_LIMIT);
+            if (heap_grew || latency_drifted)
+            {
+                __atomic_fetch_add(&s_failures, 1, __ATOMIC_RELAXED);
+                status = heap_grew ? "fail_heap" : "fail_latency";
+            }
+        }
+
+        printf("SOAK,%lld,%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%s\n",
+               (long long)(now_us / 1000000), (unsigned)free_heap, (unsigned)min_free_heap,
+               (unsigned)largest_block, (unsigned long)fragmentation, (unsigned long)total,
+               (unsigned long)p50_us, (unsigned long)p99_us, (unsigned long)max_us,
+               (unsigned long)pm_held_pct, (unsigned long)cold_commands, status);
+        if (strncmp(status, "fail", 4) == 0)
+        {
+            ESP_LOGE(TAG, "Soak threshold exceeded (%s), %lu failed sample(s) so far.", status,
+                     (unsigned long)soak_failures());
+        }
+    }
+}
+
+uint32_t soak_failures(void)
+{
+    return __atomic_load_n(&s_failures, __ATOMIC_RELAXED);
+}
+
+void soak_monitor_start(void)
+{
+    xTaskCreate(soak_monitor_task, "soak_monitor", 3072, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+#else
+void soak_monitor_start(void)
+{
+}
+
+void soak_record_latency(int64_t latency_us)
+{
+    (void)latency_us;
+}
+
+uint32_t soak_failures(void)
+{
+    return 0;
+}
+#endif
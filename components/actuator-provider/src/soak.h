@@ -0,0 +1,41 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <stdint.h>
+
+/*
+ * Long-running soak monitor.
+ *
+ * Samples heap usage, heap fragmentation and the latency of the subscriber
+ * handler every CONFIG_SOAK_MONITOR_INTERVAL seconds and prints one CSV line per
+ * sample to the console:
+ *
+ *   SOAK,<uptime s>,<free heap>,<min free heap>,<largest free block>,
+ *        <fragmentation %>,<handled samples>,<p50 us>,<p99 us>,<max us>,
+ *        <power management locks held %>,<commands received without them>,<status>
+ *
+ * The first sample after the warm-up interval is the baseline. A sample fails
+ * when the free heap shrank by more than CONFIG_SOAK_HEAP_GROWTH_LIMIT bytes or
+ * the p99 latency grew by more than CONFIG_SOAK_LATENCY_DRIFT_LIMIT percent
+ * against the baseline.
+ */
+void soak_monitor_start(void);
+void soak_record_latency(int64_t latency_us);
+
+// Number of samples that exceeded a limit so far
+uint32_t soak_failures(void);
+
+#endif
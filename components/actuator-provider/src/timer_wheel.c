@@ -0,0 +1,368 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+#define WHEEL_LEVELS                        4
+#define WHEEL_SLOT_BITS                     6
+#define WHEEL_SLOTS                         (1 << WHEEL_SLOT_BITS)
+#define WHEEL_SLOT_MASK                     (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_TICKS                     ((1u << (WHEEL_LEVELS * WHEEL_SLOT_BITS)) - 1)
+#define WHEEL_TICK_US                       ((int64_t)TIMER_WHEEL_TICK_MS * 1000)
+#define WHEEL_NONE                          0xFFFF
+
+_Static_assert(TIMER_WHEEL_POOL_SIZE < WHEEL_NONE, "timer indices are 16 bit");
+
+static const char *TAG = "TIMER_WHEEL";
+
+typedef struct
+{
+    uint32_t expires;       // tick the timer expires at
+    uint16_t next;
+    uint16_t prev;
+    uint16_t slot;          // slot the timer is linked into, WHEEL_NONE if it is free
+    uint16_t generation;    // distinguishes handles of successive uses of the entry
+    timer_callback_t callback;
+    void *arg;
+} timer_entry_t;
+
+typedef struct
+{
+    timer_callback_t callback;
+    void *arg;
+} timer_expired_t;
+
+static timer_entry_t s_pool[TIMER_WHEEL_POOL_SIZE];
+static uint16_t s_slots[WHEEL_LEVELS * WHEEL_SLOTS];
+static uint64_t s_occupied[WHEEL_LEVELS]; // bit per non-empty slot
+static uint16_t s_free;
+static uint32_t s_tick;     // last processed tick
+static uint32_t s_pending;
+static uint32_t s_wake_tick; // tick the hardware timer is armed for
+static bool s_armed = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t s_hw_timer;
+static TaskHandle_t s_timer_task;
+
+// Worst-case time from a tick being due to the callbacks of its timers running
+static int64_t s_worst_tick_latency_us = 0;
+
+static inline uint32_t timer_wheel_now_tick(void)
+{
+    return (uint32_t)(esp_timer_get_time() / WHEEL_TICK_US);
+}
+
+static void timer_wheel_link(uint16_t index)
+{
+    timer_entry_t *entry = &s_pool[index];
+    uint32_t delta = entry->expires - s_tick;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1u << ((level + 1) * WHEEL_SLOT_BITS)))
+    {
+        level++;
+    }
+    uint16_t slot = level * WHEEL_SLOTS + ((entry->expires >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK);
+
+    entry->slot = slot;
+    entry->prev = WHEEL_NONE;
+    entry->next = s_slots[slot];
+    if (entry->next != WHEEL_NONE)
+    {
+        s_pool[entry->next].prev = index;
+    }
+    s_slots[slot] = index;
+    s_occupied[level] |= 1ULL << (slot & WHEEL_SLOT_MASK);
+}
+
+// Empties a slot and returns its first timer.
+static uint16_t timer_wheel_take(uint16_t slot)
+{
+    uint16_t index = s_slots[slot];
+    s_slots[slot] = WHEEL_NONE;
+    s_occupied[slot / WHEEL_SLOTS] &= ~(1ULL << (slot & WHEEL_SLOT_MASK));
+    return index;
+}
+
+static void timer_wheel_unlink(uint16_t index)
+{
+    timer_entry_t *entry = &s_pool[index];
+    if (entry->prev != WHEEL_NONE)
+    {
+        s_pool[entry->prev].next = entry->next;
+    }
+    else
+    {
+        s_slots[entry->slot] = entry->next;
+        if (entry->next == WHEEL_NONE)
+        {
+            s_occupied[entry->slot / WHEEL_SLOTS] &= ~(1ULL << (entry->slot & WHEEL_SLOT_MASK));
+        }
+    }
+    if (entry->next != WHEEL_NONE)
+    {
+        s_pool[entry->next].prev = entry->prev;
+    }
+}
+
+static void timer_wheel_release(uint16_t index)
+{
+    s_pool[index].slot = WHEEL_NONE;
+    s_pool[index].next = s_free;
+    s_free = index;
+    s_pending--;
+}
+
+// Moves the timers of the higher level slots that start with this tick down the wheel.
+static void timer_wheel_cascade(uint32_t tick)
+{
+    for (int level = 1; level < WHEEL_LEVELS; level++)
+    {
+        int shift = level * WHEEL_SLOT_BITS;
+        if ((tick & ((1u << shift) - 1)) != 0)
+        {
+            break;
+        }
+        uint16_t index = timer_wheel_take(level * WHEEL_SLOTS + ((tick >> shift) & WHEEL_SLOT_MASK));
+        while (index != WHEEL_NONE)
+        {
+            uint16_t next = s_pool[index].next;
+            timer_wheel_link(index);
+            index = next;
+        }
+    }
+}
+
+/*
+ * Returns the next tick after s_tick the wheel has work at: the next occupied
+ * slot of level 0, or the start of the next occupied slot of a higher level,
+ * where its timers cascade down. Requires pending timers.
+ */
+static uint32_t timer_wheel_next_tick(void)
+{
+    uint32_t next_delta = UINT32_MAX;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        uint64_t occupied = s_occupied[level];
+        if (occupied == 0)
+        {
+            continue;
+        }
+        int shift = level * WHEEL_SLOT_BITS;
+        uint32_t block = s_tick >> shift;
+        // Slots are searched from the one after the current block; the current one comes last, a full turn ahead.
+        int start = (block + 1) & WHEEL_SLOT_MASK;
+        uint64_t rotated = start == 0 ? occupied : occupied >> start | occupied << (WHEEL_SLOTS - start);
+        uint32_t blocks = 1 + (uint32_t)__builtin_ctzll(rotated);
+        uint32_t delta = ((block + blocks) << shift) - s_tick;
+        next_delta = delta < next_delta ? delta : next_delta;
+    }
+    return s_tick + next_delta;
+}
+
+timer_handle_t timer_wheel_schedule(uint32_t delay_ms, timer_callback_t callback, void *arg)
+{
+    // Rounding the due time up to a tick boundary ensures no timer fires early.
+    int64_t due_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    uint32_t expires = (uint32_t)((due_us + WHEEL_TICK_US - 1) / WHEEL_TICK_US);
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_free == WHEEL_NONE)
+    {
+        portEXIT_CRITICAL(&s_lock);
+        return TIMER_INVALID;
+    }
+    uint16_t index = s_free;
+    timer_entry_t *entry = &s_pool[index];
+    s_free = entry->next;
+
+    if (s_pending++ == 0)
+    {
+        // The wheel does not advance while idle, catch up in one step.
+        s_tick = timer_wheel_now_tick();
+    }
+    int32_t ticks = (int32_t)(expires - s_tick);
+    if (ticks < 1)
+    {
+        expires = s_tick + 1;
+    }
+    else if ((uint32_t)ticks > WHEEL_MAX_TICKS)
+    {
+        expires = s_tick + WHEEL_MAX_TICKS;
+    }
+    entry->generation = entry->generation == UINT16_MAX ? 1 : entry->generation + 1;
+    entry->expires = expires;
+    entry->callback = callback;
+    entry->arg = arg;
+    timer_wheel_link(index);
+    timer_handle_t handle = ((uint32_t)entry->generation << 16) | index;
+    // The timer wheel task sleeps until the next occupied slot, wake it to re-arm for an earlier one.
+    bool earlier = !s_armed || (int32_t)(expires - s_wake_tick) < 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (earlier)
+    {
+        xTaskNotifyGive(s_timer_task);
+    }
+    return handle;
+}
+
+bool timer_wheel_cancel(timer_handle_t handle)
+{
+    uint16_t index = handle & 0xFFFF;
+    uint16_t generation = handle >> 16;
+    bool cancelled = false;
+
+    if (handle == TIMER_INVALID || index >= TIMER_WHEEL_POOL_SIZE)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (s_pool[index].generation == generation && s_pool[index].slot != WHEEL_NONE)
+    {
+        timer_wheel_unlink(index);
+        timer_wheel_release(index);
+        cancelled = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return cancelled;
+}
+
+/*
+ * Advances the wheel to the current tick and collects the expired timers. The
+ * wheel jumps from one occupied slot to the next, ticks without work are not
+ * visited. Returns the number of timers stored in the batch.
+ */
+static int timer_wheel_advance(timer_expired_t *batch, int64_t *due_us)
+{
+    int count = 0;
+    uint32_t now_tick = timer_wheel_now_tick();
+
+    portENTER_CRITICAL(&s_lock);
+    while (s_pending > 0)
+    {
+        uint32_t next_tick = timer_wheel_next_tick();
+        if ((int32_t)(now_tick - next_tick) < 0)
+        {
+            // Nothing due before next_tick, so no slot is skipped.
+            s_tick = now_tick;
+            break;
+        }
+        s_tick = next_tick;
+        timer_wheel_cascade(s_tick);
+
+        uint16_t index = timer_wheel_take(s_tick & WHEEL_SLOT_MASK);
+        if (index != WHEEL_NONE && count == 0)
+        {
+            *due_us = (int64_t)s_tick * WHEEL_TICK_US;
+        }
+        while (index != WHEEL_NONE)
+        {
+            uint16_t next = s_pool[index].next;
+            batch[count].callback = s_pool[index].callback;
+            batch[count].arg = s_pool[index].arg;
+            count++;
+            timer_wheel_release(index);
+            index = next;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+// Arms the hardware timer for the next tick with work, or leaves it off while the wheel is empty.
+static void timer_wheel_arm(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_armed = s_pending > 0;
+    if (s_armed)
+    {
+        s_wake_tick = timer_wheel_next_tick();
+    }
+    uint32_t wake_tick = s_wake_tick;
+    bool armed = s_armed;
+    portEXIT_CRITICAL(&s_lock);
+
+    esp_timer_stop(s_hw_timer);
+    if (armed)
+    {
+        int64_t now_us = esp_timer_get_time();
+        int64_t delay_us = (int64_t)(int32_t)(wake_tick - (uint32_t)(now_us / WHEEL_TICK_US)) * WHEEL_TICK_US -
+                           now_us % WHEEL_TICK_US;
+        esp_timer_start_once(s_hw_timer, delay_us > 0 ? (uint64_t)delay_us : 0);
+    }
+}
+
+static void timer_wheel_task(void *arg)
+{
+    (void)arg;
+    static timer_expired_t batch[TIMER_WHEEL_POOL_SIZE];
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int64_t due_us = 0;
+        int count = timer_wheel_advance(batch, &due_us);
+        for (int i = 0; i < count; i++)
+        {
+            batch[i].callback(batch[i].arg);
+        }
+        if (count > 0)
+        {
+            int64_t latency_us = esp_timer_get_time() - due_us;
+            if (latency_us > s_worst_tick_latency_us)
+            {
+                s_worst_tick_latency_us = latency_us;
+                ESP_LOGI(TAG, "New worst-case tick latency: %lld us (%d timer(s) in the batch)",
+                         (long long)latency_us, count);
+            }
+        }
+
+        // The hardware timer only runs while timers are pending, and only for ticks with work.
+        timer_wheel_arm();
+    }
+}
+
+static void timer_wheel_tick(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_timer_task);
+}
+
+void timer_wheel_start(void)
+{
+    for (uint16_t i = 0; i < TIMER_WHEEL_POOL_SIZE; i++)
+    {
+        s_pool[i].slot = WHEEL_NONE;
+        s_pool[i].next = i + 1 < TIMER_WHEEL_POOL_SIZE ? i + 1 : WHEEL_NONE;
+    }
+    s_free = 0;
+    for (int i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++)
+    {
+        s_slots[i] = WHEEL_NONE;
+    }
+
+    esp_timer_create_args_t args = {
+        .callback = timer_wheel_tick,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_wheel",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_hw_timer));
+    xTaskCreate(timer_wheel_task, "timer_wheel", 3072, NULL, configMAX_PRIORITIES - 2, &s_timer_task);
+}
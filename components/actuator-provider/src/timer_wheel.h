@@ -0,0 +1,47 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel for the deadlines of the actuation path.
+ *
+ * All timers come from a fixed pool of TIMER_WHEEL_POOL_SIZE entries and are
+ * kept in four levels of 64 slots each, with a resolution of
+ * TIMER_WHEEL_TICK_MS. Scheduling and cancelling a timer are O(1). A single
+ * one-shot esp_timer wakes the timer wheel task ("timer_wheel") at the next
+ * tick with work, found through a bitmap of occupied slots per level, and not
+ * at all when the wheel is empty. The timer wheel task runs the callbacks of
+ * all timers expired by then as one batch, so callbacks run in that task, not
+ * in the task that scheduled them, and must only take short locks.
+ */
+typedef void (*timer_callback_t)(void *arg);
+
+// Identifies a scheduled timer. Handles of expired or cancelled timers stay invalid.
+typedef uint32_t timer_handle_t;
+
+#define TIMER_INVALID                       0
+
+void timer_wheel_start(void);
+
+// Schedules the callback after the delay. Returns TIMER_INVALID if the pool is exhausted.
+timer_handle_t timer_wheel_schedule(uint32_t delay_ms, timer_callback_t callback, void *arg);
+
+// Cancels a pending timer. Returns false if it already expired or was cancelled.
+bool timer_wheel_cancel(timer_handle_t handle);
+
+#endif
@@ -0,0 +1,313 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#include <esp_random.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "pb.h"
+#include "uprotocol.h"
+
+#define UP_ATTRIBUTES_VERSION               1
+
+static uint16_t s_uuid_counter;
+static uint64_t s_uuid_last_ms;
+
+static int up_uri_segments(char *buf, size_t size, const up_uri_t *uri)
+{
+    if (uri == NULL)
+    {
+        return snprintf(buf, size, "{}/{}/{}/{}/{}");
+    }
+    return snprintf(buf, size, "%s/%X/%X/%X/%X", uri->authority,
+                    (unsigned)(uri->ue_id & 0xFFFF), (unsigned)(uri->ue_id >> 16),
+                    (unsigned)uri->ue_version_major, (unsigned)uri->resource_id);
+}
+
+int up_keyexpr(char *buf, size_t size, const up_uri_t *source, const up_uri_t *sink)
+{
+    int len = snprintf(buf, size, "up/");
+    if (len < 0 || (size_t)len >= size)
+    {
+        return -1;
+    }
+    int written = up_uri_segments(buf + len, size - len, source);
+    if (written < 0 || (size_t)(len += written) >= size - 1)
+    {
+        return -1;
+    }
+    buf[len++] = '/';
+    written = up_uri_segments(buf + len, size - len, sink);
+    if (written < 0 || (size_t)(len + written) >= size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int up_request_keyexpr(char *buf, size_t size, const up_uri_t *method)
+{
+    int len = snprintf(buf, size, "up/*/*/*/*/*/");
+    if (len < 0 || (size_t)len >= size)
+    {
+        return -1;
+    }
+    int written = up_uri_segments(buf + len, size - len, method);
+    return written < 0 || (size_t)(len + written) >= size ? -1 : 0;
+}
+
+up_uuid_t up_uuid_new(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t time_ms = (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+
+    // The counter keeps ids created within the same millisecond ordered.
+    if (time_ms == s_uuid_last_ms)
+    {
+        s_uuid_counter = (s_uuid_counter + 1) & 0x0FFF;
+    }
+    else
+    {
+        s_uuid_last_ms = time_ms;
+        s_uuid_counter = 0;
+    }
+
+    uint64_t random = ((uint64_t)esp_random() << 32) | esp_random();
+    up_uuid_t uuid = {
+        .msb = ((time_ms & 0xFFFFFFFFFFFFULL) << 16) | (0x8ULL << 12) | s_uuid_counter,
+        .lsb = (random & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL,
+    };
+    return uuid;
+}
+
+uint64_t up_uuid_time_ms(const up_uuid_t *uuid)
+{
+    return uuid->msb >> 16;
+}
+
+static bool up_write_uuid(pb_writer_t *writer, uint32_t number, const up_uuid_t *uuid)
+{
+    uint8_t buf[24];
+    pb_writer_t nested;
+    pb_writer_init(&nested, buf, sizeof(buf));
+    pb_write_fixed64(&nested, 1, uuid->msb);
+    pb_write_fixed64(&nested, 2, uuid->lsb);
+    pb_write_bytes(writer, number, buf, nested.len);
+    return !nested.overflow;
+}
+
+static bool up_write_uri(pb_writer_t *writer, uint32_t number, const up_uri_t *uri)
+{
+    uint8_t buf[UP_KEYEXPR_MAX_LEN];
+    pb_writer_t nested;
+    pb_writer_init(&nested, buf, sizeof(buf));
+    if (uri->authority != NULL && uri->authority[0] != '\0')
+    {
+        pb_write_string(&nested, 1, uri->authority);
+    }
+    if (uri->ue_id != 0)
+    {
+        pb_write_varint(&nested, 2, uri->ue_id);
+    }
+    if (uri->ue_version_major != 0)
+    {
+        pb_write_varint(&nested, 3, uri->ue_version_major);
+    }
+    if (uri->resource_id != 0)
+    {
+        pb_write_varint(&nested, 4, uri->resource_id);
+    }
+    pb_write_bytes(writer, number, buf, nested.len);
+    return !nested.overflow;
+}
+
+size_t up_attributes_encode(const up_attributes_t *attributes, uint8_t *buf, size_t size)
+{
+    pb_writer_t writer;
+    pb_writer_init(&writer, buf, size);
+    bool ok = up_write_uuid(&writer, 1, &attributes->id);
+    pb_write_varint(&writer, 2, attributes->type);
+    ok = ok && up_write_uri(&writer, 3, attributes->source);
+    if (attributes->sink != NULL)
+    {
+        ok = ok && up_write_uri(&writer, 4, attributes->sink);
+    }
+    if (attributes->priority != 0)
+    {
+        pb_write_varint(&writer, 5, attributes->priority);
+    }
+    if (attributes->ttl_ms != 0)
+    {
+        pb_write_varint(&writer, 6, attributes->ttl_ms);
+    }
+    if (attributes->reqid != NULL)
+    {
+        ok = ok && up_write_uuid(&writer, 9, attributes->reqid);
+    }
+    if (attributes->payload_format != 0)
+    {
+        pb_write_varint(&writer, 12, attributes->payload_format);
+    }
+    return ok && !writer.overflow ? writer.len : 0;
+}
+
+static int8_t up_attachment_iterate(const void *data, z_attachment_iter_body_t body, void *ctx)
+{
+    // Both entries use an empty key, so a bytes map (keyed by value) cannot hold them.
+    static const uint8_t version = UP_ATTRIBUTES_VERSION;
+    const up_attachment_t *storage = data;
+    int8_t ret = body(_z_bytes_wrap(NULL, 0), _z_bytes_wrap(&version, 1), ctx);
+    if (ret == 0)
+    {
+        ret = body(_z_bytes_wrap(NULL, 0), _z_bytes_wrap(storage->buf, storage->len), ctx);
+    }
+    return ret;
+}
+
+z_attachment_t up_attachment(up_attachment_t *storage, const up_attributes_t *attributes)
+{
+    storage->len = up_attributes_encode(attributes, storage->buf, sizeof(storage->buf));
+    z_attachment_t attachment = {.data = storage, .iteration_driver = up_attachment_iterate};
+    return attachment;
+}
+
+static bool up_read_uuid(const uint8_t *buf, size_t len, up_uuid_t *uuid)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    pb_reader_init(&reader, buf, len);
+    while (pb_read_field(&reader, &field))
+    {
+        if (field.number == 1 && field.wire_type == PB_WIRE_FIXED64)
+        {
+            uuid->msb = field.value;
+        }
+        else if (field.number == 2 && field.wire_type == PB_WIRE_FIXED64)
+        {
+            uuid->lsb = field.value;
+        }
+    }
+    return pb_reader_done(&reader);
+}
+
+static bool up_read_uri(const uint8_t *buf, size_t len, up_uri_t *uri, char *authority)
+{
+    pb_reader_t reader;
+    pb_field_t field;
+    pb_reader_init(&reader, buf, len);
+    authority[0] = '\0';
+    uri->authority = authority;
+    while (pb_read_field(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case 1:
+            if (field.wire_type != PB_WIRE_LEN || field.data_len >= UP_AUTHORITY_MAX_LEN)
+            {
+                return false;
+            }
+            memcpy(authority, field.data, field.data_len);
+            authority[field.data_len] = '\0';
+            break;
+        case 2:
+            uri->ue_id = (uint32_t)field.value;
+            break;
+        case 3:
+            uri->ue_version_major = (uint8_t)field.value;
+            break;
+        case 4:
+            uri->resource_id = (uint16_t)field.value;
+            break;
+        default:
+            break;
+        }
+    }
+    return pb_reader_done(&reader);
+}
+
+typedef struct
+{
+    int index;
+    z_bytes_t attributes;
+} up_attachment_entries_t;
+
+static int8_t up_attachment_entry(z_bytes_t key, z_bytes_t value, void *ctx)
+{
+    (void)key;
+    up_attachment_entries_t *entries = ctx;
+    if (entries->index == 0 && (value.len != 1 || value.start[0] != UP_ATTRIBUTES_VERSION))
+    {
+        return -1;
+    }
+    if (entries->index == 1)
+    {
+        entries->attributes = value;
+    }
+    entries->index++;
+    return 0;
+}
+
+int up_attachment_parse(z_attachment_t attachment, up_received_t *message)
+{
+    up_attachment_entries_t entries = {.index = 0};
+    memset(message, 0, sizeof(*message));
+    message->source.authority = message->source_authority;
+    message->sink.authority = message->sink_authority;
+    if (!z_attachment_check(&attachment) ||
+        z_attachment_iterate(attachment, up_attachment_entry, &entries) != 0 || entries.index != 2)
+    {
+        return -1;
+    }
+
+    pb_reader_t reader;
+    pb_field_t field;
+    pb_reader_init(&reader, entries.attributes.start, entries.attributes.len);
+    while (pb_read_field(&reader, &field))
+    {
+        bool ok = true;
+        switch (field.number)
+        {
+        case 1:
+            ok = field.wire_type == PB_WIRE_LEN && up_read_uuid(field.data, field.data_len, &message->id);
+            break;
+        case 2:
+            message->type = (uint8_t)field.value;
+            break;
+        case 3:
+            ok = field.wire_type == PB_WIRE_LEN &&
+                 up_read_uri(field.data, field.data_len, &message->source, message->source_authority);
+            break;
+        case 4:
+            ok = field.wire_type == PB_WIRE_LEN &&
+                 up_read_uri(field.data, field.data_len, &message->sink, message->sink_authority);
+            break;
+        case 5:
+            message->priority = (uint8_t)field.value;
+            break;
+        case 6:
+            message->ttl_ms = (uint32_t)field.value;
+            break;
+        case 12:
+            message->payload_format = (uint8_t)field.value;
+            break;
+        default:
+            break;
+        }
+        if (!ok)
+        {
+            return -1;
+        }
+    }
+    return pb_reader_done(&reader) ? 0 : -1;
+}
@@ -0,0 +1,119 @@
+/********************************************************************************
+ * Copyright (c) 2024 Contributors to the Eclipse Foundation
+ *
+ * See the NOTICE file(s) distributed with this work for additional
+ * information regarding copyright ownership.
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Apache License 2.0 which is available at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ ********************************************************************************/
+
+#ifndef UPROTOCOL_H
+#define UPROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zenoh-pico.h>
+
+/*
+ * The subset of uProtocol needed to talk to uEntities over Zenoh without the
+ * horn service in between: Zenoh key expressions for UUris, UUIDv8 message ids
+ * and UAttributes serialization. Everything works on static or caller
+ * provided buffers.
+ */
+#define UP_MESSAGE_TYPE_PUBLISH             1
+#define UP_MESSAGE_TYPE_REQUEST             2
+#define UP_MESSAGE_TYPE_RESPONSE            3
+
+#define UP_PRIORITY_CS1                     2
+#define UP_PRIORITY_CS4                     5
+
+#define UP_PAYLOAD_FORMAT_UNSPECIFIED       0
+#define UP_PAYLOAD_FORMAT_PROTOBUF_WRAPPED_IN_ANY 1
+#define UP_PAYLOAD_FORMAT_PROTOBUF          2
+
+#define UP_ATTRIBUTES_MAX_LEN               192
+#define UP_KEYEXPR_MAX_LEN                  128
+#define UP_AUTHORITY_MAX_LEN                64
+
+typedef struct
+{
+    const char *authority;
+    uint32_t ue_id;
+    uint8_t ue_version_major;
+    uint16_t resource_id;
+} up_uri_t;
+
+typedef struct
+{
+    uint64_t msb;
+    uint64_t lsb;
+} up_uuid_t;
+
+typedef struct
+{
+    up_uuid_t id;
+    uint8_t type;
+    const up_uri_t *source;
+    const up_uri_t *sink;       // NULL for publications
+    uint8_t priority;
+    uint32_t ttl_ms;            // 0 if the message does not expire
+    const up_uuid_t *reqid;     // responses only
+    uint8_t payload_format;
+} up_attributes_t;
+
+typedef struct
+{
+    uint8_t buf[UP_ATTRIBUTES_MAX_LEN];
+    size_t len;
+} up_attachment_t;
+
+// Attributes of a received message. The URIs refer to the authority buffers.
+typedef struct
+{
+    up_uuid_t id;
+    uint8_t type;
+    up_uri_t source;
+    up_uri_t sink;
+    uint8_t priority;
+    uint32_t ttl_ms;
+    uint8_t payload_format;
+    char source_authority[UP_AUTHORITY_MAX_LEN];
+    char sink_authority[UP_AUTHORITY_MAX_LEN];
+} up_received_t;
+
+/*
+ * Writes the Zenoh key expression of a message from source to sink, with
+ * "{}" segments for a missing sink, e.g.
+ * "up/horn-service-kuksa/1C/0/1/8000/{}/{}/{}/{}/{}".
+ */
+int up_keyexpr(char *buf, size_t size, const up_uri_t *source, const up_uri_t *sink);
+
+// Writes the key expression that matches requests from any source to the given method.
+int up_request_keyexpr(char *buf, size_t size, const up_uri_t *method);
+
+// Creates a UUIDv8 message id from the wall clock, a counter and random bits.
+up_uuid_t up_uuid_new(void);
+
+// Milliseconds since the Unix epoch encoded in a UUIDv8 message id.
+uint64_t up_uuid_time_ms(const up_uuid_t *uuid);
+
+// Serializes the attributes. Returns the length or 0 if the buffer is too small.
+size_t up_attributes_encode(const up_attributes_t *attributes, uint8_t *buf, size_t size);
+
+/*
+ * Builds the Zenoh attachment carrying the attributes of a message: two
+ * entries with empty keys, the attributes version and the serialized
+ * attributes, as up-transport-zenoh expects them. The attachment refers to
+ * the storage, which must outlive the put or reply it is passed to.
+ */
+z_attachment_t up_attachment(up_attachment_t *storage, const up_attributes_t *attributes);
+
+// Reads the attributes from the attachment of a received message. Returns 0 on success.
+int up_attachment_parse(z_attachment_t attachment, up_received_t *message);
+
+#endif
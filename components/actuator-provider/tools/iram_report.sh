@@ -0,0 +1,93 @@
+#!/bin/sh
+#*******************************************************************************
+# Copyright (c) 2024 Contributors to the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# This program and the accompanying materials are made available under the
+# terms of the Eclipse Public License 2.0 which is available at
+# http://www.eclipse.org/legal/epl-2.0
+#
+# SPDX-License-Identifier: EPL-2.0
+#*******************************************************************************
+
+# Reports where the actuation path of a provider build was placed and what it
+# costs in IRAM. Run it on the ELF of a build with and without
+# CONFIG_ACTUATION_IN_IRAM, e.g.
+#
+#   tools/iram_report.sh .pio/build/upesy_wroom/firmware.elf
+#   tools/iram_report.sh build/esp-zenoh-client.elf
+#
+# For every function of the path it prints its memory (IRAM, flash or ROM), its
+# size and the functions in flash it calls directly. Those are the places a
+# flash cache miss can still delay the path. Addresses are the ESP32 ones,
+# other chips need IRAM_START/IRAM_END/FLASH_START set accordingly.
+
+set -e
+
+# Portable hexadecimal parsing, mawk and busybox awk lack strtonum().
+HEX='function hex(s,  i, v) { s = tolower(s); sub(/^0x/, "", s); v = 0
+    for (i = 1; i <= length(s); i++) v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+    return v }'
+
+ELF=$1
+PREFIX=${TOOLCHAIN_PREFIX-xtensa-esp32-elf-}
+IRAM_START=${IRAM_START:-0x40070000}
+IRAM_END=${IRAM_END:-0x400c0000}
+FLASH_START=${FLASH_START:-0x400c2000}
+
+FUNCTIONS="sample_handler attachment_handler bytes_equal sample_deadline deadline_parse deadline_expired
+signal_current signal_set_target signal_set_current signal_acked history_record turn_led actuation_pm_command
+actuation_pm_output actuation_pm_hold actuation_pm_count_command pub_status consumers_present consumers_present_at
+output_owner"
+
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+    echo "usage: $0 <firmware.elf>" >&2
+    exit 1
+fi
+
+echo "Sections:"
+"${PREFIX}size" -A "$ELF" | awk '$1 ~ /^\.iram0\.|^\.dram0\./ { printf "  %-20s %8d bytes\n", $1, $2 }'
+
+SYMBOLS=$(mktemp)
+trap 'rm -f "$SYMBOLS"' EXIT
+"${PREFIX}nm" -S --defined-only "$ELF" > "$SYMBOLS"
+
+memory_of() {
+    awk -v a="$1" -v is="$IRAM_START" -v ie="$IRAM_END" -v fs="$FLASH_START" "$HEX"'
+    BEGIN {
+        a = hex(a); is = hex(is); ie = hex(ie); fs = hex(fs)
+        if (a >= is && a < ie) print "IRAM"; else if (a >= fs) print "flash"; else print "ROM"
+    }'
+}
+
+echo
+echo "Actuation path:"
+total=0
+for function in $FUNCTIONS; do
+    line=$(awk -v f="$function" '$4 == f && ($3 == "T" || $3 == "t") { print; exit }' "$SYMBOLS")
+    if [ -z "$line" ]; then
+        printf "  %-28s inlined or not built\n" "$function"
+        continue
+    fi
+    address=$(echo "$line" | awk '{ print $1 }')
+    size=$(echo "$line" | awk '{ print $2 }')
+    size=$((0x$size))
+    memory=$(memory_of "$address")
+    if [ "$memory" = "IRAM" ]; then
+        total=$((total + size))
+    fi
+
+    # Direct calls into flash; callx through a register is listed as indirect.
+    callees=$("${PREFIX}objdump" -d --start-address=0x"$address" --stop-address=$((0x$address + size)) "$ELF" |
+        awk -v fs="$FLASH_START" "$HEX"'
+            $0 ~ /\tcall[0-9]+\t/ { split($0, parts, "\t"); target = parts[4]; sub(/ .*/, "", target)
+                                   name = $0; sub(/.*</, "", name); sub(/>.*/, "", name)
+                                   if (hex(target) >= hex(fs)) flash[name] = 1 }
+            $0 ~ /\tcallx[0-9]+\t/ { indirect = 1 }
+            END { for (n in flash) printf "%s ", n; if (indirect) printf "(indirect) " }')
+    printf "  %-28s %-5s %6d bytes  %s\n" "$function" "$memory" "$size" "${callees:+calls into flash: $callees}"
+done
+echo
+echo "IRAM used by the actuation path: $total bytes"
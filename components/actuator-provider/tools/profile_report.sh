@@ -0,0 +1,104 @@
+#!/bin/sh
+#*******************************************************************************
+# Copyright (c) 2024 Contributors to the Eclipse Foundation
+#
+# See the NOTICE file(s) distributed with this work for additional
+# information regarding copyright ownership.
+#
+# This program and the accompanying materials are made available under the
+# terms of the Eclipse Public License 2.0 which is available at
+# http://www.eclipse.org/legal/epl-2.0
+#
+# SPDX-License-Identifier: EPL-2.0
+#*******************************************************************************
+
+
+# Compares the default and the minimal zenoh-pico profile of the provider.
+# Build both PlatformIO environments first:
+#
+#   platformio run -e upesy_wroom -e upesy_wroom_minimal
+#   tools/profile_report.sh [default.log minimal.log]
+#
+# From the builds it prints the image size, which is what the app takes in
+# flash, and the static RAM of the firmware. Peak heap use and time-to-session
+# are only known on the device: given a serial log of each profile, e.g.
+# captured with "platformio device monitor -e <env> | tee default.log" over a
+# few restarts, it averages the "Session established" lines of each.
+# DEFAULT_BUILD and MINIMAL_BUILD override the build directories.
+
+set -e
+
+PREFIX=${TOOLCHAIN_PREFIX-xtensa-esp32-elf-}
+DEFAULT_BUILD=${DEFAULT_BUILD:-.pio/build/upesy_wroom}
+MINIMAL_BUILD=${MINIMAL_BUILD:-.pio/build/upesy_wroom_minimal}
+
+if [ $# -ne 0 ] && [ $# -ne 2 ]; then
+    echo "usage: $0 [default.log minimal.log]" >&2
+    exit 1
+fi
+for build in "$DEFAULT_BUILD" "$MINIMAL_BUILD"; do
+    if [ ! -f "$build/firmware.elf" ] || [ ! -f "$build/firmware.bin" ]; then
+        echo "$build/firmware.elf or firmware.bin missing, build both environments first." >&2
+        exit 1
+    fi
+done
+
+# Prints "<image bytes> <static DRAM bytes> <IRAM bytes>" of a build.
+footprint() {
+    image=$(wc -c < "$1/firmware.bin")
+    "${PREFIX}size" -A "$1/firmware.elf" | awk -v image="$image" '
+        $1 ~ /^\.dram0\./ { dram += $2 }
+        $1 ~ /^\.iram0\./ { iram += $2 }
+        END { printf "%d %d %d\n", image, dram, iram }'
+}
+
+# Prints "<boots> <mean ms to session> <mean ms after boot> <max peak heap bytes>" of a serial log.
+boots() {
+    awk '/Session established after/ {
+            line = $0
+            sub(/.*Session established after /, "", line); split(line, f, " ")
+            session += f[1]
+            sub(/[^(]*\(/, "", line); split(line, g, " ")
+            boot += g[1]
+            sub(/.*peak heap use /, "", line); split(line, h, " ")
+            if (h[1] + 0 > heap) heap = h[1] + 0
+            count++
+        }
+        END { if (count) printf "%d %.0f %.0f %d\n", count, session / count, boot / count, heap; else print "0 0 0 0" }' "$1"
+}
+
+row() {
+    printf "  %-28s %12s %12s %12s\n" "$1" "$2" "$3" "$4"
+}
+
+DEFAULT_LOG=${1:-}
+MINIMAL_LOG=${2:-}
+
+read -r d_image d_dram d_iram <<FOOTPRINT
+$(footprint "$DEFAULT_BUILD")
+FOOTPRINT
+read -r m_image m_dram m_iram <<FOOTPRINT
+$(footprint "$MINIMAL_BUILD")
+FOOTPRINT
+
+row "" "default" "minimal" "difference"
+row "flash (image bytes)" "$d_image" "$m_image" "$((m_image - d_image))"
+row "static DRAM (bytes)" "$d_dram" "$m_dram" "$((m_dram - d_dram))"
+row "IRAM (bytes)" "$d_iram" "$m_iram" "$((m_iram - d_iram))"
+
+if [ -n "$DEFAULT_LOG" ]; then
+    read -r d_boots d_session d_after d_heap <<BOOTS
+$(boots "$DEFAULT_LOG")
+BOOTS
+    read -r m_boots m_session m_after m_heap <<BOOTS
+$(boots "$MINIMAL_LOG")
+BOOTS
+    if [ "$d_boots" -eq 0 ] || [ "$m_boots" -eq 0 ]; then
+        echo "No \"Session established\" line in one of the logs." >&2
+        exit 1
+    fi
+    row "boots in the log" "$d_boots" "$m_boots" ""
+    row "peak heap use (bytes, max)" "$d_heap" "$m_heap" "$((m_heap - d_heap))"
+    row "time to session (ms, mean)" "$d_session" "$m_session" "$((m_session - d_session))"
+    row "session after boot (ms, mean)" "$d_after" "$m_after" "$((m_after - d_after))"
+fi
@@ -0,0 +1,159 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use clap::Parser;
+use env_logger::Env;
+use log::{error, info};
+use std::path::PathBuf;
+use std::time::{Duration, Instant};
+use zenoh::qos::CongestionControl;
+use zenoh::Config;
+
+// Fragment kinds and header layout as expected by the actuator provider (see src/ota.h)
+const OTA_FRAGMENT_BEGIN: u8 = 0x01;
+const OTA_FRAGMENT_DATA: u8 = 0x02;
+const OTA_FRAGMENT_END: u8 = 0x03;
+const OTA_FRAGMENT_BEGIN_IMAGE: u8 = 0x04;
+const OTA_FRAGMENT_HEADER_SIZE: usize = 8;
+
+#[derive(clap::Parser)]
+pub struct Args {
+    #[arg(short, long, env = "ZENOH_CONFIG")]
+    /// A Zenoh configuration file.
+    config: PathBuf,
+
+    #[arg(short, long, required_unless_present = "full_image")]
+    /// The delta patch to send, including the 64 byte esp_delta_ota header.
+    patch: Option<PathBuf>,
+
+    #[arg(long)]
+    /// The full application image the patch produces. Sent instead of a patch when
+    /// no '--patch' is given, otherwise only used to report the transfer size saved.
+    full_image: Option<PathBuf>,
+
+    #[arg(short, long, default_value = "Vehicle/Body/Horn/Firmware")]
+    /// The key expression the actuator provider receives updates on.
+    key: String,
+
+    #[arg(long, default_value = "768")]
+    /// Patch bytes per fragment. Together with the 8 byte fragment header and the
+    /// Zenoh message overhead a fragment must stay below the Z_FRAG_MAX_SIZE
+    /// (1024 by default) the provider was built with.
+    fragment_size: usize,
+
+    #[arg(long, default_value = "120")]
+    /// Seconds to wait for the provider to report the result of the update.
+    timeout: u64,
+}
+
+impl Args {
+    pub fn get_zenoh_config(&self) -> Result<Config, Box<dyn std::error::Error>> {
+        // Load the config from file path
+        zenoh::config::Config::from_file(&self.config).map_err(|e| e as Box<dyn std::error::Error>)
+    }
+}
+
+fn fragment(kind: u8, value: u32, data: &[u8]) -> Vec<u8> {
+    let mut fragment = Vec::with_capacity(OTA_FRAGMENT_HEADER_SIZE + data.len());
+    fragment.extend_from_slice(&[kind, 0, 0, 0]);
+    fragment.extend_from_slice(&value.to_le_bytes());
+    fragment.extend_from_slice(data);
+    fragment
+}
+
+#[tokio::main]
+async fn main() -> Result<(), Box<dyn std::error::Error>> {
+    env_logger::Builder::from_env(Env::default().default_filter_or("info")).init();
+    let args = Args::parse();
+    let (patch, begin, what) = match (&args.patch, &args.full_image) {
+        (Some(path), _) => (std::fs::read(path)?, OTA_FRAGMENT_BEGIN, "Delta update"),
+        (None, Some(path)) => (std::fs::read(path)?, OTA_FRAGMENT_BEGIN_IMAGE, "Full image update"),
+        (None, None) => unreachable!("clap requires a patch or a full image"),
+    };
+    let patch_size = u32::try_from(patch.len())?;
+
+    let session = zenoh::open(args.get_zenoh_config()?)
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    let status_keyexpr = format!("{}/status", args.key);
+    let status = session
+        .declare_subscriber(&status_keyexpr)
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    // Blocking congestion control makes the provider's flash write speed pace
+    // the transfer instead of dropping fragments.
+    let publisher = session
+        .declare_publisher(&args.key)
+        .congestion_control(CongestionControl::Block)
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+
+    info!("{what}: sending {} bytes to '{}'", patch.len(), &args.key);
+    let started = Instant::now();
+    publisher
+        .put(fragment(begin, patch_size, &[]))
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    let mut offset = 0u32;
+    for chunk in patch.chunks(args.fragment_size) {
+        publisher
+            .put(fragment(OTA_FRAGMENT_DATA, offset, chunk))
+            .await
+            .map_err(|e| e as Box<dyn std::error::Error>)?;
+        offset += chunk.len() as u32;
+    }
+    publisher
+        .put(fragment(OTA_FRAGMENT_END, patch_size, &[]))
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    let sent = started.elapsed();
+    info!("Sent {} fragments in {:?}", patch.len().div_ceil(args.fragment_size), sent);
+
+    let deadline = Duration::from_secs(args.timeout);
+    loop {
+        let remaining = deadline.saturating_sub(started.elapsed());
+        let sample = match tokio::time::timeout(remaining, status.recv_async()).await {
+            Ok(Ok(sample)) => sample,
+            Ok(Err(e)) => return Err(e as Box<dyn std::error::Error>),
+            Err(_) => {
+                error!("The provider did not report the update result within {:?}", deadline);
+                return Err("update timed out".into());
+            }
+        };
+        let message = sample.payload().try_to_string()?.to_string();
+        info!("Provider: {message}");
+        if message.starts_with("error") {
+            return Err(message.into());
+        }
+        if message.starts_with("done") {
+            break;
+        }
+    }
+
+    let elapsed = started.elapsed();
+    info!(
+        "{what}: {} bytes transferred in {:?}, applied after {:?}",
+        patch.len(),
+        sent,
+        elapsed
+    );
+    if let (Some(_), Some(path)) = (&args.patch, &args.full_image) {
+        let full_size = std::fs::metadata(path)?.len();
+        info!(
+            "Full image: {} bytes, {:.1}x the delta transfer; send it with '--full-image' alone to measure its time",
+            full_size,
+            full_size as f64 / patch.len() as f64,
+        );
+    }
+    Ok(())
+}
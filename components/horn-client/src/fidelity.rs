@@ -0,0 +1,532 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use log::{error, info, warn};
+use std::time::{Duration, Instant};
+use up_rust::communication::{CallOptions, RpcClient};
+use zenoh::query::ConsolidationMode;
+use zenoh::Session;
+
+use horn_proto::horn_service::ActivateHornRequest;
+use horn_proto::horn_topics::{HornCycle, HornMode, HornSequence};
+
+use crate::activation_payload;
+
+// The sequence played in every run as (on_time, off_time) in milliseconds. It mixes
+// short and long phases, so both scheduling jitter and accumulated drift show up.
+const FIDELITY_CYCLES: [(u32, u32); 6] = [
+    (100, 100),
+    (200, 300),
+    (50, 50),
+    (100, 200),
+    (500, 250),
+    (20, 80),
+];
+// Time to wait after the end of the sequence before the history is read.
+const SETTLE_TIME: Duration = Duration::from_millis(1000);
+
+// Page format and event kinds of the actuation history, see history.h of the actuator provider.
+const HISTORY_PAGE_VERSION: u8 = 2;
+const HISTORY_PAGE_MORE: u8 = 0x01;
+const HISTORY_APPLIED: u8 = 1;
+const HISTORY_ID_ESCAPE: u64 = 15;
+const SIGNAL_HORN: u64 = 0;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct Edge {
+    time_ms: u64,
+    on: bool,
+}
+
+struct Page {
+    more: bool,
+    next_seq: u64,
+    now_ms: u64,
+    edges: Vec<Edge>,
+}
+
+#[derive(Default)]
+struct Summary {
+    errors: Vec<i64>,
+    drifts: Vec<i64>,
+    start_latencies: Vec<i64>,
+    missing: usize,
+    extra: usize,
+}
+
+// Plays FIDELITY_CYCLES 'runs' times through the horn service and compares the output
+// edges the actuator provider recorded in its actuation history with the requested
+// timing. Each edge's error is relative to the first edge switching the horn on, the
+// drift of a run is the error of its last edge.
+pub async fn fidelity(
+    rpc_client: &dyn RpcClient,
+    activate_horn_uri: up_rust::UUri,
+    session: &Session,
+    history_key: &str,
+    runs: u32,
+    tolerance: Duration,
+    idempotent: bool,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let tolerance_ms = tolerance.as_millis() as i64;
+    let expected = expected_edges();
+    let played = Duration::from_millis(
+        FIDELITY_CYCLES
+            .iter()
+            .map(|(on, off)| (on + off) as u64)
+            .sum(),
+    );
+    let mut summary = Summary::default();
+
+    for run in 1..=runs {
+        // The device clock counts milliseconds since boot. Its reading in the middle of
+        // a query's round trip maps the time the request is sent to the device clock.
+        let queried = Instant::now();
+        let page = query_page(session, &format!("{history_key}?from={}", i64::MAX)).await?;
+        let round_trip = queried.elapsed();
+        let sent = Instant::now();
+        let sent_ms =
+            page.now_ms + (sent - queried).saturating_sub(round_trip / 2).as_millis() as u64;
+
+        let payload = activation_payload(fidelity_request(), idempotent)?;
+        if let Err(e) = rpc_client
+            .invoke_method(
+                activate_horn_uri.clone(),
+                CallOptions::for_rpc_request(1_000, None, None, None),
+                Some(payload),
+            )
+            .await
+        {
+            error!(
+                "Run {run}: the activate horn request returned the error: {:?}",
+                e
+            );
+            continue;
+        }
+        tokio::time::sleep_until((sent + played + SETTLE_TIME).into()).await;
+
+        let edges = query_edges(session, history_key, page.now_ms).await?;
+        let Some(first) = edges.iter().find(|edge| edge.on).copied() else {
+            warn!(
+                "Run {run}: the horn was not switched on, all {} edges missing",
+                expected.len()
+            );
+            summary.missing += expected.len();
+            continue;
+        };
+        let start_latency = first.time_ms as i64 - sent_ms as i64;
+        let (errors, missing, extra) = compare(&expected, &edges, first.time_ms, tolerance_ms);
+        let drift = errors
+            .iter()
+            .rev()
+            .find_map(|error| *error)
+            .unwrap_or_default();
+        for ((offset, on), error) in expected.iter().zip(&errors) {
+            match error {
+                Some(error) => info!(
+                    "Run {run}: {} edge at +{offset} ms off by {error} ms",
+                    if *on { "on" } else { "off" }
+                ),
+                None => warn!(
+                    "Run {run}: {} edge at +{offset} ms missing",
+                    if *on { "on" } else { "off" }
+                ),
+            }
+        }
+        info!(
+            "Run {run}: first edge {start_latency} ms after the request (+/- {:?}), drift {drift} ms, {missing} missing, {extra} extra edge(s)",
+            round_trip / 2
+        );
+
+        summary.errors.extend(errors.into_iter().flatten());
+        summary.drifts.push(drift);
+        summary.start_latencies.push(start_latency);
+        summary.missing += missing;
+        summary.extra += extra;
+    }
+
+    let abs_errors: Vec<i64> = summary.errors.iter().map(|error| error.abs()).collect();
+    info!(
+        "{} run(s), {} of {} edges matched: |error| p50 {} ms, p99 {} ms, max {} ms; drift max {} ms; first edge p50 {} ms; {} missing, {} extra edge(s)",
+        runs,
+        summary.errors.len(),
+        expected.len() * runs as usize,
+        percentile(&abs_errors, 50),
+        percentile(&abs_errors, 99),
+        abs_errors.iter().max().copied().unwrap_or_default(),
+        summary.drifts.iter().map(|drift| drift.abs()).max().unwrap_or_default(),
+        percentile(&summary.start_latencies, 50),
+        summary.missing,
+        summary.extra,
+    );
+    Ok(())
+}
+
+fn fidelity_request() -> ActivateHornRequest {
+    ActivateHornRequest {
+        mode: HornMode::HM_SEQUENCED.into(),
+        command: vec![HornSequence {
+            horn_cycles: FIDELITY_CYCLES
+                .iter()
+                .map(|(on_time, off_time)| HornCycle {
+                    on_time: *on_time,
+                    off_time: *off_time,
+                    ..Default::default()
+                })
+                .collect(),
+            ..Default::default()
+        }],
+        ..Default::default()
+    }
+}
+
+// The requested edges as offsets from the first one switching the horn on.
+fn expected_edges() -> Vec<(u64, bool)> {
+    let mut offset = 0u64;
+    let mut edges = Vec::with_capacity(FIDELITY_CYCLES.len() * 2);
+    for (on_time, off_time) in FIDELITY_CYCLES {
+        edges.push((offset, true));
+        offset += on_time as u64;
+        edges.push((offset, false));
+        offset += off_time as u64;
+    }
+    edges
+}
+
+// Matches the captured edges to the expected ones in order. An expected edge without a
+// captured edge of the same state within the tolerance is missing, captured edges
+// left behind by the expected ones are extra. Returns the error of every expected edge and the counts of
+// missing and extra edges.
+fn compare(
+    expected: &[(u64, bool)],
+    edges: &[Edge],
+    origin_ms: u64,
+    tolerance_ms: i64,
+) -> (Vec<Option<i64>>, usize, usize) {
+    let mut errors = Vec::with_capacity(expected.len());
+    let mut remaining = edges
+        .iter()
+        .skip_while(|edge| edge.time_ms < origin_ms)
+        .peekable();
+    let mut extra = 0;
+    for (offset, on) in expected {
+        let mut matched = None;
+        while let Some(edge) = remaining.peek() {
+            let error = edge.time_ms as i64 - (origin_ms + offset) as i64;
+            if edge.on == *on && error.abs() <= tolerance_ms {
+                matched = Some(error);
+                remaining.next();
+                break;
+            }
+            if error >= -tolerance_ms {
+                break;
+            }
+            extra += 1;
+            remaining.next();
+        }
+        errors.push(matched);
+    }
+    let missing = errors.iter().filter(|error| error.is_none()).count();
+    (errors, missing, extra + remaining.count())
+}
+
+// Reads the output edges of the horn recorded since 'from_ms', following the cursor
+// while the device reports more events.
+async fn query_edges(
+    session: &Session,
+    history_key: &str,
+    from_ms: u64,
+) -> Result<Vec<Edge>, Box<dyn std::error::Error>> {
+    let mut edges = Vec::new();
+    let mut selector = format!("{history_key}?from={from_ms}");
+    loop {
+        let page = query_page(session, &selector).await?;
+        edges.extend(page.edges);
+        if !page.more {
+            return Ok(edges);
+        }
+        selector = format!("{history_key}?from={from_ms};cursor={}", page.next_seq);
+    }
+}
+
+// Sends a history query and merges the pages of its replies.
+async fn query_page(session: &Session, selector: &str) -> Result<Page, Box<dyn std::error::Error>> {
+    // Every page is a reply on the same key, none may be consolidated away.
+    let replies = session
+        .get(selector)
+        .consolidation(ConsolidationMode::None)
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    let mut merged: Option<Page> = None;
+    while let Ok(reply) = replies.recv_async().await {
+        let sample = reply
+            .result()
+            .map_err(|e| format!("history query failed: {e:?}"))?;
+        let page = parse_page(&sample.payload().to_bytes())?;
+        merged = Some(match merged {
+            Some(mut merged) => {
+                merged.more |= page.more;
+                merged.next_seq = merged.next_seq.max(page.next_seq);
+                merged.now_ms = merged.now_ms.max(page.now_ms);
+                merged.edges.extend(page.edges);
+                merged
+            }
+            None => page,
+        });
+    }
+    merged.ok_or_else(|| format!("no actuation history on '{selector}'").into())
+}
+
+fn parse_page(bytes: &[u8]) -> Result<Page, Box<dyn std::error::Error>> {
+    let mut input = bytes;
+    let [version, flags, rest @ ..] = input else {
+        return Err("truncated history page".into());
+    };
+    if *version != HISTORY_PAGE_VERSION {
+        return Err(format!("unsupported history page version {version}").into());
+    }
+    input = rest;
+    let first_seq = get_varint(&mut input)?;
+    let mut time_ms = get_varint(&mut input)?;
+    let now_ms = get_varint(&mut input)?;
+    let count = get_varint(&mut input)?;
+    let mut edges = Vec::new();
+    for _ in 0..count {
+        let (&header, rest) = input.split_first().ok_or("truncated history event")?;
+        input = rest;
+        let mut id = u64::from(header >> 4);
+        if id == HISTORY_ID_ESCAPE {
+            id = get_varint(&mut input)?;
+        }
+        time_ms += get_varint(&mut input)?;
+        if header & 0x07 == HISTORY_APPLIED && id == SIGNAL_HORN {
+            edges.push(Edge {
+                time_ms,
+                on: header & 0x08 != 0,
+            });
+        }
+    }
+    Ok(Page {
+        more: flags & HISTORY_PAGE_MORE != 0,
+        next_seq: first_seq + count,
+        now_ms,
+        edges,
+    })
+}
+
+fn get_varint(input: &mut &[u8]) -> Result<u64, Box<dyn std::error::Error>> {
+    let mut value = 0u64;
+    for shift in (0..64).step_by(7) {
+        let (&byte, rest) = input.split_first().ok_or("truncated varint")?;
+        *input = rest;
+        value |= u64::from(byte & 0x7f) << shift;
+        if byte & 0x80 == 0 {
+            return Ok(value);
+        }
+    }
+    Err("varint too long".into())
+}
+
+fn percentile(values: &[i64], percent: usize) -> i64 {
+    let mut values = values.to_vec();
+    values.sort();
+    let rank = (values.len() * percent).div_ceil(100);
+    values
+        .get(rank.saturating_sub(1))
+        .copied()
+        .unwrap_or_default()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const ORIGIN_MS: u64 = 10_000;
+    const TOLERANCE_MS: i64 = 50;
+
+    // The captured edges of a run that played the expected ones exactly, shifted by 'errors'.
+    fn captured(expected: &[(u64, bool)], errors: &[i64]) -> Vec<Edge> {
+        expected
+            .iter()
+            .zip(errors)
+            .map(|((offset, on), error)| Edge {
+                time_ms: (ORIGIN_MS + offset).saturating_add_signed(*error),
+                on: *on,
+            })
+            .collect()
+    }
+
+    #[test]
+    fn compare_matches_every_edge_within_the_tolerance() {
+        let expected = expected_edges();
+        let mut errors = vec![0i64; expected.len()];
+        for (i, error) in errors.iter_mut().enumerate().skip(1) {
+            *error = i as i64 * 3 - 10;
+        }
+        let edges = captured(&expected, &errors);
+
+        let (matched, missing, extra) = compare(&expected, &edges, ORIGIN_MS, TOLERANCE_MS);
+        assert_eq!(matched, errors.into_iter().map(Some).collect::<Vec<_>>());
+        assert_eq!((missing, extra), (0, 0));
+    }
+
+    #[test]
+    fn compare_counts_a_lost_edge_as_missing() {
+        let expected = expected_edges();
+        let mut edges = captured(&expected, &vec![0; expected.len()]);
+        // A lost "off" merges two cycles: the output stays on through the pause.
+        edges.drain(3..5);
+
+        let (matched, missing, extra) = compare(&expected, &edges, ORIGIN_MS, TOLERANCE_MS);
+        assert_eq!(matched[3], None);
+        assert_eq!(matched[4], None);
+        assert!(matched
+            .iter()
+            .enumerate()
+            .all(|(i, error)| i == 3 || i == 4 || *error == Some(0)));
+        assert_eq!((missing, extra), (2, 0));
+    }
+
+    #[test]
+    fn compare_counts_glitches_and_trailing_edges_as_extra() {
+        let expected = expected_edges();
+        let mut edges = captured(&expected, &vec![0; expected.len()]);
+        // A short glitch in the first pause and a stray pulse after the sequence
+        let glitch_ms = ORIGIN_MS + expected[1].0 + 20;
+        edges.splice(
+            2..2,
+            [
+                Edge {
+                    time_ms: glitch_ms,
+                    on: true,
+                },
+                Edge {
+                    time_ms: glitch_ms + 5,
+                    on: false,
+                },
+            ],
+        );
+        let end_ms = edges.last().unwrap().time_ms;
+        edges.push(Edge {
+            time_ms: end_ms + 500,
+            on: true,
+        });
+        edges.push(Edge {
+            time_ms: end_ms + 600,
+            on: false,
+        });
+
+        let (matched, missing, extra) = compare(&expected, &edges, ORIGIN_MS, TOLERANCE_MS);
+        assert_eq!(matched, vec![Some(0); expected.len()]);
+        assert_eq!((missing, extra), (0, 4));
+    }
+
+    #[test]
+    fn compare_counts_an_edge_beyond_the_tolerance_as_missing_and_extra() {
+        let expected = expected_edges();
+        let mut errors = vec![0; expected.len()];
+        // The off edge before the longest pause
+        errors[9] = TOLERANCE_MS + 30;
+        let edges = captured(&expected, &errors);
+
+        let (matched, missing, extra) = compare(&expected, &edges, ORIGIN_MS, TOLERANCE_MS);
+        assert_eq!(matched[9], None);
+        assert_eq!(
+            matched.iter().filter(|error| error.is_some()).count(),
+            expected.len() - 1
+        );
+        assert_eq!((missing, extra), (1, 1));
+    }
+
+    #[test]
+    fn compare_ignores_edges_before_the_origin() {
+        let expected = expected_edges();
+        let mut edges = vec![
+            Edge {
+                time_ms: ORIGIN_MS - 2_000,
+                on: true,
+            },
+            Edge {
+                time_ms: ORIGIN_MS - 1_500,
+                on: false,
+            },
+        ];
+        edges.extend(captured(&expected, &vec![0; expected.len()]));
+
+        let (matched, missing, extra) = compare(&expected, &edges, ORIGIN_MS, TOLERANCE_MS);
+        assert_eq!(matched, vec![Some(0); expected.len()]);
+        assert_eq!((missing, extra), (0, 0));
+    }
+
+    #[test]
+    fn compare_reports_every_edge_missing_without_captures() {
+        let expected = expected_edges();
+        let (matched, missing, extra) = compare(&expected, &[], ORIGIN_MS, TOLERANCE_MS);
+        assert!(matched.iter().all(Option::is_none));
+        assert_eq!((missing, extra), (expected.len(), 0));
+    }
+
+    #[test]
+    fn parse_page_keeps_the_output_edges_of_the_horn() {
+        #[rustfmt::skip]
+        let page = [
+            HISTORY_PAGE_VERSION,
+            HISTORY_PAGE_MORE,
+            5,                // first sequence number
+            0xe8, 0x07,       // time of the first event, 1000 ms
+            0xd0, 0x0f,       // time of the reply, 2000 ms
+            5,                // events
+            0x09, 0,          // horn applied on, +0 ms
+            0x02, 10,         // horn acked off, +10 ms
+            0xf9, 20, 5,      // applied on of signal 20 behind the escape, +5 ms
+            0x19, 1,          // applied on of signal 1, +1 ms
+            0x01, 0xac, 0x02, // horn applied off, +300 ms
+        ];
+
+        let page = parse_page(&page).unwrap();
+        assert!(page.more);
+        assert_eq!(page.next_seq, 10);
+        assert_eq!(page.now_ms, 2000);
+        assert_eq!(
+            page.edges,
+            vec![
+                Edge {
+                    time_ms: 1000,
+                    on: true
+                },
+                Edge {
+                    time_ms: 1316,
+                    on: false
+                },
+            ]
+        );
+    }
+
+    #[test]
+    fn parse_page_accepts_an_empty_last_page() {
+        let page = parse_page(&[HISTORY_PAGE_VERSION, 0, 7, 0, 0x64, 0]).unwrap();
+        assert!(!page.more);
+        assert_eq!(page.next_seq, 7);
+        assert_eq!(page.now_ms, 100);
+        assert!(page.edges.is_empty());
+    }
+
+    #[test]
+    fn parse_page_rejects_malformed_pages() {
+        assert!(parse_page(&[HISTORY_PAGE_VERSION]).is_err());
+        assert!(parse_page(&[HISTORY_PAGE_VERSION + 1, 0, 0, 0, 0, 0]).is_err());
+        // Two events announced, one present
+        assert!(parse_page(&[HISTORY_PAGE_VERSION, 0, 0, 0, 0, 2, 0x09, 0]).is_err());
+        // Varint cut off in the delta
+        assert!(parse_page(&[HISTORY_PAGE_VERSION, 0, 0, 0, 0, 1, 0x09, 0x80]).is_err());
+    }
+}
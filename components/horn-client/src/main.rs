@@ -17,10 +17,17 @@ use log::error;
 use log::info;
 use std::path::PathBuf;
 use std::sync::Arc;
+use std::time::{Duration, Instant};
 use up_rust::communication::{CallOptions, InMemoryRpcClient, RpcClient, UPayload};
 use up_transport_zenoh::zenoh_config;
 use up_transport_zenoh::UPTransportZenoh;
 
+mod fidelity;
+mod rpc_latency;
+mod soak;
+mod status;
+
+use horn_proto::horn_idempotency::IdempotentActivateHornRequest;
 use horn_proto::horn_service::{ActivateHornRequest, ActivateHornResponse, DeactivateHornRequest};
 use horn_proto::horn_topics::{HornCycle, HornMode, HornSequence};
 
@@ -35,6 +42,39 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     env_logger::Builder::from_env(Env::default().default_filter_or("info")).init();
     let args = Args::parse();
 
+    if let Some(seconds) = args.soak {
+        let session = zenoh::open(args.get_zenoh_config()?)
+            .await
+            .map_err(|e| e as Box<dyn std::error::Error>)?;
+        return soak::soak(
+            &session,
+            &args.horn_key,
+            Duration::from_secs(seconds),
+            args.soak_rate,
+            Duration::from_secs(args.soak_report_s),
+        )
+        .await;
+    }
+
+    if let Some(count) = args.status_latency {
+        let session = zenoh::open(args.get_zenoh_config()?)
+            .await
+            .map_err(|e| e as Box<dyn std::error::Error>)?;
+        let databroker = args
+            .databroker
+            .as_deref()
+            .map(http::Uri::try_from)
+            .transpose()?;
+        return status::status_latency(
+            &session,
+            &args.horn_key,
+            &args.status_key,
+            databroker,
+            count,
+        )
+        .await;
+    }
+
     info!("Starting the client for the COVESA Horn service over uProtocol");
 
     let transport = UPTransportZenoh::new(args.get_zenoh_config()?, "//horn_client/1/1/0")
@@ -57,6 +97,38 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
         1,
         DEACTIVATE_HORN_RESOURCE_ID,
     )?;
+    if let Some(count) = args.benchmark {
+        return benchmark(&rpc_client, deactivate_horn_uri, count).await;
+    }
+    if let Some(count) = args.rpc_latency {
+        let session = zenoh::open(args.get_zenoh_config()?)
+            .await
+            .map_err(|e| e as Box<dyn std::error::Error>)?;
+        return rpc_latency::rpc_latency(
+            &rpc_client,
+            activate_horn_uri,
+            deactivate_horn_uri,
+            &session,
+            &args.horn_key,
+            count,
+        )
+        .await;
+    }
+    if let Some(runs) = args.fidelity {
+        let session = zenoh::open(args.get_zenoh_config()?)
+            .await
+            .map_err(|e| e as Box<dyn std::error::Error>)?;
+        return fidelity::fidelity(
+            &rpc_client,
+            activate_horn_uri,
+            &session,
+            &args.history_key,
+            runs,
+            Duration::from_millis(args.tolerance_ms),
+            args.idempotent,
+        )
+        .await;
+    }
     let horn_request = ActivateHornRequest {
         mode: HornMode::HM_SEQUENCED.into(),
         command: vec![HornSequence {
@@ -87,7 +159,7 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
         ..Default::default()
     };
 
-    let payload = UPayload::try_from_protobuf(horn_request)?;
+    let payload = activation_payload(horn_request, args.idempotent)?;
     match rpc_client
         .invoke_method(
             activate_horn_uri.clone(),
@@ -134,7 +206,7 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
         ..Default::default()
     };
 
-    let payload = UPayload::try_from_protobuf(horn_request)?;
+    let payload = activation_payload(horn_request, args.idempotent)?;
     match rpc_client
         .invoke_method(
             activate_horn_uri.clone(),
@@ -178,11 +250,157 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     Ok(())
 }
 
+// The payload of an ActivateHorn request. By default it is the COVESA ActivateHornRequest,
+// which every Horn service takes. With 'idempotent' it is the local
+// IdempotentActivateHornRequest with a new key, which is sent unchanged if the request is
+// retried, so horn-service-kuksa does not play it twice. up-rust packs the payload in an
+// Any named after its message type, so services that only know ActivateHornRequest,
+// like the on-device RPC of the actuator provider, reject the wrapper.
+pub(crate) fn activation_payload(
+    request: ActivateHornRequest,
+    idempotent: bool,
+) -> Result<UPayload, Box<dyn std::error::Error>> {
+    if !idempotent {
+        return Ok(UPayload::try_from_protobuf(request)?);
+    }
+    let request = IdempotentActivateHornRequest {
+        mode: request.mode,
+        command: request.command,
+        idempotency_key: up_rust::UUID::build().to_hyphenated_string(),
+        ..Default::default()
+    };
+    Ok(UPayload::try_from_protobuf(request)?)
+}
+
+// Invokes DeactivateHorn 'count' times, one after the other, and reports the round-trip
+// times and the CPU time the client spent per request. Deactivating keeps the horn
+// silent, so the benchmark can run against the complete setup.
+async fn benchmark(
+    rpc_client: &dyn RpcClient,
+    deactivate_horn_uri: up_rust::UUri,
+    count: u32,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let mut round_trips = Vec::with_capacity(count as usize);
+    let cpu_before = process_cpu_time();
+    let started = Instant::now();
+    for _ in 0..count {
+        let payload = UPayload::try_from_protobuf(DeactivateHornRequest::default())?;
+        let sent = Instant::now();
+        match rpc_client
+            .invoke_method(
+                deactivate_horn_uri.clone(),
+                CallOptions::for_rpc_request(1_000, None, None, None),
+                Some(payload),
+            )
+            .await
+        {
+            Ok(_) => round_trips.push(sent.elapsed()),
+            Err(e) => error!("The deactivate horn request returned the error: {:?}", e),
+        }
+    }
+    let elapsed = started.elapsed();
+    let cpu = process_cpu_time()
+        .zip(cpu_before)
+        .map(|(after, before)| after.saturating_sub(before));
+
+    round_trips.sort();
+    let percentile = |percent: usize| {
+        let rank = (round_trips.len() * percent).div_ceil(100);
+        round_trips
+            .get(rank.saturating_sub(1))
+            .copied()
+            .unwrap_or_default()
+    };
+    info!(
+        "{} of {} requests answered in {:?}: round trip p50 {:?}, p99 {:?}, max {:?}; client CPU per request {:?}",
+        round_trips.len(),
+        count,
+        elapsed,
+        percentile(50),
+        percentile(99),
+        round_trips.last().copied().unwrap_or_default(),
+        cpu.map(|cpu| cpu / count.max(1)),
+    );
+    Ok(())
+}
+
+// User and system CPU time of this process. Only available on Linux, where /proc
+// reports it in clock ticks of 10 ms.
+fn process_cpu_time() -> Option<Duration> {
+    let stat = std::fs::read_to_string("/proc/self/stat").ok()?;
+    // The fields after the command name start with the state, utime is the 12th of them.
+    let mut fields = stat.rsplit_once(')')?.1.split_whitespace().skip(11);
+    let utime: u64 = fields.next()?.parse().ok()?;
+    let stime: u64 = fields.next()?.parse().ok()?;
+    Some(Duration::from_millis((utime + stime) * 10))
+}
+
 #[derive(clap::Parser, Clone, PartialEq, Eq, Hash, Debug)]
 pub struct Args {
     #[arg(short, long, default_value = "zenoh-config.json5")]
     /// A Zenoh configuration file.
     config: PathBuf,
+
+    #[arg(long, value_name = "COUNT")]
+    /// Sends COUNT deactivation requests instead of the demo sequences and reports
+    /// the round-trip times and the client CPU time per request.
+    benchmark: Option<u32>,
+
+    #[arg(long, value_name = "COUNT")]
+    /// Alternates COUNT ActivateHorn and DeactivateHorn requests and reports the
+    /// round-trip times and the times until the output edge is reported as currentValue.
+    rpc_latency: Option<u32>,
+
+    #[arg(long)]
+    /// Sends activations as IdempotentActivateHornRequest with an idempotency key, so
+    /// horn-service-kuksa recognizes retries. Services that only know the COVESA
+    /// ActivateHornRequest reject it.
+    idempotent: bool,
+
+    #[arg(long, value_name = "RUNS")]
+    /// Plays a test sequence RUNS times and compares the output edges recorded in the
+    /// actuation history of the actuator provider with the requested timing.
+    fidelity: Option<u32>,
+
+    #[arg(long, default_value = "Vehicle/Body/Horn/History")]
+    /// The key the actuator provider serves its actuation history on.
+    history_key: String,
+
+    #[arg(long, default_value_t = 50)]
+    /// How far an output edge may be off its requested time before it counts as missing.
+    tolerance_ms: u64,
+
+    #[arg(long, value_name = "SECONDS")]
+    /// Drives the actuator provider directly for SECONDS instead of the demo sequences:
+    /// publishes alternating targetValues and reports how they are acknowledged.
+    soak: Option<u64>,
+
+    #[arg(long, default_value_t = 10)]
+    /// targetValues sent per second in a soak run.
+    soak_rate: u32,
+
+    #[arg(long, default_value_t = 60)]
+    /// Seconds between the CSV lines of a soak run.
+    soak_report_s: u64,
+
+    #[arg(long, default_value = "Vehicle/Body/Horn/IsActive")]
+    /// The key the actuator provider receives targetValues and reports currentValues on.
+    horn_key: String,
+
+    #[arg(long, value_name = "COUNT")]
+    /// Switches the horn COUNT times through targetValues and compares how fast the
+    /// HornStatus of the actuator provider, its currentValue and, with --databroker,
+    /// the databroker report each change.
+    status_latency: Option<u32>,
+
+    #[arg(long, default_value = "up/horn-service-kuksa/1C/0/1/8000/**")]
+    /// The uProtocol topic the actuator provider publishes HornStatus on.
+    status_key: String,
+
+    #[arg(long, value_name = "URI")]
+    /// The Kuksa Databroker to read Vehicle.Body.Horn.IsActive from in a status
+    /// latency run, e.g. http://localhost:55555.
+    databroker: Option<String>,
 }
 
 impl Args {
@@ -0,0 +1,136 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use horn_proto::horn_service::{ActivateHornRequest, DeactivateHornRequest};
+use horn_proto::horn_topics::HornMode;
+use log::{info, warn};
+use std::time::{Duration, Instant};
+use tokio::sync::mpsc;
+use up_rust::communication::{CallOptions, RpcClient, UPayload};
+use zenoh::Session;
+
+// Time to wait for the output edge of a request before the next one is sent.
+const EDGE_TIMEOUT: Duration = Duration::from_secs(2);
+// Pause between two requests, so the edge of one does not overlap the next.
+const REQUEST_PAUSE: Duration = Duration::from_millis(200);
+
+// Alternates 'count' ActivateHorn (continuous) and DeactivateHorn requests and measures
+// per request the RPC round trip and the time until the provider reports the output
+// edge as currentValue on 'key'. Run it once against horn-service-kuksa and once
+// against the provider serving the methods itself to compare the chain with the
+// single hop. The horn is left off.
+pub async fn rpc_latency(
+    rpc_client: &dyn RpcClient,
+    activate_horn_uri: up_rust::UUri,
+    deactivate_horn_uri: up_rust::UUri,
+    session: &Session,
+    key: &str,
+    count: u32,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let (sender, mut edges) = mpsc::unbounded_channel::<(bool, Instant)>();
+    let _current = session
+        .declare_subscriber(key)
+        .callback(move |sample| {
+            let is_current = sample
+                .attachment()
+                .and_then(|a| a.try_to_string().ok().map(|v| v == "currentValue"))
+                .unwrap_or(false);
+            if is_current {
+                if let Ok(value) = sample.payload().try_to_string() {
+                    let _ = sender.send((value == "true", Instant::now()));
+                }
+            }
+        })
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+
+    let mut round_trips = Vec::with_capacity(count as usize);
+    let mut first_edges = Vec::with_capacity(count as usize);
+    let mut on = false;
+    for _ in 0..count {
+        on = !on;
+        let (uri, payload) = if on {
+            let request = ActivateHornRequest {
+                mode: HornMode::HM_CONTINUOUS.into(),
+                ..Default::default()
+            };
+            (
+                activate_horn_uri.clone(),
+                UPayload::try_from_protobuf(request)?,
+            )
+        } else {
+            (
+                deactivate_horn_uri.clone(),
+                UPayload::try_from_protobuf(DeactivateHornRequest::default())?,
+            )
+        };
+
+        while edges.try_recv().is_ok() {}
+        let sent = Instant::now();
+        if let Err(e) = rpc_client
+            .invoke_method(
+                uri,
+                CallOptions::for_rpc_request(1_000, None, None, None),
+                Some(payload),
+            )
+            .await
+        {
+            warn!("The request returned the error: {:?}", e);
+            continue;
+        }
+        round_trips.push(sent.elapsed());
+
+        let deadline = tokio::time::Instant::now() + EDGE_TIMEOUT;
+        while let Ok(Some((value, at))) = tokio::time::timeout_at(deadline, edges.recv()).await {
+            if value == on {
+                first_edges.push(at - sent);
+                break;
+            }
+        }
+        tokio::time::sleep(REQUEST_PAUSE).await;
+    }
+    if on {
+        let payload = UPayload::try_from_protobuf(DeactivateHornRequest::default())?;
+        if let Err(e) = rpc_client
+            .invoke_method(
+                deactivate_horn_uri,
+                CallOptions::for_rpc_request(1_000, None, None, None),
+                Some(payload),
+            )
+            .await
+        {
+            warn!("Failed to switch the horn off: {:?}", e);
+        }
+    }
+
+    for (name, latencies) in [
+        ("round trip", &mut round_trips),
+        ("request to edge", &mut first_edges),
+    ] {
+        if latencies.is_empty() {
+            info!("{name}: no samples");
+            continue;
+        }
+        latencies.sort_unstable();
+        let percentile =
+            |percent: usize| latencies[(latencies.len() * percent).div_ceil(100).saturating_sub(1)];
+        info!(
+            "{name}: {} of {count} requests, p50 {:?}, p99 {:?}, max {:?}",
+            latencies.len(),
+            percentile(50),
+            percentile(99),
+            latencies[latencies.len() - 1],
+        );
+    }
+    Ok(())
+}
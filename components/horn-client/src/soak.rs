@@ -0,0 +1,186 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use log::{info, warn};
+use std::time::Duration;
+use tokio::time::{Instant, MissedTickBehavior};
+use zenoh::Session;
+
+// Header of the CSV lines printed per report interval
+const SOAK_HEADER: &str = "SOAKDRV,elapsed_s,sent,acked,missed,p50_ms,p99_ms,max_ms,max_ack_gap_ms";
+
+// Statistics of one report interval
+#[derive(Default)]
+struct Window {
+    sent: u64,
+    acked: u64,
+    missed: u64,
+    latencies: Vec<Duration>,
+    max_ack_gap: Duration,
+}
+
+impl Window {
+    fn percentile(&self, percent: usize) -> Duration {
+        let rank = (self.latencies.len() * percent).div_ceil(100);
+        self.latencies
+            .get(rank.saturating_sub(1))
+            .copied()
+            .unwrap_or_default()
+    }
+
+    fn absorb(&mut self, window: &mut Window) {
+        self.sent += window.sent;
+        self.acked += window.acked;
+        self.missed += window.missed;
+        self.latencies.append(&mut window.latencies);
+        self.max_ack_gap = self.max_ack_gap.max(window.max_ack_gap);
+    }
+
+    fn print(&mut self, elapsed: Duration) {
+        self.latencies.sort_unstable();
+        println!(
+            "SOAKDRV,{},{},{},{},{:.1},{:.1},{:.1},{}",
+            elapsed.as_secs(),
+            self.sent,
+            self.acked,
+            self.missed,
+            self.percentile(50).as_secs_f64() * 1000.0,
+            self.percentile(99).as_secs_f64() * 1000.0,
+            self.latencies
+                .last()
+                .copied()
+                .unwrap_or_default()
+                .as_secs_f64()
+                * 1000.0,
+            self.max_ack_gap.as_millis(),
+        );
+    }
+}
+
+// Interval of the presence announcements, two may get lost within the provider's default lease
+const PRESENCE_EVERY: Duration = Duration::from_secs(10);
+
+// Drives the actuator provider for a soak run: publishes targetValues alternating
+// between "true" and "false" on 'key' at 'rate' per second for 'duration' and matches
+// them with the currentValue the provider reports back. A command that is not
+// acknowledged before the next one is sent counts as missed. Every 'report_every' one
+// CSV line is printed with the commands sent, acknowledged and missed, the
+// command-to-ack latencies and the longest gap between two acks, which covers
+// reconnects and router failovers of the provider. The horn is left off.
+//
+// The run announces itself on '{key}/Consumers/<id>', with "join" first and every
+// PRESENCE_EVERY after that, so a provider built with CURRENT_VALUE_ON_DEMAND keeps
+// publishing currentValue.
+pub async fn soak(
+    session: &Session,
+    key: &str,
+    duration: Duration,
+    rate: u32,
+    report_every: Duration,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let subscriber = session
+        .declare_subscriber(key)
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+    let mut commands = tokio::time::interval(Duration::from_secs(1) / rate.max(1));
+    commands.set_missed_tick_behavior(MissedTickBehavior::Skip);
+    let mut reports = tokio::time::interval_at(Instant::now() + report_every, report_every);
+    let presence_key = format!("{key}/Consumers/horn-client-{}", std::process::id());
+    let mut presence = tokio::time::interval(PRESENCE_EVERY);
+    presence.set_missed_tick_behavior(MissedTickBehavior::Skip);
+    let mut joined = false;
+
+    info!("Soak run on '{key}': {rate} targetValues/s for {duration:?}");
+    println!("{SOAK_HEADER}");
+    let started = Instant::now();
+    let end = started + duration;
+    let mut window = Window::default();
+    let mut total = Window::default();
+    let mut value = false;
+    let mut pending: Option<(bool, Instant)> = None;
+    let mut last_ack = started;
+    loop {
+        tokio::select! {
+            _ = commands.tick() => {
+                if Instant::now() >= end {
+                    break;
+                }
+                if pending.take().is_some() {
+                    window.missed += 1;
+                }
+                value = !value;
+                if let Err(e) = session
+                    .put(key, value.to_string())
+                    .attachment("targetValue")
+                    .await
+                {
+                    warn!("Failed to publish the targetValue: {e}");
+                    continue;
+                }
+                pending = Some((value, Instant::now()));
+                window.sent += 1;
+            }
+            sample = subscriber.recv_async() => {
+                let sample = sample.map_err(|e| e as Box<dyn std::error::Error>)?;
+                let is_ack = sample
+                    .attachment()
+                    .and_then(|a| a.try_to_string().ok().map(|v| v == "currentValue"))
+                    .unwrap_or(false);
+                if !is_ack {
+                    continue;
+                }
+                let now = Instant::now();
+                window.max_ack_gap = window.max_ack_gap.max(now - last_ack);
+                last_ack = now;
+                let acked = sample.payload().try_to_string().ok().map(|v| v == "true");
+                if let Some((expected, sent)) = pending {
+                    if acked == Some(expected) {
+                        window.latencies.push(now - sent);
+                        window.acked += 1;
+                        pending = None;
+                    }
+                }
+            }
+            _ = presence.tick() => {
+                let announcement = if joined { "" } else { "join" };
+                joined = true;
+                if let Err(e) = session.put(&presence_key, announcement).await {
+                    warn!("Failed to announce the soak run: {e}");
+                }
+            }
+            _ = reports.tick() => {
+                window.print(started.elapsed());
+                total.absorb(&mut window);
+                window = Window::default();
+            }
+        }
+    }
+
+    if let Err(e) = session.put(key, "false").attachment("targetValue").await {
+        warn!("Failed to switch the horn off: {e}");
+    }
+    total.absorb(&mut window);
+    total.latencies.sort_unstable();
+    info!(
+        "Soak run ended after {:?}: {} sent, {} acknowledged, {} missed; ack latency p50 {:?}, p99 {:?}, max {:?}; longest gap between acks {:?}",
+        started.elapsed(),
+        total.sent,
+        total.acked,
+        total.missed,
+        total.percentile(50),
+        total.percentile(99),
+        total.latencies.last().copied().unwrap_or_default(),
+        total.max_ack_gap,
+    );
+    Ok(())
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use horn_proto::horn_topics::HornStatus;
+use kuksa_rust_sdk::kuksa::common::ClientTraitV1;
+use kuksa_rust_sdk::kuksa::val::v1::KuksaClient;
+use kuksa_rust_sdk::v1_proto;
+use log::{info, warn};
+use protobuf::Message;
+use std::time::{Duration, Instant};
+use tokio::sync::mpsc;
+use zenoh::Session;
+
+// Time to wait for all paths to report a state change before the next one is sent.
+const STATUS_TIMEOUT: Duration = Duration::from_secs(2);
+// Pause between two state changes, so the reports of one do not overlap the next.
+const STATUS_PAUSE: Duration = Duration::from_millis(200);
+const PATHS: [&str; 3] = ["HornStatus", "currentValue", "databroker"];
+
+// Switches the horn 'count' times through a targetValue on 'key' and measures when
+// each path reports the new state: the HornStatus the actuator provider publishes
+// itself on 'status_key', its currentValue on 'key' (the first hop towards the
+// databroker) and, with 'databroker', Vehicle.Body.Horn.IsActive as a subscriber of
+// the Kuksa Databroker sees it after the zenoh-kuksa-provider forwarded it. Prints
+// the p50, p99 and maximum latency per path. The horn is left off.
+pub async fn status_latency(
+    session: &Session,
+    key: &str,
+    status_key: &str,
+    databroker: Option<http::Uri>,
+    count: u32,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let (sender, mut reports) = mpsc::unbounded_channel::<(usize, bool, Instant)>();
+    let paths = if databroker.is_some() { 3 } else { 2 };
+
+    let status_sender = sender.clone();
+    let _status = session
+        .declare_subscriber(status_key)
+        .callback(move |sample| {
+            if let Ok(status) = HornStatus::parse_from_bytes(&sample.payload().to_bytes()) {
+                let _ = status_sender.send((0, status.is_active, Instant::now()));
+            }
+        })
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+
+    let current_sender = sender.clone();
+    let _current = session
+        .declare_subscriber(key)
+        .callback(move |sample| {
+            let is_current = sample
+                .attachment()
+                .and_then(|a| a.try_to_string().ok().map(|v| v == "currentValue"))
+                .unwrap_or(false);
+            if is_current {
+                if let Ok(value) = sample.payload().try_to_string() {
+                    let _ = current_sender.send((1, value == "true", Instant::now()));
+                }
+            }
+        })
+        .await
+        .map_err(|e| e as Box<dyn std::error::Error>)?;
+
+    if let Some(uri) = databroker {
+        let mut client = KuksaClient::new(uri);
+        let mut updates = client
+            .subscribe_current_values(vec!["Vehicle.Body.Horn.IsActive".to_string()])
+            .await
+            .map_err(|e| format!("Unable to subscribe to the databroker: {e:?}"))?;
+        tokio::spawn(async move {
+            while let Ok(Some(response)) = updates.message().await {
+                for update in response.updates {
+                    let value = update
+                        .entry
+                        .and_then(|entry| entry.value)
+                        .and_then(|datapoint| datapoint.value);
+                    if let Some(v1_proto::datapoint::Value::Bool(is_active)) = value {
+                        let _ = sender.send((2, is_active, Instant::now()));
+                    }
+                }
+            }
+        });
+    }
+
+    let mut latencies: [Vec<Duration>; 3] = Default::default();
+    let mut value = false;
+    for _ in 0..count {
+        value = !value;
+        // Reports of the previous change that arrived late are not counted.
+        while reports.try_recv().is_ok() {}
+        let sent = Instant::now();
+        if let Err(e) = session
+            .put(key, value.to_string())
+            .attachment("targetValue")
+            .await
+        {
+            warn!("Failed to publish the targetValue: {e}");
+            continue;
+        }
+        let mut seen = [false; 3];
+        let deadline = tokio::time::Instant::now() + STATUS_TIMEOUT;
+        while let Ok(Some((path, is_active, at))) =
+            tokio::time::timeout_at(deadline, reports.recv()).await
+        {
+            if is_active == value && !seen[path] {
+                seen[path] = true;
+                latencies[path].push(at - sent);
+                if seen.iter().filter(|seen| **seen).count() == paths {
+                    break;
+                }
+            }
+        }
+        tokio::time::sleep(STATUS_PAUSE).await;
+    }
+    if value {
+        if let Err(e) = session.put(key, "false").attachment("targetValue").await {
+            warn!("Failed to switch the horn off: {e}");
+        }
+    }
+
+    for (path, latencies) in PATHS.iter().zip(latencies.iter_mut()) {
+        if latencies.is_empty() {
+            info!("{path}: no reports");
+            continue;
+        }
+        latencies.sort_unstable();
+        let percentile =
+            |percent: usize| latencies[(latencies.len() * percent).div_ceil(100).saturating_sub(1)];
+        info!(
+            "{path}: {} of {count} state changes reported, latency p50 {:?}, p99 {:?}, max {:?}",
+            latencies.len(),
+            percentile(50),
+            percentile(99),
+            latencies[latencies.len() - 1],
+        );
+    }
+    Ok(())
+}
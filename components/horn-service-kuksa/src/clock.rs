@@ -0,0 +1,45 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use std::cell::Cell;
+use std::time::{Duration, SystemTime};
+use tokio::time::Instant;
+
+thread_local! {
+    // Start of a virtual clock: its wall-clock time and the tokio instant it maps to.
+    // The virtual clock belongs to the thread that runs the paused current-thread
+    // runtime, so simulations and tests on other threads keep their own clock.
+    static VIRTUAL_EPOCH: Cell<Option<(SystemTime, Instant)>> = const { Cell::new(None) };
+}
+
+// Switches the wall clock of the service to the tokio clock, starting at 'epoch'.
+// Under a paused tokio runtime time then only advances when every task waits for
+// a timer, which makes timestamps and deadlines reproducible.
+#[cfg(any(test, feature = "simulation"))]
+pub(crate) fn start_virtual(epoch: SystemTime) {
+    VIRTUAL_EPOCH.set(Some((epoch, Instant::now())));
+}
+
+// Wall-clock time used for edge timestamps and deadlines: the system time,
+// unless a virtual clock was started. Tokio timers fire on whole milliseconds,
+// so the virtual clock is truncated to milliseconds as well; this also drops the
+// sub-millisecond offset between the timer driver and the clock, which differs
+// from run to run.
+pub(crate) fn now() -> SystemTime {
+    match VIRTUAL_EPOCH.get() {
+        Some((epoch, started)) => {
+            epoch + Duration::from_millis(started.elapsed().as_millis() as u64)
+        }
+        None => SystemTime::now(),
+    }
+}
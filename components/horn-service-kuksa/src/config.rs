@@ -31,6 +31,87 @@ pub struct Args {
     /// Enables the connection to the Kuksa Databroker.
     /// Otherwise the value of the horn signal is printed to the terminal only.
     pub kuksa_enabled: bool,
+
+    #[arg(
+        long,
+        default_value = "1000",
+        env = "REQUEST_DEADLINE_MS",
+        value_name = "MS"
+    )]
+    /// Time budget of a horn request from its arrival, in milliseconds.
+    /// Requests not started and horn edges not written to the Kuksa Databroker
+    /// within this time are dropped. Matches the TTL set by horn-client.
+    pub request_deadline_ms: u64,
+
+    #[arg(
+        long,
+        default_value = "1000",
+        env = "HEARTBEAT_INTERVAL_MS",
+        value_name = "MS"
+    )]
+    /// Interval at which the horn signal is set to 'true' again while the horn is on,
+    /// in milliseconds. Actuators holding the horn on for a lease turn it off when
+    /// these heartbeats stop. 0 sends every change once only.
+    pub heartbeat_interval_ms: u64,
+
+    #[arg(
+        long,
+        default_value = "1024",
+        env = "IDEMPOTENCY_KEYS",
+        value_name = "COUNT"
+    )]
+    /// Number of idempotency keys of recent activation requests kept to recognize
+    /// retries. A retry is answered with the outcome of its original request instead
+    /// of restarting the sequence. 0 plays every request.
+    pub idempotency_keys: usize,
+
+    #[arg(
+        long,
+        default_value = "30000",
+        env = "IDEMPOTENCY_WINDOW_MS",
+        value_name = "MS"
+    )]
+    /// Time an idempotency key is kept after its request arrived, in milliseconds.
+    pub idempotency_window_ms: u64,
+
+    #[cfg(feature = "simulation")]
+    #[arg(long, env = "SIMULATE_SEED", value_name = "SEED")]
+    /// Runs a simulation instead of the service: random horn requests from the given
+    /// seed are played against a modelled network and actuator in virtual time.
+    /// The same seed always yields the same report.
+    pub simulate_seed: Option<u64>,
+
+    #[cfg(feature = "simulation")]
+    #[arg(
+        long,
+        default_value = "24",
+        env = "SIMULATE_HOURS",
+        value_name = "HOURS"
+    )]
+    /// Virtual time covered by a simulation, in hours.
+    pub simulate_hours: u64,
+
+    #[cfg(feature = "simulation")]
+    #[arg(
+        long,
+        default_value = "3000",
+        env = "SIMULATE_LEASE_MS",
+        value_name = "MS"
+    )]
+    /// Lease of the modelled actuator in a simulation, in milliseconds: it turns the
+    /// horn off when no heartbeat arrived for this long. 0 disables the lease.
+    pub simulate_lease_ms: u64,
+
+    #[cfg(feature = "simulation")]
+    #[arg(
+        long,
+        default_value = "0",
+        env = "SIMULATE_RETRIES",
+        value_name = "COUNT"
+    )]
+    /// Number of times the modelled client retries every activation in a simulation,
+    /// one request deadline apart and with the same idempotency key.
+    pub simulate_retries: u32,
 }
 
 fn valid_uri(uri: &str) -> Result<Uri, String> {
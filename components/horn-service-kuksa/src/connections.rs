@@ -15,36 +15,84 @@ use http::Uri;
 use kuksa_rust_sdk::kuksa::common::ClientTraitV1;
 use kuksa_rust_sdk::kuksa::val::v1::KuksaClient;
 use kuksa_rust_sdk::v1_proto;
-use log::{debug, error, info};
+use log::{debug, error, info, warn};
 use std::collections::HashMap;
-use std::time::SystemTime;
+use std::sync::Arc;
+use std::time::Duration;
 use tokio::select;
 
-pub(crate) async fn send_to_databroker(mut rx: tokio::sync::mpsc::Receiver<bool>, uri: Uri) {
+use crate::deadline::{Deadline, ExpiredCounter};
+use crate::edge_ring::{Edge, EdgeRing, LagMetrics};
+
+static EXPIRED_EDGES: ExpiredCounter = ExpiredCounter::new("databroker writer");
+
+// Drains all edges pending in the ring and returns the newest one together with the
+// number of older edges it supersedes.
+pub(crate) fn take_latest(ring: &EdgeRing) -> Option<(Edge, u64)> {
+    let mut latest = ring.pop()?;
+    let mut coalesced = 0;
+    while let Some(edge) = ring.pop() {
+        latest = edge;
+        coalesced += 1;
+    }
+    Some((latest, coalesced))
+}
+
+// Delivers the edges recorded by the sequence player to the Kuksa Databroker.
+// While a write is in flight the player keeps recording; edges that pile up in
+// the meantime are coalesced so only the newest state is written next.
+// An edge that switches the horn on is dropped when it could not be written
+// within 'edge_deadline' after it was played; edges switching it off are always written.
+pub(crate) async fn send_to_databroker(ring: Arc<EdgeRing>, uri: Uri, edge_deadline: Duration) {
     info!("Connecting to Kuksa Databroker [{uri}]");
     let mut client = KuksaClient::new(uri);
-    while let Some(is_active) = rx.recv().await {
-        debug!("Sending: {:?}", is_active);
-        let ts = Some(prost_types::Timestamp::from(SystemTime::now()));
-        let datapoints = HashMap::from([(
-            "Vehicle.Body.Horn.IsActive".to_string(),
-            v1_proto::Datapoint {
-                timestamp: ts,
-                value: Some(v1_proto::datapoint::Value::Bool(is_active)),
-            },
-        )]);
-        if let Err(e) = client.set_target_values(datapoints).await {
-            error!("Failed to send the Horn signal to Kuksa Databroker: {e}");
+    let mut metrics = LagMetrics::default();
+    loop {
+        ring.wait().await;
+        while let Some((edge, coalesced)) = take_latest(&ring) {
+            let deadline = Deadline::at(edge.timestamp + edge_deadline);
+            if edge.is_active && deadline.is_expired() {
+                EXPIRED_EDGES.record("a horn edge", &deadline);
+                continue;
+            }
+            debug!("Sending: {:?}", edge.is_active);
+            let datapoints = HashMap::from([(
+                "Vehicle.Body.Horn.IsActive".to_string(),
+                v1_proto::Datapoint {
+                    timestamp: Some(prost_types::Timestamp::from(edge.timestamp)),
+                    value: Some(v1_proto::datapoint::Value::Bool(edge.is_active)),
+                },
+            )]);
+            if let Err(e) = client.set_target_values(datapoints).await {
+                error!("Failed to send the Horn signal to Kuksa Databroker: {e}");
+            }
+            metrics.record(&edge, coalesced);
+            if coalesced > 0 {
+                warn!(
+                    "Kuksa Databroker lags behind the horn sequence: coalesced {} edge(s), lag {:?} (max {:?}, total coalesced {}, overwritten {})",
+                    coalesced,
+                    metrics.last_lag,
+                    metrics.max_lag,
+                    metrics.coalesced,
+                    ring.overwritten()
+                );
+            } else {
+                debug!("Delivered horn edge with lag {:?}", metrics.last_lag);
+            }
         }
     }
 }
 
-pub(crate) async fn send_to_terminal(mut rx: tokio::sync::mpsc::Receiver<bool>) {
-    let mut is_active = Some(false);
-    while is_active.is_some() {
-        is_active = select! {
-            next_is_active = rx.recv() => next_is_active,
-            _ = print_is_active(is_active.unwrap()) => is_active,
+pub(crate) async fn send_to_terminal(ring: Arc<EdgeRing>) {
+    let mut is_active = false;
+    loop {
+        select! {
+            _ = ring.wait() => {
+                if let Some((edge, _)) = take_latest(&ring) {
+                    is_active = edge.is_active;
+                }
+            },
+            _ = print_is_active(is_active) => {},
         }
     }
 }
@@ -0,0 +1,76 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use log::warn;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, SystemTime};
+
+use crate::clock;
+
+// Absolute point in time after which a piece of work is no longer worth doing.
+// A request's deadline is derived once from the request TTL and passed along
+// unchanged, so the request handler and the sequence player compare against the
+// same instant instead of a TTL of their own. The edges of a sequence are played
+// long after that instant, so the databroker writer gives every edge a deadline
+// of its own, the same budget counted from the instant the edge was played.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, PartialOrd, Ord)]
+pub(crate) struct Deadline(SystemTime);
+
+impl Deadline {
+    pub fn after(ttl: Duration) -> Self {
+        Self(clock::now() + ttl)
+    }
+
+    pub fn at(instant: SystemTime) -> Self {
+        Self(instant)
+    }
+
+    pub fn is_expired(&self) -> bool {
+        clock::now() > self.0
+    }
+
+    // Time left until the deadline, zero once it has passed.
+    pub fn remaining(&self) -> Duration {
+        self.0.duration_since(clock::now()).unwrap_or_default()
+    }
+
+    // Time since the deadline passed, zero before.
+    pub fn overdue(&self) -> Duration {
+        clock::now().duration_since(self.0).unwrap_or_default()
+    }
+}
+
+// Counts the work one hop dropped because its deadline had passed.
+pub(crate) struct ExpiredCounter {
+    hop: &'static str,
+    dropped: AtomicU64,
+}
+
+impl ExpiredCounter {
+    pub const fn new(hop: &'static str) -> Self {
+        Self {
+            hop,
+            dropped: AtomicU64::new(0),
+        }
+    }
+
+    // Records that 'what' was dropped at this hop.
+    pub fn record(&self, what: &str, deadline: &Deadline) {
+        let dropped = self.dropped.fetch_add(1, Ordering::Relaxed) + 1;
+        warn!(
+            "Dropped {what} in the {} {:?} after its deadline ({dropped} dropped there so far)",
+            self.hop,
+            deadline.overdue()
+        );
+    }
+}
@@ -0,0 +1,229 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+use tokio::sync::Notify;
+
+use crate::clock;
+
+// A horn state change as recorded by the sequence player.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub(crate) struct Edge {
+    pub is_active: bool,
+    pub timestamp: SystemTime,
+}
+
+impl Edge {
+    // Packs the edge into one word: microseconds since the epoch, shifted left
+    // by one, with the horn state in the lowest bit.
+    fn encode(&self) -> u64 {
+        let micros = self
+            .timestamp
+            .duration_since(UNIX_EPOCH)
+            .unwrap_or_default()
+            .as_micros() as u64;
+        (micros << 1) | self.is_active as u64
+    }
+
+    fn decode(word: u64) -> Self {
+        Self {
+            is_active: word & 1 == 1,
+            timestamp: UNIX_EPOCH + Duration::from_micros(word >> 1),
+        }
+    }
+}
+
+// Fixed-size, lock-free ring of edges with a single producer (the sequence player)
+// and a single consumer (the databroker or terminal writer).
+//
+// 'push' never blocks and never waits for the consumer: when the ring is full the
+// oldest edge is overwritten, so playback timing stays independent of delivery.
+// Head and tail are monotonically increasing counters; the slot index is the
+// counter modulo the capacity. Both sides advance the tail with a compare-exchange,
+// which lets the producer drop the oldest edge without coordinating with a reader
+// that is concurrently taking it.
+pub(crate) struct EdgeRing {
+    slots: Box<[AtomicU64]>,
+    head: AtomicUsize,
+    tail: AtomicUsize,
+    overwritten: AtomicU64,
+    notify: Notify,
+}
+
+impl EdgeRing {
+    pub fn with_capacity(capacity: usize) -> Self {
+        assert!(capacity > 0, "edge ring capacity must not be zero");
+        Self {
+            slots: (0..capacity).map(|_| AtomicU64::new(0)).collect(),
+            head: AtomicUsize::new(0),
+            tail: AtomicUsize::new(0),
+            overwritten: AtomicU64::new(0),
+            notify: Notify::new(),
+        }
+    }
+
+    // Records an edge with the current time and wakes the writer.
+    pub fn push(&self, is_active: bool) {
+        self.push_edge(Edge {
+            is_active,
+            timestamp: clock::now(),
+        });
+    }
+
+    pub fn push_edge(&self, edge: Edge) {
+        let capacity = self.slots.len();
+        let head = self.head.load(Ordering::Relaxed);
+        let tail = self.tail.load(Ordering::Acquire);
+        if head.wrapping_sub(tail) >= capacity
+            && self
+                .tail
+                .compare_exchange(tail, tail.wrapping_add(1), Ordering::AcqRel, Ordering::Relaxed)
+                .is_ok()
+        {
+            self.overwritten.fetch_add(1, Ordering::Relaxed);
+        }
+        self.slots[head % capacity].store(edge.encode(), Ordering::Release);
+        self.head.store(head.wrapping_add(1), Ordering::Release);
+        self.notify.notify_one();
+    }
+
+    // Takes the oldest pending edge, if any.
+    pub fn pop(&self) -> Option<Edge> {
+        loop {
+            let tail = self.tail.load(Ordering::Acquire);
+            let head = self.head.load(Ordering::Acquire);
+            if tail == head {
+                return None;
+            }
+            let word = self.slots[tail % self.slots.len()].load(Ordering::Acquire);
+            // If the producer overwrote this slot meanwhile, it has also moved the
+            // tail on and the exchange fails, so a stale word is never returned.
+            if self
+                .tail
+                .compare_exchange(tail, tail.wrapping_add(1), Ordering::AcqRel, Ordering::Relaxed)
+                .is_ok()
+            {
+                return Some(Edge::decode(word));
+            }
+        }
+    }
+
+    // Waits until at least one edge was pushed since the last wake-up.
+    pub async fn wait(&self) {
+        self.notify.notified().await;
+    }
+
+    // Number of edges pushed since the ring was created.
+    pub fn pushed(&self) -> u64 {
+        self.head.load(Ordering::Relaxed) as u64
+    }
+
+    // Number of edges that were dropped because the writer fell a full ring behind.
+    pub fn overwritten(&self) -> u64 {
+        self.overwritten.load(Ordering::Relaxed)
+    }
+}
+
+// Delivery statistics of a writer draining an 'EdgeRing'.
+#[derive(Default, Debug)]
+pub(crate) struct LagMetrics {
+    pub delivered: u64,
+    pub coalesced: u64,
+    pub last_lag: Duration,
+    pub max_lag: Duration,
+}
+
+impl LagMetrics {
+    // Records the delivery of 'edge' which superseded 'coalesced' older edges.
+    pub fn record(&mut self, edge: &Edge, coalesced: u64) {
+        self.delivered += 1;
+        self.coalesced += coalesced;
+        self.last_lag = clock::now()
+            .duration_since(edge.timestamp)
+            .unwrap_or_default();
+        self.max_lag = self.max_lag.max(self.last_lag);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::connections::take_latest;
+
+    fn edge(is_active: bool, millis: u64) -> Edge {
+        Edge {
+            is_active,
+            timestamp: UNIX_EPOCH + Duration::from_millis(millis),
+        }
+    }
+
+    #[test]
+    fn encoding_keeps_state_and_microseconds() {
+        let precise = Edge {
+            is_active: true,
+            timestamp: UNIX_EPOCH + Duration::from_micros(1_718_000_000_123_457),
+        };
+        assert_eq!(Edge::decode(precise.encode()), precise);
+        assert_eq!(Edge::decode(edge(false, 42).encode()), edge(false, 42));
+    }
+
+    #[test]
+    fn pop_returns_edges_in_order_across_wraparound() {
+        let ring = EdgeRing::with_capacity(4);
+        for round in 0..10u64 {
+            for i in 0..3 {
+                ring.push_edge(edge(i % 2 == 0, round * 10 + i));
+            }
+            for i in 0..3 {
+                assert_eq!(ring.pop(), Some(edge(i % 2 == 0, round * 10 + i)));
+            }
+            assert_eq!(ring.pop(), None);
+        }
+        assert_eq!(ring.pushed(), 30);
+        assert_eq!(ring.overwritten(), 0);
+    }
+
+    #[test]
+    fn full_ring_overwrites_the_oldest_edges() {
+        let ring = EdgeRing::with_capacity(4);
+        for i in 0..7 {
+            ring.push_edge(edge(i % 2 == 0, i));
+        }
+        assert_eq!(ring.overwritten(), 3);
+        for i in 3..7 {
+            assert_eq!(ring.pop(), Some(edge(i % 2 == 0, i)));
+        }
+        assert_eq!(ring.pop(), None);
+    }
+
+    #[test]
+    fn take_latest_coalesces_pending_edges() {
+        let ring = EdgeRing::with_capacity(8);
+        assert_eq!(take_latest(&ring), None);
+        ring.push_edge(edge(true, 1));
+        assert_eq!(take_latest(&ring), Some((edge(true, 1), 0)));
+        for i in 2..7 {
+            ring.push_edge(edge(i % 2 == 1, i));
+        }
+        assert_eq!(take_latest(&ring), Some((edge(false, 6), 4)));
+        assert_eq!(take_latest(&ring), None);
+
+        // Coalescing still ends at the newest edge after the ring overwrote older ones.
+        for i in 0..20 {
+            ring.push_edge(edge(i % 2 == 0, 100 + i));
+        }
+        assert_eq!(take_latest(&ring), Some((edge(false, 119), 7)));
+        assert_eq!(ring.overwritten(), 12);
+    }
+}
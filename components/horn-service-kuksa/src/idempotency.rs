@@ -0,0 +1,193 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use horn_proto::horn_idempotency::IdempotentActivateHornRequest;
+use log::debug;
+use protobuf::Message;
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{HashMap, VecDeque};
+use std::hash::{Hash, Hasher};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+use tokio::sync::watch;
+
+use crate::clock;
+use crate::deadline::Deadline;
+
+// Outcome of an activation as returned to the client: google.rpc.Code and message.
+pub(crate) type Outcome = (i32, String);
+
+// Result of looking up the idempotency key of an activation.
+pub(crate) enum Lookup {
+    // The key is new. The request is played and its outcome passed to 'complete'.
+    New(Claim),
+    // The key belongs to an earlier request with the same content. Its outcome,
+    // once known, is the answer to this one.
+    Duplicate(watch::Receiver<Option<Outcome>>),
+    // The key belongs to an earlier request with different content.
+    Conflict,
+}
+
+// Ties the outcome of a new request to its entry.
+pub(crate) struct Claim {
+    key: String,
+    generation: u64,
+}
+
+struct Entry {
+    fingerprint: u64,
+    generation: u64,
+    outcome: watch::Sender<Option<Outcome>>,
+}
+
+struct Entries {
+    map: HashMap<String, Entry>,
+    // Keys in the order they were inserted, for eviction. A key removed from 'map'
+    // early stays here until it reaches the front, its generation tells it apart
+    // from a later entry with the same key.
+    order: VecDeque<(String, u64, SystemTime)>,
+    generation: u64,
+}
+
+// Bounded cache of the idempotency keys of recent activations. A client retrying an
+// activation after a timeout sends the same key, and the retry is answered with the
+// outcome of the original instead of restarting its sequence. Keys are kept for
+// 'window' after their request arrived and at most 'capacity' of them, the oldest
+// making room first; lookups and insertions are O(1).
+pub(crate) struct IdempotencyCache {
+    capacity: usize,
+    window: Duration,
+    entries: Mutex<Entries>,
+    duplicates: AtomicU64,
+}
+
+impl IdempotencyCache {
+    pub fn new(capacity: usize, window: Duration) -> Self {
+        Self {
+            capacity,
+            window,
+            entries: Mutex::new(Entries {
+                map: HashMap::with_capacity(capacity),
+                order: VecDeque::with_capacity(capacity),
+                generation: 0,
+            }),
+            duplicates: AtomicU64::new(0),
+        }
+    }
+
+    pub fn lookup(&self, key: &str, request: &IdempotentActivateHornRequest) -> Lookup {
+        let fingerprint = fingerprint(request);
+        let now = clock::now();
+        let mut entries = self.entries.lock().unwrap();
+        entries.evict(
+            self.capacity.saturating_sub(1),
+            now.checked_sub(self.window).unwrap_or(UNIX_EPOCH),
+        );
+
+        if let Some(entry) = entries.map.get(key) {
+            if entry.fingerprint != fingerprint {
+                return Lookup::Conflict;
+            }
+            let duplicates = self.duplicates.fetch_add(1, Ordering::Relaxed) + 1;
+            debug!("Request with idempotency key '{key}' is a retry ({duplicates} retries so far)");
+            return Lookup::Duplicate(entry.outcome.subscribe());
+        }
+
+        entries.generation += 1;
+        let generation = entries.generation;
+        entries.map.insert(
+            key.to_string(),
+            Entry {
+                fingerprint,
+                generation,
+                outcome: watch::Sender::new(None),
+            },
+        );
+        entries.order.push_back((key.to_string(), generation, now));
+        Lookup::New(Claim {
+            key: key.to_string(),
+            generation,
+        })
+    }
+
+    // Records the outcome of a new request and passes it to the retries waiting for
+    // it. A rejected request played nothing, so its key is released and a later
+    // retry is handled like a new request.
+    pub fn complete(&self, claim: Claim, outcome: Outcome) {
+        let mut entries = self.entries.lock().unwrap();
+        let Some(entry) = entries.map.get(&claim.key) else {
+            return;
+        };
+        if entry.generation != claim.generation {
+            return;
+        }
+        let rejected = outcome.0 != 0;
+        entry.outcome.send_replace(Some(outcome));
+        if rejected {
+            entries.map.remove(&claim.key);
+        }
+    }
+
+    // Waits until the original request of a retry has an outcome, at most until
+    // 'deadline'. 'None' if it has none by then.
+    pub async fn outcome_of(
+        mut original: watch::Receiver<Option<Outcome>>,
+        deadline: Deadline,
+    ) -> Option<Outcome> {
+        let outcome =
+            tokio::time::timeout(deadline.remaining(), original.wait_for(Option::is_some))
+                .await
+                .ok()?
+                .ok()?
+                .clone();
+        outcome
+    }
+
+    // Number of retries answered from the cache so far.
+    pub fn duplicates(&self) -> u64 {
+        self.duplicates.load(Ordering::Relaxed)
+    }
+}
+
+impl Entries {
+    // Drops the oldest keys until at most 'keep' remain and none arrived before 'since'.
+    fn evict(&mut self, keep: usize, since: SystemTime) {
+        while let Some((key, generation, inserted)) = self.order.front() {
+            if self.order.len() <= keep && *inserted >= since {
+                break;
+            }
+            if self
+                .map
+                .get(key)
+                .is_some_and(|entry| entry.generation == *generation)
+            {
+                self.map.remove(key);
+            }
+            self.order.pop_front();
+        }
+    }
+}
+
+// Hash of the request without its key, to tell a retry from a different request
+// that reuses the key.
+fn fingerprint(request: &IdempotentActivateHornRequest) -> u64 {
+    let mut request = request.clone();
+    request.idempotency_key.clear();
+    let mut hasher = DefaultHasher::new();
+    request
+        .write_to_bytes()
+        .unwrap_or_default()
+        .hash(&mut hasher);
+    hasher.finish()
+}
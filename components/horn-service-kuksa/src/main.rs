@@ -15,31 +15,66 @@ use clap::Parser;
 use env_logger::Env;
 use log::info;
 use std::sync::Arc;
+use std::time::Duration;
 use up_rust::communication::{InMemoryRpcServer, RpcServer};
 use up_transport_zenoh::UPTransportZenoh;
 
+mod clock;
 mod config;
 mod connections;
+mod deadline;
+mod edge_ring;
+mod idempotency;
 mod request_handler;
 mod request_processor;
+#[cfg(any(test, feature = "simulation"))]
+mod simulation;
 
 const ACTIVATE_HORN_METHOD_ID: u16 = 0x0001;
 const DEACTIVATE_HORN_METHOD_ID: u16 = 0x0002;
+// Number of horn edges the sequence player may record ahead of the databroker writer
+const EDGE_RING_CAPACITY: usize = 64;
 
 #[tokio::main]
 async fn main() -> Result<(), Box<dyn std::error::Error>> {
     env_logger::Builder::from_env(Env::default().default_filter_or("info")).init();
     info!("Starting the Horn service");
     let args = config::Args::parse();
-    let (tx_kuksa, rx_kuksa) = tokio::sync::mpsc::channel(32);
+    let request_deadline = Duration::from_millis(args.request_deadline_ms);
+    let heartbeat = Duration::from_millis(args.heartbeat_interval_ms);
+    let idempotency_keys = args.idempotency_keys;
+    let idempotency_window = Duration::from_millis(args.idempotency_window_ms);
+    #[cfg(feature = "simulation")]
+    if let Some(seed) = args.simulate_seed {
+        // The simulation brings its own runtime with a paused clock.
+        let duration = Duration::from_secs(args.simulate_hours * 3600);
+        let lease = Duration::from_millis(args.simulate_lease_ms);
+        let retries = args.simulate_retries;
+        return std::thread::spawn(move || {
+            simulation::run(
+                seed,
+                duration,
+                request_deadline,
+                heartbeat,
+                lease,
+                retries,
+                idempotency_keys,
+                idempotency_window,
+            )
+        })
+        .join()
+        .map_err(|_| "the simulation panicked".into());
+    }
+    let edges = Arc::new(edge_ring::EdgeRing::with_capacity(EDGE_RING_CAPACITY));
     if args.kuksa_enabled {
         tokio::spawn(connections::send_to_databroker(
-            rx_kuksa,
+            edges.clone(),
             args.kuksa_address.clone(),
+            request_deadline,
         ));
     } else {
         info!("Printing the horn signal to the terminal since the connection with Kuksa databroker is not enabled (use -k flag).");
-        tokio::spawn(connections::send_to_terminal(rx_kuksa));
+        tokio::spawn(connections::send_to_terminal(edges.clone()));
     }
 
     let zenoh_config = args.get_zenoh_config()?;
@@ -52,15 +87,24 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     let (tx_sequence, rx_sequence) = tokio::sync::mpsc::channel(4);
     tokio::spawn(request_processor::receive_requests(
         rx_sequence,
-        tx_kuksa.clone(),
+        edges.clone(),
+        heartbeat,
     ));
 
-    let activate_horn_op = Arc::new(request_handler::ActivateHorn::new(tx_sequence.clone()));
+    let activate_horn_op = Arc::new(request_handler::ActivateHorn::new(
+        tx_sequence.clone(),
+        request_deadline,
+        (idempotency_keys > 0)
+            .then(|| idempotency::IdempotencyCache::new(idempotency_keys, idempotency_window)),
+    ));
     rpc_server
         .register_endpoint(None, ACTIVATE_HORN_METHOD_ID, activate_horn_op)
         .await?;
 
-    let deactivate_horn_op = Arc::new(request_handler::DeactivateHorn::new(tx_sequence.clone()));
+    let deactivate_horn_op = Arc::new(request_handler::DeactivateHorn::new(
+        tx_sequence.clone(),
+        request_deadline,
+    ));
     rpc_server
         .register_endpoint(None, DEACTIVATE_HORN_METHOD_ID, deactivate_horn_op)
         .await?;
@@ -11,26 +11,74 @@
 * SPDX-License-Identifier: EPL-2.0
 *******************************************************************************/
 
+use horn_proto::horn_idempotency::IdempotentActivateHornRequest;
 use horn_proto::horn_service::{
     ActivateHornRequest, ActivateHornResponse, DeactivateHornRequest, DeactivateHornResponse,
 };
 use horn_proto::status::Status;
 use log::info;
 use protobuf::MessageField;
+use std::time::Duration;
 use up_rust::communication::{RequestHandler, ServiceInvocationError, UPayload};
 
+use crate::deadline::{Deadline, ExpiredCounter};
+use crate::idempotency::{IdempotencyCache, Lookup, Outcome};
+use crate::request_processor::Command;
+
+// google.rpc.Code returned when an idempotency key is reused for a different request
+const INVALID_ARGUMENT: i32 = 3;
+// google.rpc.Code returned when a request could not be queued before its deadline
+const DEADLINE_EXCEEDED: i32 = 4;
+
+static EXPIRED_REQUESTS: ExpiredCounter = ExpiredCounter::new("request handler");
+
 pub(crate) struct ActivateHorn {
-    tx_sequence_channel: tokio::sync::mpsc::Sender<Option<ActivateHornRequest>>,
+    tx_sequence_channel: tokio::sync::mpsc::Sender<Command>,
+    request_deadline: Duration,
+    keys: Option<IdempotencyCache>,
 }
 
 impl ActivateHorn {
+    // 'keys' remembers the idempotency keys of recent requests; without it every
+    // request is played, retries included.
     pub fn new(
-        tx_sequence_channel: tokio::sync::mpsc::Sender<Option<ActivateHornRequest>>,
+        tx_sequence_channel: tokio::sync::mpsc::Sender<Command>,
+        request_deadline: Duration,
+        keys: Option<IdempotencyCache>,
     ) -> Self {
         Self {
             tx_sequence_channel,
+            request_deadline,
+            keys,
         }
     }
+
+    // Number of retries answered with the outcome of their original request.
+    pub fn duplicates(&self) -> u64 {
+        self.keys.as_ref().map_or(0, IdempotencyCache::duplicates)
+    }
+
+    // Queues the request for the sequence player and returns its google.rpc.Code and message.
+    async fn play(&self, req: ActivateHornRequest, deadline: Deadline) -> Outcome {
+        let command = Command {
+            request: Some(req),
+            deadline,
+        };
+
+        // While the player is busy the channel fills up. A request that cannot be
+        // queued in time is rejected instead of being played late.
+        if tokio::time::timeout(deadline.remaining(), self.tx_sequence_channel.send(command))
+            .await
+            .is_err()
+        {
+            EXPIRED_REQUESTS.record("a horn request", &deadline);
+            return (
+                DEADLINE_EXCEEDED,
+                "the horn request could not be queued before its deadline".to_string(),
+            );
+        }
+        (0, String::new())
+    }
 }
 
 #[async_trait::async_trait]
@@ -42,14 +90,46 @@ impl RequestHandler for ActivateHorn {
     ) -> Result<Option<UPayload>, ServiceInvocationError> {
         info!("Handle new request to apply horn sequence");
 
-        let req = request_payload
-            .unwrap()
-            .extract_protobuf::<ActivateHornRequest>()
-            .unwrap();
-        let _ = self.tx_sequence_channel.send(Some(req.clone())).await;
+        // The handler does not see the TTL of the request message, so the deadline
+        // starts when the request arrives here.
+        let deadline = Deadline::after(self.request_deadline);
+        let req = decode_activation(request_payload)?;
+
+        // A retry of a request seen before gets the original outcome and does not
+        // restart the sequence.
+        let (code, message) = match self
+            .keys
+            .as_ref()
+            .filter(|_| !req.idempotency_key.is_empty())
+        {
+            None => self.play(activation(req), deadline).await,
+            Some(keys) => match keys.lookup(&req.idempotency_key, &req) {
+                Lookup::New(claim) => {
+                    let outcome = self.play(activation(req), deadline).await;
+                    keys.complete(claim, outcome.clone());
+                    outcome
+                }
+                Lookup::Duplicate(original) => IdempotencyCache::outcome_of(original, deadline)
+                    .await
+                    .unwrap_or_else(|| {
+                        (
+                            DEADLINE_EXCEEDED,
+                            "the original horn request was not queued before the deadline"
+                                .to_string(),
+                        )
+                    }),
+                Lookup::Conflict => (
+                    INVALID_ARGUMENT,
+                    "the idempotency key was used for a different horn request".to_string(),
+                ),
+            },
+        };
+        let mut status = Status::new();
+        status.code = code;
+        status.message = message;
 
         let response = ActivateHornResponse {
-            status: MessageField::some(Status::new()),
+            status: MessageField::some(status),
             ..Default::default()
         };
         let payload = UPayload::try_from_protobuf(response).unwrap();
@@ -57,16 +137,58 @@ impl RequestHandler for ActivateHorn {
     }
 }
 
+// Clients that want retries recognized send the local IdempotentActivateHornRequest,
+// all others the COVESA ActivateHornRequest. The payload names the message type,
+// so the wrapper is tried first and a plain request is taken as one without a key.
+// A missing payload or any other message is rejected as an invalid argument.
+fn decode_activation(
+    payload: Option<UPayload>,
+) -> Result<IdempotentActivateHornRequest, ServiceInvocationError> {
+    let payload = payload.ok_or_else(|| {
+        ServiceInvocationError::InvalidArgument("the horn request has no payload".to_string())
+    })?;
+    if let Ok(req) = payload
+        .clone()
+        .extract_protobuf::<IdempotentActivateHornRequest>()
+    {
+        return Ok(req);
+    }
+    let req = payload
+        .extract_protobuf::<ActivateHornRequest>()
+        .map_err(|_| {
+            ServiceInvocationError::InvalidArgument(
+                "the payload is not an ActivateHornRequest".to_string(),
+            )
+        })?;
+    Ok(IdempotentActivateHornRequest {
+        mode: req.mode,
+        command: req.command,
+        ..Default::default()
+    })
+}
+
+// The request the sequence player plays, without the key.
+fn activation(req: IdempotentActivateHornRequest) -> ActivateHornRequest {
+    ActivateHornRequest {
+        mode: req.mode,
+        command: req.command,
+        ..Default::default()
+    }
+}
+
 pub(crate) struct DeactivateHorn {
-    tx_sequence_channel: tokio::sync::mpsc::Sender<Option<ActivateHornRequest>>,
+    tx_sequence_channel: tokio::sync::mpsc::Sender<Command>,
+    request_deadline: Duration,
 }
 
 impl DeactivateHorn {
     pub fn new(
-        tx_sequence_channel: tokio::sync::mpsc::Sender<Option<ActivateHornRequest>>,
+        tx_sequence_channel: tokio::sync::mpsc::Sender<Command>,
+        request_deadline: Duration,
     ) -> Self {
         Self {
             tx_sequence_channel,
+            request_deadline,
         }
     }
 }
@@ -86,7 +208,12 @@ impl RequestHandler for DeactivateHorn {
             .unwrap()
             .extract_protobuf::<DeactivateHornRequest>()
             .unwrap();
-        let _ = self.tx_sequence_channel.send(None).await;
+        // Turning the horn off is never dropped, however late it is.
+        let command = Command {
+            request: None,
+            deadline: Deadline::after(self.request_deadline),
+        };
+        let _ = self.tx_sequence_channel.send(command).await;
         let response = DeactivateHornResponse {
             status: MessageField::some(Status::new()),
             ..Default::default()
@@ -95,3 +222,45 @@ impl RequestHandler for DeactivateHorn {
         Ok(Some(payload))
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use horn_proto::horn_topics::HornMode;
+
+    #[test]
+    fn decode_activation_takes_a_plain_request_as_one_without_a_key() {
+        let req = ActivateHornRequest {
+            mode: HornMode::HM_CONTINUOUS.into(),
+            ..Default::default()
+        };
+        let decoded = decode_activation(Some(UPayload::try_from_protobuf(req).unwrap())).unwrap();
+        assert_eq!(decoded.mode, HornMode::HM_CONTINUOUS.into());
+        assert!(decoded.idempotency_key.is_empty());
+    }
+
+    #[test]
+    fn decode_activation_keeps_the_key_of_the_wrapper() {
+        let req = IdempotentActivateHornRequest {
+            mode: HornMode::HM_SEQUENCED.into(),
+            idempotency_key: "key".to_string(),
+            ..Default::default()
+        };
+        let decoded = decode_activation(Some(UPayload::try_from_protobuf(req).unwrap())).unwrap();
+        assert_eq!(decoded.mode, HornMode::HM_SEQUENCED.into());
+        assert_eq!(decoded.idempotency_key, "key");
+    }
+
+    #[test]
+    fn decode_activation_rejects_a_missing_or_foreign_payload() {
+        assert!(matches!(
+            decode_activation(None),
+            Err(ServiceInvocationError::InvalidArgument(_))
+        ));
+        let foreign = UPayload::try_from_protobuf(DeactivateHornRequest::default()).unwrap();
+        assert!(matches!(
+            decode_activation(Some(foreign)),
+            Err(ServiceInvocationError::InvalidArgument(_))
+        ));
+    }
+}
@@ -13,48 +13,75 @@
 
 use horn_proto::{horn_service::ActivateHornRequest, horn_topics::{HornMode, HornSequence}};
 use log::{debug, error};
+use std::sync::Arc;
+use std::time::Duration;
 use tokio::select;
+use tokio::time::{sleep_until, Instant};
 
-// Listens to the request channel and applies the requests. When the channel returns 'None',
+use crate::deadline::{Deadline, ExpiredCounter};
+use crate::edge_ring::EdgeRing;
+
+static EXPIRED_REQUESTS: ExpiredCounter = ExpiredCounter::new("sequence player");
+
+// A request handed from the RPC handlers to the sequence player, together with the
+// deadline by which it has to start. A 'None' request deactivates the horn.
+pub(crate) struct Command {
+    pub request: Option<ActivateHornRequest>,
+    pub deadline: Deadline,
+}
+
+// Listens to the request channel and applies the requests. When the command holds no request,
 // 'receive_requests' stops the execution of the previous request and the horn is deactived.
+// While the horn is on, the 'true' edge is repeated every 'heartbeat' as a lease renewal for
+// the actuator; a zero 'heartbeat' sends every edge once.
 pub(crate) async fn receive_requests(
-    mut rx_request_channel: tokio::sync::mpsc::Receiver<Option<ActivateHornRequest>>, 
-    tx_kuksa: tokio::sync::mpsc::Sender<bool>) {
-    let mut request;
-    while let Some(request_inner) = rx_request_channel.recv().await {
-        request = Some(request_inner);
-        while request.is_some() {
-            request = select! {
-                req = rx_request_channel.recv() => req,
-                req = request_apply(request.unwrap(), tx_kuksa.clone()) => req,
+    mut rx_request_channel: tokio::sync::mpsc::Receiver<Command>, 
+    edges: Arc<EdgeRing>,
+    heartbeat: Duration) {
+    let mut command;
+    while let Some(command_inner) = rx_request_channel.recv().await {
+        command = Some(command_inner);
+        while command.is_some() {
+            // Polling the channel first lets a new command preempt the running one
+            // deterministically when both are ready in the same instant.
+            command = select! {
+                biased;
+                cmd = rx_request_channel.recv() => cmd,
+                cmd = request_apply(command.unwrap(), edges.clone(), heartbeat) => cmd,
             }
         };
     }
 }
 
-async fn request_apply(request: Option<ActivateHornRequest>, tx_kuksa: tokio::sync::mpsc::Sender<bool>) -> Option<Option<ActivateHornRequest>> {
-    match request {
+async fn request_apply(command: Command, edges: Arc<EdgeRing>, heartbeat: Duration) -> Option<Command> {
+    match command.request {
         Some(request_inner) => {
-            horn_request_apply(request_inner, tx_kuksa).await;
+            // A request that waited past its deadline is dropped before it makes a sound.
+            // Deactivations below are always applied.
+            if command.deadline.is_expired() {
+                EXPIRED_REQUESTS.record("a horn request", &command.deadline);
+            } else {
+                horn_request_apply(request_inner, edges, heartbeat).await;
+            }
             None
         },
         None => {
             // treat None as a signal to deactivate the horn
-            let _ = tx_kuksa.send(false).await;
+            edges.push(false);
             None
         },
     }
 }
 
-pub async fn horn_request_apply(req: ActivateHornRequest, tx_kuksa: tokio::sync::mpsc::Sender<bool>) {
+pub async fn horn_request_apply(req: ActivateHornRequest, edges: Arc<EdgeRing>, heartbeat: Duration) {
     match req.mode.enum_value() {
         Ok(mode) => {
             match mode {
                 HornMode::HM_SEQUENCED => {
                     let sequences = req.command;
-                    horn_sequence_apply(sequences, tx_kuksa).await;
+                    horn_sequence_apply(sequences, edges, heartbeat).await;
                 },
-                HornMode::HM_CONTINUOUS => horn_continous_apply(tx_kuksa).await,
+                HornMode::HM_CONTINUOUS => horn_continous_apply(edges, heartbeat).await,
                 HornMode::HM_UNKNOWN => println!("Horn Mode: Unknown"),
                 HornMode::HM_UNSPECIFIED => println!("Horn Mode: Unspecified"),
             };
@@ -64,19 +91,138 @@ pub async fn horn_request_apply(req: ActivateHornRequest, tx_kuksa: tokio::sync:
 }
 
 
-pub async fn horn_continous_apply(tx_kuksa: tokio::sync::mpsc::Sender<bool>) {
+// Keeps the horn on until the next command preempts the player.
+pub async fn horn_continous_apply(edges: Arc<EdgeRing>, heartbeat: Duration) {
     debug!("Starting Continous Horn");
-    let _ = tx_kuksa.send(true).await;
+    hold_on(&edges, None, heartbeat).await;
 }
 
-pub async fn horn_sequence_apply(sequences: Vec<HornSequence>, tx_kuksa: tokio::sync::mpsc::Sender<bool>) {
+// Switches the horn on and keeps it on until 'until', or until the player is preempted
+// if there is none. Every 'heartbeat' the 'true' edge is pushed again, so an actuator
+// that holds the horn on only for a lease turns it off soon after the service stops.
+async fn hold_on(edges: &EdgeRing, until: Option<Instant>, heartbeat: Duration) {
+    edges.push(true);
+    if heartbeat.is_zero() {
+        if let Some(until) = until {
+            sleep_until(until).await;
+        }
+        return;
+    }
+    let mut next = Instant::now() + heartbeat;
+    loop {
+        if let Some(until) = until.filter(|until| *until <= next) {
+            sleep_until(until).await;
+            return;
+        }
+        sleep_until(next).await;
+        edges.push(true);
+        next += heartbeat;
+    }
+}
+
+// Edges are scheduled at absolute instants from the start of the sequence, so late
+// wake-ups do not add up over long sequences.
+pub async fn horn_sequence_apply(sequences: Vec<HornSequence>, edges: Arc<EdgeRing>, heartbeat: Duration) {
+    let mut next = Instant::now();
     for sequence in sequences {
         for cycle in sequence.horn_cycles {
             debug!("\nOn Time: {}, Off Time: {}", cycle.on_time, cycle.off_time);
-            let _ = tx_kuksa.send(true).await;
-            let _ = tokio::time::sleep(std::time::Duration::from_millis(cycle.on_time as u64)).await;
-            let _ = tx_kuksa.send(false).await;
-            let _ = tokio::time::sleep(std::time::Duration::from_millis(cycle.off_time as u64)).await;
+            next += Duration::from_millis(cycle.on_time as u64);
+            hold_on(&edges, Some(next), heartbeat).await;
+            edges.push(false);
+            next += Duration::from_millis(cycle.off_time as u64);
+            sleep_until(next).await;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::clock;
+    use crate::connections::take_latest;
+    use crate::edge_ring::Edge;
+    use horn_proto::horn_topics::HornCycle;
+    use std::time::{SystemTime, UNIX_EPOCH};
+
+    const CYCLES: u64 = 20;
+    const PERIOD_MS: u64 = 50;
+
+    // Plays a sequence of 'CYCLES' on/off cycles of 'PERIOD_MS' each while a writer
+    // that needs 'write_latency' per databroker write drains the ring.
+    // Returns every delivered edge with the number of edges it superseded and its lag.
+    async fn play_against_slow_broker(
+        write_latency: Duration,
+    ) -> (Arc<EdgeRing>, Vec<(Edge, u64, Duration)>) {
+        clock::start_virtual(UNIX_EPOCH);
+        let edges = Arc::new(EdgeRing::with_capacity(crate::EDGE_RING_CAPACITY));
+        let writer = {
+            let edges = edges.clone();
+            tokio::spawn(async move {
+                let mut delivered = Vec::new();
+                loop {
+                    edges.wait().await;
+                    while let Some((edge, coalesced)) = take_latest(&edges) {
+                        let last = edges.pushed() == 2 * CYCLES;
+                        tokio::time::sleep(write_latency).await;
+                        let lag = clock::now().duration_since(edge.timestamp).unwrap();
+                        delivered.push((edge, coalesced, lag));
+                        if last {
+                            return delivered;
+                        }
+                    }
+                }
+            })
+        };
+        let sequence = HornSequence {
+            horn_cycles: (0..CYCLES)
+                .map(|_| HornCycle {
+                    on_time: PERIOD_MS as i32,
+                    off_time: PERIOD_MS as i32,
+                    ..Default::default()
+                })
+                .collect(),
+            ..Default::default()
+        };
+        horn_sequence_apply(vec![sequence], edges.clone(), Duration::ZERO).await;
+        (edges, writer.await.unwrap())
+    }
+
+    fn millis(timestamp: SystemTime) -> u64 {
+        timestamp.duration_since(UNIX_EPOCH).unwrap().as_millis() as u64
+    }
+
+    // The player records every edge on schedule however slow the databroker is; a slow
+    // writer only coalesces edges and always ends on the final state.
+    #[tokio::test(start_paused = true)]
+    async fn sequence_timing_is_independent_of_a_slow_broker() {
+        for write_latency_ms in [0, 20, 70, 120, 500] {
+            let write_latency = Duration::from_millis(write_latency_ms);
+            let (edges, delivered) = play_against_slow_broker(write_latency).await;
+            assert_eq!(edges.pushed(), 2 * CYCLES);
+            assert_eq!(edges.overwritten(), 0);
+
+            let mut superseded = 0;
+            let mut max_lag = Duration::ZERO;
+            for (edge, coalesced, lag) in &delivered {
+                // Edge k is played at k * PERIOD_MS, on for even k and off for odd k.
+                let at = millis(edge.timestamp);
+                assert_eq!(at % PERIOD_MS, 0, "edge off schedule at {at} ms");
+                assert_eq!(edge.is_active, (at / PERIOD_MS) % 2 == 0);
+                superseded += coalesced;
+                max_lag = max_lag.max(*lag);
+            }
+            let (last, _, _) = delivered.last().unwrap();
+            assert!(!last.is_active);
+            assert_eq!(millis(last.timestamp), (2 * CYCLES - 1) * PERIOD_MS);
+            assert_eq!(delivered.len() as u64 + superseded, 2 * CYCLES);
+            if write_latency_ms < PERIOD_MS {
+                assert_eq!(superseded, 0);
+            }
+            println!(
+                "write latency {write_latency:?}: {} edges written, {superseded} coalesced, max lag {max_lag:?}",
+                delivered.len(),
+            );
         }
     }
 }
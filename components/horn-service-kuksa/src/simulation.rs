@@ -0,0 +1,498 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+// Built for the unit tests as well, which do not use the entry point of the --simulate-* options.
+#![cfg_attr(not(feature = "simulation"), allow(dead_code))]
+
+use horn_proto::horn_idempotency::IdempotentActivateHornRequest;
+use horn_proto::horn_service::{ActivateHornResponse, DeactivateHornRequest};
+use horn_proto::horn_topics::{HornCycle, HornMode, HornSequence};
+use log::info;
+use std::cell::RefCell;
+use std::rc::Rc;
+use std::sync::Arc;
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+use tokio::select;
+use tokio::sync::mpsc::{unbounded_channel, UnboundedReceiver, UnboundedSender};
+use tokio::time::{sleep, sleep_until, Instant};
+use up_rust::communication::{RequestHandler, UPayload};
+
+use crate::clock;
+use crate::connections::take_latest;
+use crate::deadline::Deadline;
+use crate::edge_ring::EdgeRing;
+use crate::idempotency::{IdempotencyCache, Lookup};
+use crate::request_handler::{ActivateHorn, DeactivateHorn};
+use crate::request_processor::{self, Command};
+use crate::{ACTIVATE_HORN_METHOD_ID, DEACTIVATE_HORN_METHOD_ID, EDGE_RING_CAPACITY};
+
+// Wall-clock time at which every simulation starts, so edge timestamps repeat too.
+const SIMULATION_EPOCH: Duration = Duration::from_secs(1_700_000_000);
+// Time given to the pipeline to settle after the last request.
+const DRAIN_TIME: Duration = Duration::from_secs(60);
+// How long the horn is on continuously before the service is stopped at the end.
+const CRASH_AFTER: Duration = Duration::from_secs(10);
+// One in this many messages is stalled past any request deadline.
+const STALL_ONE_IN: u64 = 50;
+// Lookups of known keys timed to measure the cost of answering a retry.
+const DUPLICATE_LOOKUPS: u32 = 100_000;
+
+// SplitMix64, enough to drive a scenario and reproducible across platforms.
+struct Rng(u64);
+
+impl Rng {
+    fn next_u64(&mut self) -> u64 {
+        self.0 = self.0.wrapping_add(0x9E37_79B9_7F4A_7C15);
+        let mut z = self.0;
+        z = (z ^ (z >> 30)).wrapping_mul(0xBF58_476D_1CE4_E5B9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94D0_49BB_1331_11EB);
+        z ^ (z >> 31)
+    }
+
+    // Uniform in 'low..=high'.
+    fn between(&mut self, low: u64, high: u64) -> u64 {
+        low + self.next_u64() % (high - low + 1)
+    }
+
+    // Message latency of the modelled network: a few milliseconds of jitter, and
+    // now and then a stall of several seconds.
+    fn latency(&mut self) -> Duration {
+        let ms = if self.next_u64() % STALL_ONE_IN == 0 {
+            self.between(1_000, 3_000)
+        } else {
+            self.between(2, 20)
+        };
+        Duration::from_millis(ms)
+    }
+}
+
+// What the modelled actuator observed.
+#[derive(Clone, Default)]
+struct Report {
+    requests: u64,
+    rejected: u64,
+    retries: u64,
+    // Retries answered with the outcome of their original request
+    duplicates: u64,
+    edges_played: u64,
+    edges_applied: u64,
+    edges_dropped: u64,
+    coalesced: u64,
+    on_time: Duration,
+    max_lag: Duration,
+    heartbeats: u64,
+    // Lease expiries while the service was running
+    lease_cutoffs: u64,
+    crashed_at: Option<SystemTime>,
+    // Time from stopping the service until the horn was off
+    crash_cutoff: Option<Duration>,
+    is_active: bool,
+    last_change: Option<SystemTime>,
+    // FNV-1a over the time and state of every applied edge, equal for equal runs
+    digest: u64,
+}
+
+impl Report {
+    fn apply(&mut self, is_active: bool, played: SystemTime) {
+        let now = clock::now();
+        self.edges_applied += 1;
+        self.max_lag = self
+            .max_lag
+            .max(now.duration_since(played).unwrap_or_default());
+        if let (true, Some(since)) = (self.is_active, self.last_change) {
+            self.on_time += now.duration_since(since).unwrap_or_default();
+        }
+        self.is_active = is_active;
+        self.last_change = Some(now);
+
+        let micros = now
+            .duration_since(UNIX_EPOCH)
+            .unwrap_or_default()
+            .as_micros() as u64;
+        for byte in ((micros << 1) | is_active as u64).to_le_bytes() {
+            self.digest = (self.digest ^ byte as u64).wrapping_mul(0x0000_0100_0000_01B3);
+        }
+    }
+
+    fn cut_off(&mut self) {
+        let now = clock::now();
+        self.apply(false, now);
+        match self.crashed_at {
+            Some(crashed_at) => {
+                self.crash_cutoff = self
+                    .crash_cutoff
+                    .or(Some(now.duration_since(crashed_at).unwrap_or_default()))
+            }
+            None => self.lease_cutoffs += 1,
+        }
+    }
+}
+
+fn random_request(rng: &mut Rng) -> Option<IdempotentActivateHornRequest> {
+    let mode = rng.between(0, 9);
+    if mode == 9 {
+        return None;
+    }
+    let mut request = IdempotentActivateHornRequest {
+        mode: HornMode::HM_CONTINUOUS.into(),
+        ..Default::default()
+    };
+    if mode < 7 {
+        request.mode = HornMode::HM_SEQUENCED.into();
+        request.command = (0..rng.between(1, 3))
+            .map(|_| HornSequence {
+                horn_cycles: (0..rng.between(1, 6))
+                    .map(|_| HornCycle {
+                        on_time: rng.between(30, 1_000) as i32,
+                        off_time: rng.between(30, 1_000) as i32,
+                        ..Default::default()
+                    })
+                    .collect(),
+                ..Default::default()
+            })
+            .collect();
+    }
+    Some(request)
+}
+
+// Delivers a request over the modelled network to the RPC handlers of the service.
+async fn deliver_request(
+    request: Option<IdempotentActivateHornRequest>,
+    latency: Duration,
+    activate: Rc<ActivateHorn>,
+    deactivate: Rc<DeactivateHorn>,
+    report: Rc<RefCell<Report>>,
+) {
+    tokio::time::sleep(latency).await;
+    let Some(request) = request else {
+        let payload = UPayload::try_from_protobuf(DeactivateHornRequest::default()).unwrap();
+        let _ = deactivate
+            .handle_request(DEACTIVATE_HORN_METHOD_ID, Some(payload))
+            .await;
+        return;
+    };
+    let payload = UPayload::try_from_protobuf(request).unwrap();
+    if let Ok(Some(payload)) = activate
+        .handle_request(ACTIVATE_HORN_METHOD_ID, Some(payload))
+        .await
+    {
+        let response = payload.extract_protobuf::<ActivateHornResponse>().unwrap();
+        if response.status.code != 0 {
+            report.borrow_mut().rejected += 1;
+        }
+    }
+}
+
+// Stands in for the databroker writer: every edge travels over the modelled network
+// and is dropped on the same deadline as in 'send_to_databroker'.
+async fn write_edges(
+    ring: Arc<EdgeRing>,
+    mut rng: Rng,
+    edge_deadline: Duration,
+    actuator: UnboundedSender<(bool, SystemTime)>,
+    report: Rc<RefCell<Report>>,
+) {
+    loop {
+        ring.wait().await;
+        while let Some((edge, coalesced)) = take_latest(&ring) {
+            report.borrow_mut().coalesced += coalesced;
+            let deadline = Deadline::at(edge.timestamp + edge_deadline);
+            if edge.is_active && deadline.is_expired() {
+                report.borrow_mut().edges_dropped += 1;
+                continue;
+            }
+            sleep(rng.latency()).await;
+            let _ = actuator.send((edge.is_active, edge.timestamp));
+        }
+    }
+}
+
+// Models the actuator: a 'true' while the horn is on only renews the lease, and the
+// horn is turned off when the lease runs out. A zero 'lease' holds the horn on.
+async fn actuate(
+    mut edges: UnboundedReceiver<(bool, SystemTime)>,
+    lease: Duration,
+    report: Rc<RefCell<Report>>,
+) {
+    let mut lease_end: Option<Instant> = None;
+    loop {
+        let expiry = async {
+            match lease_end {
+                Some(lease_end) => sleep_until(lease_end).await,
+                None => std::future::pending().await,
+            }
+        };
+        select! {
+            biased;
+            edge = edges.recv() => {
+                let Some((is_active, played)) = edge else {
+                    return;
+                };
+                let mut report = report.borrow_mut();
+                if is_active && report.is_active {
+                    report.heartbeats += 1;
+                } else {
+                    report.apply(is_active, played);
+                }
+                lease_end = (is_active && !lease.is_zero()).then(|| Instant::now() + lease);
+            }
+            _ = expiry => {
+                lease_end = None;
+                report.borrow_mut().cut_off();
+            }
+        }
+    }
+}
+
+// Times lookups of known keys in a full cache of 'capacity' keys, which is the work a
+// retry adds over a new request. Returns the mean time of a lookup.
+fn time_duplicate_lookups(capacity: usize, window: Duration, rng: &mut Rng) -> Duration {
+    let keys = IdempotencyCache::new(capacity, window);
+    let requests: Vec<IdempotentActivateHornRequest> = (0..capacity)
+        .filter_map(|n| {
+            let mut request = random_request(rng)?;
+            request.idempotency_key = format!("lookup-{n}");
+            Some(request)
+        })
+        .collect();
+    for request in &requests {
+        if let Lookup::New(claim) = keys.lookup(&request.idempotency_key, request) {
+            keys.complete(claim, (0, String::new()));
+        }
+    }
+    let started = std::time::Instant::now();
+    for request in requests.iter().cycle().take(DUPLICATE_LOOKUPS as usize) {
+        keys.lookup(&request.idempotency_key, request);
+    }
+    started.elapsed() / DUPLICATE_LOOKUPS
+}
+
+#[allow(clippy::too_many_arguments)]
+async fn simulate(
+    seed: u64,
+    duration: Duration,
+    request_deadline: Duration,
+    heartbeat: Duration,
+    lease: Duration,
+    retries: u32,
+    idempotency_keys: usize,
+    idempotency_window: Duration,
+) -> Report {
+    clock::start_virtual(UNIX_EPOCH + SIMULATION_EPOCH);
+    let mut traffic = Rng(seed);
+    let network = Rng(seed ^ 0xA5A5_A5A5_A5A5_A5A5);
+    // Retries get latencies of their own, so the scenario stays the same with and without them.
+    let mut retry_network = Rng(seed ^ 0x5A5A_5A5A_5A5A_5A5A);
+    let report = Rc::new(RefCell::new(Report::default()));
+
+    let edges = Arc::new(EdgeRing::with_capacity(EDGE_RING_CAPACITY));
+    let (tx_sequence, rx_sequence) = tokio::sync::mpsc::channel::<Command>(4);
+    let player = tokio::spawn(request_processor::receive_requests(
+        rx_sequence,
+        edges.clone(),
+        heartbeat,
+    ));
+    let activate = Rc::new(ActivateHorn::new(
+        tx_sequence.clone(),
+        request_deadline,
+        (idempotency_keys > 0).then(|| IdempotencyCache::new(idempotency_keys, idempotency_window)),
+    ));
+    let deactivate = Rc::new(DeactivateHorn::new(tx_sequence, request_deadline));
+
+    let local = tokio::task::LocalSet::new();
+    local
+        .run_until(async {
+            let (tx_actuator, rx_actuator) = unbounded_channel();
+            tokio::task::spawn_local(write_edges(
+                edges.clone(),
+                network,
+                request_deadline,
+                tx_actuator,
+                report.clone(),
+            ));
+            tokio::task::spawn_local(actuate(rx_actuator, lease, report.clone()));
+
+            let end = tokio::time::Instant::now() + duration;
+            let mut request_network = Rng(traffic.next_u64());
+            while tokio::time::Instant::now() < end {
+                tokio::time::sleep(Duration::from_secs(traffic.between(1, 120))).await;
+                let requests = {
+                    let mut report = report.borrow_mut();
+                    report.requests += 1;
+                    report.requests
+                };
+                let mut request = random_request(&mut traffic);
+                if let Some(request) = request.as_mut() {
+                    request.idempotency_key = format!("{seed:x}-{requests}");
+                }
+                // The client gives up on a reply after the request deadline and sends
+                // the activation again with the same key.
+                let request_retries = if request.is_some() { retries } else { 0 };
+                for retry in 1..=request_retries {
+                    report.borrow_mut().retries += 1;
+                    tokio::task::spawn_local(deliver_request(
+                        request.clone(),
+                        request_deadline * retry + retry_network.latency(),
+                        activate.clone(),
+                        deactivate.clone(),
+                        report.clone(),
+                    ));
+                }
+                tokio::task::spawn_local(deliver_request(
+                    request,
+                    request_network.latency(),
+                    activate.clone(),
+                    deactivate.clone(),
+                    report.clone(),
+                ));
+            }
+            sleep(DRAIN_TIME).await;
+
+            // Finally the horn is switched on continuously and the service stops.
+            let continuous = IdempotentActivateHornRequest {
+                mode: HornMode::HM_CONTINUOUS.into(),
+                ..Default::default()
+            };
+            deliver_request(
+                Some(continuous),
+                Duration::ZERO,
+                activate.clone(),
+                deactivate.clone(),
+                report.clone(),
+            )
+            .await;
+            sleep(CRASH_AFTER).await;
+            player.abort();
+            report.borrow_mut().crashed_at = Some(clock::now());
+            sleep(DRAIN_TIME).await;
+        })
+        .await;
+
+    let mut report = report.borrow().clone();
+    report.edges_played = edges.pushed();
+    report.duplicates = activate.duplicates();
+    report
+}
+
+// A current-thread runtime whose clock only advances when every task waits.
+fn paused_runtime() -> tokio::runtime::Runtime {
+    tokio::runtime::Builder::new_current_thread()
+        .enable_time()
+        .start_paused(true)
+        .build()
+        .expect("failed to build the simulation runtime")
+}
+
+// Runs the service's request handlers and sequence player for 'duration' of virtual
+// time against a modelled client, network and actuator, then stops the service while
+// the horn is on to measure how long the actuator's 'lease' keeps it on. The client
+// sends every activation 'retries' more times with the same idempotency key. The
+// scenario is derived from 'seed' alone, so two runs with the same seed produce the
+// same report. The virtual clock replaces the wall clock of the calling thread, so
+// the simulation runs on a thread of its own.
+#[allow(clippy::too_many_arguments)]
+pub(crate) fn run(
+    seed: u64,
+    duration: Duration,
+    request_deadline: Duration,
+    heartbeat: Duration,
+    lease: Duration,
+    retries: u32,
+    idempotency_keys: usize,
+    idempotency_window: Duration,
+) {
+    let runtime = paused_runtime();
+    let started = std::time::Instant::now();
+    let report = runtime.block_on(simulate(
+        seed,
+        duration,
+        request_deadline,
+        heartbeat,
+        lease,
+        retries,
+        idempotency_keys,
+        idempotency_window,
+    ));
+    info!(
+        "Simulated {:?} in {:?} (seed {seed}): {} requests, {} rejected; {} edges played, {} applied, {} dropped, {} coalesced; horn on for {:?}, max edge lag {:?}, digest {:016x}",
+        duration,
+        started.elapsed(),
+        report.requests,
+        report.rejected,
+        report.edges_played,
+        report.edges_applied,
+        report.edges_dropped,
+        report.coalesced,
+        report.on_time,
+        report.max_lag,
+        report.digest,
+    );
+    info!(
+        "Heartbeat {:?}, lease {:?}: {} heartbeats ({:.3}/s), {} lease cutoff(s) while the service ran, horn off {} after the service stopped",
+        heartbeat,
+        lease,
+        report.heartbeats,
+        report.heartbeats as f64 / duration.as_secs_f64(),
+        report.lease_cutoffs,
+        report
+            .crash_cutoff
+            .map_or("never".to_string(), |cutoff| format!("{cutoff:?}")),
+    );
+    if retries > 0 {
+        info!(
+            "{} retries, {} answered from {} idempotency keys",
+            report.retries, report.duplicates, idempotency_keys,
+        );
+    }
+    if idempotency_keys > 0 {
+        let lookup = runtime.block_on(async {
+            time_duplicate_lookups(idempotency_keys, idempotency_window, &mut Rng(seed))
+        });
+        info!("Answering a retry from {idempotency_keys} idempotency keys takes {lookup:?}");
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Digest of the edges applied in a day of seed 1 with the default settings. A
+    // change to the service or the model that alters the scenario changes it; update
+    // it only after checking that the new behaviour is intended.
+    const SEED_1_DIGEST: u64 = 0x1e88_5055_6378_3175;
+
+    fn simulate_day(seed: u64) -> Report {
+        paused_runtime().block_on(simulate(
+            seed,
+            Duration::from_secs(24 * 3600),
+            Duration::from_millis(1000),
+            Duration::from_millis(1000),
+            Duration::from_millis(3000),
+            0,
+            0,
+            Duration::from_millis(30000),
+        ))
+    }
+
+    #[test]
+    fn a_fixed_seed_reproduces_the_digest() {
+        let report = simulate_day(1);
+        assert!(report.edges_applied > 0);
+        assert_eq!(report.digest, simulate_day(1).digest);
+        assert_eq!(
+            report.digest, SEED_1_DIGEST,
+            "digest {:016x}",
+            report.digest
+        );
+    }
+}
@@ -0,0 +1,67 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+use std::collections::HashMap;
+use std::fmt;
+
+// State of a simulated actuator. Boolean signals, by far the most common ones,
+// are stored without an allocation; everything else keeps its text.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub enum Value {
+    Bool(bool),
+    Text(Box<str>),
+}
+
+impl Value {
+    pub fn parse(value: &str) -> Self {
+        match value {
+            "true" => Value::Bool(true),
+            "false" => Value::Bool(false),
+            other => Value::Text(other.into()),
+        }
+    }
+}
+
+impl fmt::Display for Value {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            Value::Bool(value) => write!(f, "{value}"),
+            Value::Text(value) => f.write_str(value),
+        }
+    }
+}
+
+// Latest state of every actuator served by the farm. Each key is stored once and
+// maps to a slot; the states live in one contiguous vector indexed by slot.
+#[derive(Default)]
+pub struct ActuatorTable {
+    slots: HashMap<Box<str>, u32>,
+    values: Vec<Value>,
+}
+
+impl ActuatorTable {
+    // Stores the new state of 'key', adding the actuator on its first value.
+    pub fn set(&mut self, key: &str, value: Value) {
+        match self.slots.get(key) {
+            Some(&slot) => self.values[slot as usize] = value,
+            None => {
+                self.slots.insert(key.into(), self.values.len() as u32);
+                self.values.push(value);
+            }
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.values.len()
+    }
+}
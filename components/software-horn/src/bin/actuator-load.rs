@@ -0,0 +1,134 @@
+/*******************************************************************************
+* Copyright (c) 2024 Contributors to the Eclipse Foundation
+*
+* See the NOTICE file(s) distributed with this work for additional
+* information regarding copyright ownership.
+*
+* This program and the accompanying materials are made available under the
+* terms of the Eclipse Public License 2.0 which is available at
+* http://www.eclipse.org/legal/epl-2.0
+*
+* SPDX-License-Identifier: EPL-2.0
+*******************************************************************************/
+
+// Load generator for the software actuator farm: publishes targetValues
+// round-robin over many keys at a fixed rate and measures the throughput and
+// latency of the currentValue echoes.
+
+use clap::Parser;
+use env_logger::Env;
+use log::{info, warn};
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::time::Instant;
+
+// Time to wait for outstanding echoes after the last targetValue was sent
+const DRAIN_TIME: Duration = Duration::from_secs(2);
+
+#[derive(clap::Parser)]
+struct Args {
+    #[arg(short, long, env = "ZENOH_CONFIG")]
+    /// A Zenoh configuration file.
+    config: PathBuf,
+    #[arg(long, default_value = "Vehicle/Load")]
+    /// Prefix of the generated keys, "<prefix>/Signal<n>".
+    /// Run the farm with the key expression "<prefix>/**".
+    prefix: String,
+    #[arg(long, default_value = "1000")]
+    /// Number of distinct keys.
+    keys: u64,
+    #[arg(long, default_value = "5000")]
+    /// targetValues sent per second.
+    rate: u64,
+    #[arg(long, default_value = "10")]
+    /// Duration of the run in seconds.
+    duration_s: u64,
+}
+
+#[tokio::main]
+async fn main() -> Result<(), Box<dyn std::error::Error>> {
+    env_logger::Builder::from_env(Env::default().default_filter_or("info")).init();
+    let args = Args::parse();
+    let zenoh_config = zenoh::config::Config::from_file(&args.config)?;
+    let session = zenoh::open(zenoh_config).await?;
+
+    let total = args.rate * args.duration_s;
+    let interval = Duration::from_secs_f64(1.0 / args.rate as f64);
+    // Send time of every message, in nanoseconds since the start of the run.
+    // The sequence number is the payload, the farm echoes it unchanged.
+    let sent: Arc<Vec<AtomicU64>> = Arc::new((0..total).map(|_| AtomicU64::new(0)).collect());
+
+    let subscriber = session
+        .declare_subscriber(format!("{}/**", args.prefix))
+        .await?;
+    let start = Instant::now();
+    let end = start + Duration::from_secs(args.duration_s) + DRAIN_TIME;
+
+    let receiver_sent = sent.clone();
+    let receiver = tokio::spawn(async move {
+        let mut latencies = Vec::with_capacity(receiver_sent.len());
+        while let Ok(Ok(sample)) = tokio::time::timeout_at(end, subscriber.recv_async()).await {
+            let is_echo = sample
+                .attachment()
+                .and_then(|a| a.try_to_string().ok().map(|v| v == "currentValue"))
+                .unwrap_or(false);
+            let seq = sample
+                .payload()
+                .try_to_string()
+                .ok()
+                .and_then(|v| v.parse::<usize>().ok());
+            if let (true, Some(seq)) = (is_echo, seq) {
+                if let Some(sent_ns) = receiver_sent.get(seq) {
+                    let received_ns = start.elapsed().as_nanos() as u64;
+                    let sent_ns = sent_ns.load(Ordering::Relaxed);
+                    latencies.push(Duration::from_nanos(received_ns.saturating_sub(sent_ns)));
+                }
+            }
+        }
+        latencies
+    });
+
+    info!(
+        "Sending {total} targetValues over {} keys at {}/s",
+        args.keys, args.rate
+    );
+    for seq in 0..total {
+        tokio::time::sleep_until(start + interval.mul_f64(seq as f64)).await;
+        sent[seq as usize].store(start.elapsed().as_nanos() as u64, Ordering::Relaxed);
+        if let Err(e) = session
+            .put(
+                format!("{}/Signal{}", args.prefix, seq % args.keys),
+                seq.to_string(),
+            )
+            .attachment("targetValue")
+            .await
+        {
+            warn!("failed to publish targetValue: {e}");
+        }
+    }
+    let send_time = start.elapsed();
+
+    let mut latencies = receiver.await?;
+    latencies.sort_unstable();
+    let percentile = |p: usize| {
+        latencies
+            .get((latencies.len() * p / 100).min(latencies.len().saturating_sub(1)))
+            .copied()
+            .unwrap_or_default()
+    };
+    info!(
+        "Sent {total} in {send_time:?} ({:.0}/s), received {} echoes ({:.1}%)",
+        total as f64 / send_time.as_secs_f64(),
+        latencies.len(),
+        latencies.len() as f64 * 100.0 / total.max(1) as f64
+    );
+    info!(
+        "Echo latency p50 {:?}, p99 {:?}, max {:?}",
+        percentile(50),
+        percentile(99),
+        latencies.last().copied().unwrap_or_default()
+    );
+    Ok(())
+}
@@ -15,10 +15,17 @@ use clap::Parser;
 use env_logger::Env;
 use log::{debug, error, info, warn};
 use std::path::PathBuf;
+use std::time::Duration;
+use tokio::sync::mpsc;
+use tokio::time::Instant;
 use zenoh::bytes::ZBytes;
-use zenoh::pubsub::Publisher;
+use zenoh::key_expr::KeyExpr;
 use zenoh::sample::Sample;
-use zenoh::Config;
+use zenoh::{Config, Session};
+
+mod actuators;
+
+use actuators::{ActuatorTable, Value};
 
 #[derive(clap::Parser)]
 pub struct Args {
@@ -27,6 +34,22 @@ pub struct Args {
     config: PathBuf,
     #[arg(short, long, default_value = "true", env = "IS_SOUND_ENABLED")]
     sound: bool,
+    #[arg(
+        short,
+        long,
+        default_value = "Vehicle/Body/Horn/IsActive",
+        env = "KEY_EXPR"
+    )]
+    /// The key expression of the simulated actuators.
+    /// A wildcard such as "Vehicle/**" serves every matching signal from one process.
+    key_expr: String,
+    #[arg(long, default_value = "0", env = "ACTUATION_DELAY_MS")]
+    /// Simulated time in milliseconds from receiving a targetValue to reporting
+    /// the currentValue.
+    actuation_delay_ms: u64,
+    #[arg(long, default_value = "10", env = "STATS_INTERVAL_S")]
+    /// Interval in seconds of the throughput statistics in the log, 0 to disable them.
+    stats_interval_s: u64,
 }
 
 impl Args {
@@ -36,6 +59,13 @@ impl Args {
     }
 }
 
+// A targetValue waiting for its simulated actuation to complete.
+struct Actuation {
+    due: Instant,
+    key_expr: KeyExpr<'static>,
+    value: Value,
+}
+
 #[tokio::main]
 async fn main() -> Result<(), Box<dyn std::error::Error>> {
     env_logger::Builder::from_env(Env::default().default_filter_or("info")).init();
@@ -43,48 +73,93 @@ async fn main() -> Result<(), Box<dyn std::error::Error>> {
     let zenoh_config = args.get_zenoh_config()?;
     info!("Starting the software horn connected over Eclipse Zenoh");
 
-    let horn_keyexpr = String::from("Vehicle/Body/Horn/IsActive");
-
     let session = zenoh::open(zenoh_config)
         .await
         .map_err(|e| e as Box<dyn std::error::Error>)?;
 
     let subscriber = session
-        .declare_subscriber(&horn_keyexpr)
+        .declare_subscriber(&args.key_expr)
         .await
         .map_err(|e| e as Box<dyn std::error::Error>)?;
+    debug!("Waiting for messages on topic: {}", &args.key_expr);
 
-    let publisher = session
-        .declare_publisher(&horn_keyexpr)
-        .await
-        .map_err(|e| e as Box<dyn std::error::Error>)?;
-    debug!("Waiting for messages on topic: {}", &horn_keyexpr);
+    // Every targetValue is delayed by the same amount, so actuations complete in
+    // the order they were received and a FIFO queue is all the scheduling needed.
+    let (tx_actuation, rx_actuation) = mpsc::unbounded_channel();
+    let delay = Duration::from_millis(args.actuation_delay_ms);
+    let single_actuator = !args.key_expr.contains('*');
+    tokio::spawn(actuate(
+        session.clone(),
+        rx_actuation,
+        Duration::from_secs(args.stats_interval_s),
+        single_actuator,
+    ));
 
     while let Ok(sample) = subscriber.recv_async().await {
-        if let Some(value_type) = extract_attachment_as_string(&sample) {
-            if value_type == "targetValue" {
-                match zbytes_to_string(sample.payload()) {
-                    Ok(value) => {
-                        if value == "true" {
-                            info!("activate Horn");
-                            pub_current_status(&publisher, true).await;
-                        } else {
-                            info!("deactivate Horn");
-                            pub_current_status(&publisher, false).await;
-                        }
-                    }
-                    Err(e) => error!("Payload from Zenoh message is not a String: {e}"),
+        if extract_attachment_as_string(&sample).as_deref() != Some("targetValue") {
+            continue;
+        }
+        match zbytes_to_string(sample.payload()) {
+            Ok(value) => {
+                let actuation = Actuation {
+                    due: Instant::now() + delay,
+                    key_expr: sample.key_expr().clone(),
+                    value: Value::parse(&value),
+                };
+                if tx_actuation.send(actuation).is_err() {
+                    break;
                 }
             }
+            Err(e) => error!("Payload from Zenoh message is not a String: {e}"),
         }
     }
 
     Ok(())
 }
 
-pub async fn pub_current_status(publisher: &Publisher<'_>, status: bool) {
-    if let Err(e) = publisher
-        .put(status.to_string())
+// Completes the actuations in order: updates the table and echoes the new state as currentValue.
+async fn actuate(
+    session: Session,
+    mut rx_actuation: mpsc::UnboundedReceiver<Actuation>,
+    stats_interval: Duration,
+    single_actuator: bool,
+) {
+    let mut table = ActuatorTable::default();
+    let mut actuated: u64 = 0;
+    let mut last_stats = Instant::now();
+
+    while let Some(actuation) = rx_actuation.recv().await {
+        tokio::time::sleep_until(actuation.due).await;
+        let key = actuation.key_expr.as_str();
+        if single_actuator {
+            match actuation.value {
+                Value::Bool(true) => info!("activate Horn"),
+                _ => info!("deactivate Horn"),
+            }
+        } else {
+            debug!("{key} := {}", actuation.value);
+        }
+        pub_current_status(&session, &actuation.key_expr, &actuation.value).await;
+        table.set(key, actuation.value);
+        actuated += 1;
+
+        let elapsed = last_stats.elapsed();
+        if !stats_interval.is_zero() && elapsed >= stats_interval {
+            info!(
+                "Actuated {} values/s over {} actuator(s), {} pending",
+                actuated as f64 / elapsed.as_secs_f64(),
+                table.len(),
+                rx_actuation.len()
+            );
+            actuated = 0;
+            last_stats = Instant::now();
+        }
+    }
+}
+
+pub async fn pub_current_status(session: &Session, key_expr: &KeyExpr<'_>, value: &Value) {
+    if let Err(e) = session
+        .put(key_expr, value.to_string())
         .attachment("currentValue")
         .await
     {